@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "GeneralHashFunctions.h"
 
 /* A simple hash function from Robert Sedgwicks Algorithms in C book. I've added 
@@ -144,14 +146,16 @@ unsigned int BPHash(const char * str, size_t len){
 /* End Of BP Hash Function */
 
 
+/* FNV-1: the offset basis (2166136261) is the starting value, every byte is
+multiplied in by the FNV prime (16777619). */
 unsigned int FNVHash(const char * str, size_t len){
-	const unsigned int fnv_prime = 0x811C9DC5;
-	unsigned int hash = 0;
+	const unsigned int fnv_prime = 0x01000193;
+	unsigned int hash = 0x811C9DC5;
 	unsigned int i = 0;
 
 	for(i = 0; i < len; str++, i++){
 		hash *= fnv_prime;
-		hash ^= (*str);
+		hash ^= (unsigned char) (*str);
 	}
 
 	return hash;
@@ -171,3 +175,169 @@ unsigned int APHash(const char * str, size_t len){
 	return hash;
 }
 /* End Of AP Hash Function */
+
+
+/* The functions below read the key a word (8 bytes) at a time instead of a byte
+at a time. They are not from the original library. */
+
+uint64_t WYHashSeed = 0;
+
+/* Multiply a and b into a 128-bit product, the lower half goes into a and the
+higher half into b. */
+static void wyMum(uint64_t * a, uint64_t * b){
+#ifdef __SIZEOF_INT128__
+	__extension__ unsigned __int128 r = *a;
+	r *= *b;
+	*a = (uint64_t) r;
+	*b = (uint64_t) (r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+/* Multiply a and b and fold the two halves of the product together. */
+static uint64_t wyMix(uint64_t a, uint64_t b){
+	wyMum(&a, &b);
+	return a ^ b;
+}
+
+/* Read 8 or 4 (unaligned) bytes in the native byte-order. */
+static uint64_t wyRead8(const unsigned char * p){
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+static uint64_t wyRead4(const unsigned char * p){
+	uint32_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+/* Read 1 to 3 bytes: the first, middle and last. */
+static uint64_t wyRead3(const unsigned char * p, size_t k){
+	return ((uint64_t) p[0] << 16) | ((uint64_t) p[k >> 1] << 8) | p[k - 1];
+}
+
+static const uint64_t wyP[4] = {
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/* wyhash (final version 4) by Wang Yi, which is in the public domain. Every
+multiplication mixes 16 bytes of the key, keys longer than 48 bytes are mixed in
+3 independent lanes. On big-endian machines the hashes differ from the
+reference (but are just as good). */
+uint64_t WYHashSeeded(const char * str, size_t len, uint64_t seed){
+	const unsigned char * p = (const unsigned char *) str;
+	uint64_t a, b;
+	
+	seed ^= wyMix(seed ^ wyP[0], wyP[1]);
+	
+	if(len <= 16){
+		if(len >= 4){
+			a = (wyRead4(p) << 32) | wyRead4(p + ((len >> 3) << 2));
+			b = (wyRead4(p + len - 4) << 32) |
+				wyRead4(p + len - 4 - ((len >> 3) << 2));
+		}else if(len > 0){
+			a = wyRead3(p, len);
+			b = 0;
+		}else{
+			a = b = 0;
+		}
+	}else{
+		size_t i = len;
+		if(i >= 48){
+			uint64_t see1 = seed, see2 = seed;
+			do{
+				seed = wyMix(wyRead8(p) ^ wyP[1], wyRead8(p + 8) ^ seed);
+				see1 = wyMix(wyRead8(p + 16) ^ wyP[2], wyRead8(p + 24) ^ see1);
+				see2 = wyMix(wyRead8(p + 32) ^ wyP[3], wyRead8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			}while(i >= 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16){
+			seed = wyMix(wyRead8(p) ^ wyP[1], wyRead8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wyRead8(p + i - 16);
+		b = wyRead8(p + i - 8);
+	}
+	
+	a ^= wyP[1];
+	b ^= seed;
+	wyMum(&a, &b);
+	return wyMix(a ^ wyP[0] ^ len, b ^ wyP[1]);
+}
+
+size_t WYHash(const char * str, size_t len){
+	return (size_t) WYHashSeeded(str, len, WYHashSeed);
+}
+/* End Of WY Hash Function */
+
+
+/* CRC32C (Castagnoli), bit by bit, for machines without the instruction. */
+static unsigned int crc32cSoft(const char * str, size_t len){
+	uint32_t crc = 0xFFFFFFFF;
+	size_t i;
+	int k;
+	
+	for(i = 0; i < len; i++){
+		crc ^= (unsigned char) str[i];
+		for(k = 0; k < 8; k++){
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+		}
+	}
+	
+	return ~crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <nmmintrin.h>
+#	define CRC32C_SSE42
+
+/* CRC32C with the SSE4.2 crc32 instruction: 8 bytes at a time. */
+__attribute__((target("sse4.2")))
+static unsigned int crc32cSse42(const char * str, size_t len){
+	uint64_t crc = 0xFFFFFFFF;
+	const unsigned char * p = (const unsigned char *) str;
+	
+	for(; len >= 8; p += 8, len -= 8){
+		crc = _mm_crc32_u64(crc, wyRead8(p));
+	}
+	for(; len > 0; p++, len--){
+		crc = _mm_crc32_u8((uint32_t) crc, *p);
+	}
+	
+	return ~(uint32_t) crc;
+}
+#endif
+
+/* CRC32C: which implementation is used is decided on the first call, by
+whether the CPU supports SSE4.2. Both give the same hashes. */
+unsigned int CRC32CHash(const char * str, size_t len){
+	unsigned int (*f)(const char *, size_t) = crc32cSoft;
+	
+#ifdef CRC32C_SSE42
+	static unsigned int (*impl)(const char *, size_t) = NULL;
+	
+	f = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+	if(!f){
+		f = __builtin_cpu_supports("sse4.2") ? crc32cSse42 : crc32cSoft;
+		__atomic_store_n(&impl, f, __ATOMIC_RELAXED);
+	}
+#endif
+	
+	return f(str, len);
+}
+/* End Of CRC32C Hash Function */
@@ -20,6 +20,7 @@
 #define INCLUDE_GENERALHASHFUNCTION_C_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 unsigned int RSHash  (const char * str, size_t len);
 unsigned int JSHash  (const char * str, size_t len);
@@ -33,4 +34,14 @@ unsigned int BPHash  (const char * str, size_t len);
 unsigned int FNVHash (const char * str, size_t len);
 unsigned int APHash  (const char * str, size_t len);
 
+/* 64-bit wyhash, WYHash uses WYHashSeed as its seed. Set WYHashSeed (to a
+random value) once, before hashing anything, to get different hashes in every
+process. */
+extern uint64_t WYHashSeed;
+size_t   WYHash      (const char * str, size_t len);
+uint64_t WYHashSeeded(const char * str, size_t len, uint64_t seed);
+
+/* CRC32C, with the SSE4.2 instruction when the CPU supports it. */
+unsigned int CRC32CHash(const char * str, size_t len);
+
 #endif
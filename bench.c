@@ -0,0 +1,415 @@
+/*
+ * Benchmarks for HashTab. Measures the latency of every operation and the
+ * allocations they make, over a range of table sizes, settings, key types and
+ * hash functions. Prints CSV on stdout, one line per operation per run:
+ *
+ *     bench [max_n [min_n]]
+ *
+ * The number of items goes from min_n (default 1000) to max_n (default
+ * 1000000) in steps of 10. Each run varies one setting from the default
+ * (short string keys, WYHash, threshold 0.75, moveR 4, shrinking, chained).
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashtab.h"
+#include "GeneralHashFunctions.h"
+
+/* Latencies below 1024 ns are counted exactly, above that every power of two
+   is divided into 64 sub-buckets (so they're within 1.6%) */
+#define HIST_EXACT 1024
+#define HIST_SUB 64
+#define HIST_SIZE (HIST_EXACT + 54 * HIST_SUB)
+
+typedef struct{
+	uint64_t count[HIST_SIZE];
+	uint64_t n, total, max;
+} hist_s;
+
+static uint64_t timerCost;
+
+static uint64_t now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* The cheapest of many back-to-back readings, subtracted from every sample */
+static void calibrate(void){
+	timerCost = UINT64_MAX;
+	for(int i = 0; i < 10000; i++){
+		uint64_t t0 = now(), t1 = now();
+		if(t1 - t0 < timerCost){
+			timerCost = t1 - t0;
+		}
+	}
+}
+
+static size_t histIndex(uint64_t v){
+	int e = 63;
+	
+	if(v < HIST_EXACT){
+		return v;
+	}
+	while(!(v >> e)){
+		e--;
+	}
+	return HIST_EXACT + (e - 10) * HIST_SUB + ((v >> (e - 6)) & (HIST_SUB - 1));
+}
+
+static uint64_t histValue(size_t i){
+	size_t e;
+	
+	if(i < HIST_EXACT){
+		return i;
+	}
+	i -= HIST_EXACT;
+	e = i / HIST_SUB + 10;
+	return (uint64_t) (HIST_SUB + i % HIST_SUB) << (e - 6);
+}
+
+static void histAdd(hist_s * h, uint64_t t0, uint64_t t1){
+	uint64_t v = t1 - t0;
+	
+	v = v > timerCost ? v - timerCost : 0;
+	h->count[histIndex(v)]++;
+	h->n++;
+	h->total += v;
+	if(v > h->max){
+		h->max = v;
+	}
+}
+
+static uint64_t histPercentile(const hist_s * h, double q){
+	uint64_t want = (uint64_t) (q * h->n + 0.5), seen = 0;
+	
+	for(size_t i = 0; i < HIST_SIZE; i++){
+		seen += h->count[i];
+		if(seen >= want && seen){
+			return histValue(i);
+		}
+	}
+	return h->max;
+}
+
+/* Keys: ints are items themselves, strings are items pointing to their bytes */
+typedef struct{
+	const char * str;
+	size_t len;
+} key_s;
+
+typedef struct{
+	const char * name;
+	size_t (*fn)(const char * str, size_t len);
+} hashFn_s;
+
+#define BENCH_HASH(f) \
+	static size_t bench ## f(const char * str, size_t len){ \
+		return f(str, len); \
+	}
+
+BENCH_HASH(RSHash)
+BENCH_HASH(JSHash)
+BENCH_HASH(PJWHash)
+BENCH_HASH(ELFHash)
+BENCH_HASH(BKDRHash)
+BENCH_HASH(SDBMHash)
+BENCH_HASH(DJBHash)
+BENCH_HASH(DEKHash)
+BENCH_HASH(BPHash)
+BENCH_HASH(FNVHash)
+BENCH_HASH(APHash)
+BENCH_HASH(CRC32CHash)
+
+static const hashFn_s hashFns[] = {
+	{"WYHash", WYHash}, {"CRC32CHash", benchCRC32CHash},
+	{"RSHash", benchRSHash}, {"JSHash", benchJSHash},
+	{"PJWHash", benchPJWHash}, {"ELFHash", benchELFHash},
+	{"BKDRHash", benchBKDRHash}, {"SDBMHash", benchSDBMHash},
+	{"DJBHash", benchDJBHash}, {"DEKHash", benchDEKHash},
+	{"BPHash", benchBPHash}, {"FNVHash", benchFNVHash},
+	{"APHash", benchAPHash}
+};
+
+static size_t (*strHashFn)(const char * str, size_t len);
+
+static size_t intHash(const void * v){
+	return *(const uint32_t*)v;
+}
+
+static int intCmp(const void * va, const void * vb){
+	return *(const uint32_t*)va != *(const uint32_t*)vb;
+}
+
+static size_t strHash(const void * v){
+	const key_s * k = v;
+	return strHashFn(k->str, k->len);
+}
+
+static int strCmp(const void * va, const void * vb){
+	const key_s * a = va, * b = vb;
+	return a->len != b->len || memcmp(a->str, b->str, a->len);
+}
+
+enum{ KEY_INT, KEY_SHORT, KEY_LONG };
+static const char * keyNames[] = {"int", "short", "long"};
+
+typedef struct{
+	int key;
+	const hashFn_s * hash;
+	float threshold;
+	size_t moveR;
+	int shrink;
+	int flags;
+} config_s;
+
+/* The keys of a run: the first n are added, the next n are never found */
+typedef struct{
+	size_t n;
+	void ** items;
+	uint32_t * ints;
+	key_s * strs;
+	char * bytes;
+} keys_s;
+
+/* A bijection on 32-bit ints, so all keys are distinct but not sequential */
+static uint32_t scramble(uint32_t i){
+	return i * 2654435761u + 12345;
+}
+
+static void keysMake(keys_s * ks, int key, size_t n){
+	size_t len = key == KEY_SHORT ? 8 : 64;
+	
+	ks->n = n;
+	ks->items = malloc(2 * n * sizeof *ks->items);
+	ks->ints = NULL;
+	ks->strs = NULL;
+	ks->bytes = NULL;
+	
+	if(key == KEY_INT){
+		ks->ints = malloc(2 * n * sizeof *ks->ints);
+		for(size_t i = 0; i < 2 * n; i++){
+			ks->ints[i] = scramble(i);
+			ks->items[i] = ks->ints + i;
+		}
+		return;
+	}
+	
+	ks->strs = malloc(2 * n * sizeof *ks->strs);
+	ks->bytes = malloc(2 * n * (len + 1));
+	for(size_t i = 0; i < 2 * n; i++){
+		char * s = ks->bytes + i * (len + 1);
+		/* Long keys share a prefix, like paths or URLs */
+		sprintf(s, "%0*x", (int) len, (unsigned) scramble(i));
+		if(key == KEY_LONG){
+			memcpy(s, "/usr/local/share/benchmarks/hashtab/long/keys/", 46);
+		}
+		ks->strs[i].str = s;
+		ks->strs[i].len = len;
+		ks->items[i] = ks->strs + i;
+	}
+}
+
+static void keysFree(keys_s * ks){
+	free(ks->items);
+	free(ks->ints);
+	free(ks->strs);
+	free(ks->bytes);
+}
+
+/* Visit the keys in a different order than they were made in, so lookups of
+   strings don't walk through memory sequentially */
+static size_t strideFor(size_t n){
+	size_t s = 1000003;
+	
+	for(;; s += 2){
+		size_t a = s % n, b = n;
+		while(a){
+			size_t t = b % a;
+			b = a;
+			a = t;
+		}
+		if(b == 1){
+			return s % n ? s % n : 1;
+		}
+	}
+}
+
+typedef struct{
+	const config_s * cfg;
+	size_t n;
+	size_t mallocs, reallocs;
+} run_s;
+
+static void report(run_s * run, const char * op, const hist_s * h,
+		size_t ops, uint64_t total){
+	const config_s * c = run->cfg;
+	size_t mallocs, reallocs;
+	
+	getMemStats(&mallocs, &reallocs);
+	printf("%s,%s,%zu,%.2f,%zu,%i,%i,%s,%zu,%.2f,",
+		keyNames[c->key], c->key == KEY_INT ? "identity" : c->hash->name,
+		run->n, c->threshold, c->moveR, c->shrink, c->flags, op, ops,
+		(double) total / ops);
+	if(h){
+		printf("%llu,%llu,%llu,", (unsigned long long) histPercentile(h, 0.5),
+			(unsigned long long) histPercentile(h, 0.99),
+			(unsigned long long) h->max);
+	}else{
+		printf(",,,");
+	}
+	printf("%zu,%zu\n", mallocs - run->mallocs, reallocs - run->reallocs);
+	
+	run->mallocs = mallocs;
+	run->reallocs = reallocs;
+}
+
+static void count(void * item, void * ctx){
+	++*(size_t*)ctx;
+}
+
+static void bench(const config_s * cfg, size_t n){
+	static hist_s h;
+	keys_s ks;
+	hashtab_s * ht, * cp;
+	size_t stride = strideFor(n), seen = 0;
+	run_s run = {cfg, n, 0, 0};
+	uint64_t t0, t1;
+	
+	keysMake(&ks, cfg->key, n);
+	strHashFn = cfg->hash->fn;
+	
+	getMemStats(&run.mallocs, &run.reallocs);
+	ht = hashtab_makeFlags(8, cfg->key == KEY_INT ? intHash : strHash,
+		cfg->key == KEY_INT ? intCmp : strCmp, cfg->threshold, cfg->moveR,
+		cfg->shrink, cfg->flags);
+	
+	memset(&h, 0, sizeof h);
+	for(size_t i = 0; i < n; i++){
+		t0 = now();
+		hashtab_add(ht, ks.items[i]);
+		t1 = now();
+		histAdd(&h, t0, t1);
+	}
+	report(&run, "add", &h, n, h.total);
+	
+	memset(&h, 0, sizeof h);
+	for(size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n){
+		t0 = now();
+		hashtab_find(ht, ks.items[j]);
+		t1 = now();
+		histAdd(&h, t0, t1);
+	}
+	report(&run, "find_hit", &h, n, h.total);
+	
+	memset(&h, 0, sizeof h);
+	for(size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n){
+		t0 = now();
+		hashtab_find(ht, ks.items[n + j]);
+		t1 = now();
+		histAdd(&h, t0, t1);
+	}
+	report(&run, "find_miss", &h, n, h.total);
+	
+	memset(&h, 0, sizeof h);
+	for(size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n){
+		t0 = now();
+		hashtab_insert(ht, ks.items[j]);
+		t1 = now();
+		histAdd(&h, t0, t1);
+	}
+	report(&run, "insert", &h, n, h.total);
+	
+	t0 = now();
+	hashtab_forEach(ht, count, &seen);
+	t1 = now();
+	report(&run, "forEach", NULL, n, t1 - t0);
+	
+	t0 = now();
+	cp = hashtab_copy(ht, NULL, NULL);
+	t1 = now();
+	report(&run, "copy", NULL, n, t1 - t0);
+	hashtab_free(cp, NULL, NULL);
+	getMemStats(&run.mallocs, &run.reallocs);
+	
+	memset(&h, 0, sizeof h);
+	for(size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n){
+		t0 = now();
+		hashtab_remove(ht, ks.items[j]);
+		t1 = now();
+		histAdd(&h, t0, t1);
+	}
+	report(&run, "remove", &h, n, h.total);
+	
+	if(seen != n || hashtab_length(ht)){
+		fprintf(stderr, "bench: visited %zu of %zu items, %zu left\n", seen,
+			n, hashtab_length(ht));
+		exit(1);
+	}
+	
+	hashtab_free(ht, NULL, NULL);
+	keysFree(&ks);
+}
+
+int main(int argc, char ** argv){
+	size_t maxN = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	size_t minN = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+	const config_s def = {KEY_SHORT, hashFns, 0.75, 4, 1, 0};
+	const float thresholds[] = {0.5, 0.9};
+	const size_t moveRs[] = {1, 16, 64};
+	const int flags[] = {HASHTAB_FLAT, HASHTAB_POW2 | HASHTAB_MIX,
+		HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX, HASHTAB_ROBIN,
+		HASHTAB_ROBIN | HASHTAB_POW2 | HASHTAB_MIX, HASHTAB_COMPACT,
+		HASHTAB_COMPACT | HASHTAB_POW2 | HASHTAB_MIX};
+	
+	calibrate();
+	
+	printf("key,hash,n,threshold,moveR,shrink,flags,op,ops,ns_op,p50_ns,"
+		"p99_ns,max_ns,mallocs,reallocs\n");
+	
+	for(size_t n = minN ? minN : 1; n <= maxN; n *= 10){
+		config_s c;
+	
+		bench(&def, n);
+	
+		c = def;
+		c.key = KEY_INT;
+		bench(&c, n);
+		c.key = KEY_LONG;
+		bench(&c, n);
+	
+		for(size_t i = 1; i < sizeof hashFns / sizeof *hashFns; i++){
+			c = def;
+			c.hash = hashFns + i;
+			bench(&c, n);
+		}
+		for(size_t i = 0; i < sizeof thresholds / sizeof *thresholds; i++){
+			c = def;
+			c.threshold = thresholds[i];
+			bench(&c, n);
+		}
+		for(size_t i = 0; i < sizeof moveRs / sizeof *moveRs; i++){
+			c = def;
+			c.moveR = moveRs[i];
+			bench(&c, n);
+		}
+		c = def;
+		c.shrink = 0;
+		bench(&c, n);
+		for(size_t i = 0; i < sizeof flags / sizeof *flags; i++){
+			c = def;
+			c.flags = flags[i];
+			bench(&c, n);
+		}
+	
+		fflush(stdout);
+	}
+	
+	return 0;
+}
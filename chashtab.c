@@ -0,0 +1,718 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    chashtab.c
+ *
+ * The concurrent hash table. Every table is a power of two in size and every
+ * bucket belongs to the stripe (lock) selected by the lower bits of the hash.
+ * Since a bucket's items only move to the buckets with the same lower bits in
+ * the next (bigger) table, a stripe covers the same items in every table.
+ *
+ * Writers lock their item's stripe. Readers lock nothing: they follow the
+ * bucket pointers, which are only ever swapped for fully initialized links.
+ * Removed links (and tables) are not freed immediately, but kept as garbage
+ * until every reader that could still see them has finished: readers announce
+ * themselves in one of two counters (selected by the epoch), and a collector
+ * flips the epoch and waits for the old counter to drop to 0.
+ *
+ * When growing, a new table is hung from the current one (`next`). Every
+ * writer first moves its own bucket over, and then a chunk of (size / moveR)
+ * buckets. Moved buckets are copied to the new table and marked as moved so
+ * readers know to look in the next one. When all buckets are moved the new
+ * table replaces the old one.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "hashtab.h"
+#include "chashtab.h"
+
+/** Size of a cache line, to keep the locks and counters apart. */
+#define CHASHTAB_LINE 64
+/** Garbage links a stripe collects before they are freed. */
+#define CHASHTAB_GARBAGE 64
+
+#define CHASHTAB_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define CHASHTAB_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/** @private A link in a bucket. */
+typedef struct chashtab_link{
+	/** The item. */
+	void * item;
+	/** The (mixed) hash of the item. */
+	size_t hash;
+	/** The next link in the bucket. */
+	struct chashtab_link * next;
+	/** The next link in the garbage (after removal). */
+	struct chashtab_link * garbage;
+} chashtab_link_s;
+
+/** @private A table of buckets. */
+typedef struct chashtab_table{
+	/** The number of buckets, a power of two. */
+	size_t size;
+	/** The table the buckets are moved to when growing, otherwise NULL. */
+	struct chashtab_table * next;
+	/** The next bucket to be moved by a helping writer. */
+	size_t cursor;
+	/** The number of moved buckets. */
+	size_t moved;
+	/** The next table in the garbage (after being replaced). */
+	struct chashtab_table * garbage;
+	/** The buckets. */
+	chashtab_link_s * buckets[];
+} chashtab_table_s;
+
+/** @private A writer lock and the state it protects. */
+typedef union chashtab_stripe{
+	struct{
+		/** The lock. */
+		pthread_mutex_t lock;
+		/** The number of items in the stripe's buckets. */
+		size_t length;
+		/** The links removed from the stripe's buckets. */
+		chashtab_link_s * garbage;
+		/** The number of links in the garbage. */
+		size_t garbages;
+	} s;
+	char pad[2 * CHASHTAB_LINE];
+} chashtab_stripe_u;
+
+/** @private A counter of active readers. */
+typedef union chashtab_readers{
+	size_t n;
+	char pad[CHASHTAB_LINE];
+} chashtab_readers_u;
+
+struct chashtab{
+	/** The current table. */
+	chashtab_table_s * table;
+	/** The hash function. */
+	size_t (*hasher)(const void *);
+	/** The compare function. */
+	int (*cmp)(const void *, const void *);
+	/** The load factor at which to grow. */
+	float threshold;
+	/** The move rate. */
+	size_t moveR;
+	/** The number of stripes, a power of two. */
+	size_t stripes;
+	/** The stripes. */
+	chashtab_stripe_u * stripe;
+	/** Serializes starting and finishing migrations. */
+	pthread_mutex_t resize;
+	/** Serializes garbage collection. */
+	pthread_mutex_t collect;
+	/** The replaced tables (protected by resize). */
+	chashtab_table_s * garbage;
+	/** Selects the readers counter for new readers. */
+	size_t epoch;
+	/** The readers counters. */
+	chashtab_readers_u readers[2];
+};
+
+/** @private Marks a bucket that has been moved to the next table. */
+static chashtab_link_s chashtab_movedLink;
+#define CHASHTAB_MOVED (&chashtab_movedLink)
+
+static void * safeMalloc(size_t n){
+	void * p = malloc(n);
+	if(!p){
+		fprintf(stderr, "malloc(%lu) failed\n", (unsigned long) n);
+		exit(1);
+	}
+
+	return p;
+}
+
+/**
+ * @private
+ *
+ * Allocates an empty table.
+ *
+ * @param size The size, a power of two.
+ * @return The table.
+ */
+static chashtab_table_s * chashtab_tableMake(size_t size){
+	chashtab_table_s * t = safeMalloc(sizeof *t + size * sizeof *t->buckets);
+	size_t i;
+
+	t->size = size;
+	t->next = NULL;
+	t->cursor = 0;
+	t->moved = 0;
+	t->garbage = NULL;
+	for(i = 0; i < size; i++){
+		t->buckets[i] = NULL;
+	}
+
+	return t;
+}
+
+/**
+ * @private
+ *
+ * Starts a read-side section: links and tables seen from here on are not freed
+ * until chashtab_leave.
+ *
+ * @param ht The hash table.
+ * @return The counter to pass to chashtab_leave.
+ */
+static size_t chashtab_enter(chashtab_s * ht){
+	size_t e;
+
+	for(;;){
+		e = __atomic_load_n(&ht->epoch, __ATOMIC_SEQ_CST) & 1;
+		__atomic_fetch_add(&ht->readers[e].n, 1, __ATOMIC_SEQ_CST);
+		/* The collector may have flipped the epoch in between */
+		if((__atomic_load_n(&ht->epoch, __ATOMIC_SEQ_CST) & 1) == e){
+			return e;
+		}
+		__atomic_fetch_sub(&ht->readers[e].n, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+/**
+ * @private
+ *
+ * Ends a read-side section.
+ *
+ * @param ht The hash table.
+ * @param e The counter returned by chashtab_enter.
+ */
+static void chashtab_leave(chashtab_s * ht, size_t e){
+	__atomic_fetch_sub(&ht->readers[e].n, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @private
+ *
+ * Waits until all read-side sections that were active when this was called
+ * have ended. Must be called with the collect lock held, and not from inside a
+ * read-side section.
+ *
+ * @param ht The hash table.
+ */
+static void chashtab_synchronize(chashtab_s * ht){
+	size_t e = __atomic_load_n(&ht->epoch, __ATOMIC_SEQ_CST);
+
+	__atomic_store_n(&ht->epoch, e + 1, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&ht->readers[e & 1].n, __ATOMIC_SEQ_CST)){
+		sched_yield();
+	}
+}
+
+/**
+ * @private
+ *
+ * Frees the garbage that has been collected so far. If another thread is
+ * already collecting this returns immediately. Must not be called from inside
+ * a read-side section.
+ *
+ * @param ht The hash table.
+ */
+static void chashtab_collect(chashtab_s * ht){
+	chashtab_link_s * links = NULL, * ll, * next;
+	chashtab_table_s * tables, * t;
+	size_t i;
+
+	if(pthread_mutex_trylock(&ht->collect)){
+		return;
+	}
+
+	for(i = 0; i < ht->stripes; i++){
+		chashtab_stripe_u * st = ht->stripe + i;
+
+		pthread_mutex_lock(&st->s.lock);
+		for(ll = st->s.garbage; ll; ll = next){
+			next = ll->garbage;
+			ll->garbage = links;
+			links = ll;
+		}
+		st->s.garbage = NULL;
+		st->s.garbages = 0;
+		pthread_mutex_unlock(&st->s.lock);
+	}
+
+	pthread_mutex_lock(&ht->resize);
+	tables = ht->garbage;
+	__atomic_store_n(&ht->garbage, NULL, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&ht->resize);
+
+	chashtab_synchronize(ht);
+
+	for(ll = links; ll; ll = next){
+		next = ll->garbage;
+		free(ll);
+	}
+	for(t = tables; t; t = tables){
+		tables = t->garbage;
+		free(t);
+	}
+
+	pthread_mutex_unlock(&ht->collect);
+}
+
+/**
+ * @private
+ *
+ * Adds a link to the garbage of its stripe. Must be called with the stripe's
+ * lock held.
+ *
+ * @param st The stripe.
+ * @param ll The link, already unlinked from its bucket.
+ */
+static void chashtab_retire(chashtab_stripe_u * st, chashtab_link_s * ll){
+	ll->garbage = st->s.garbage;
+	st->s.garbage = ll;
+	++st->s.garbages;
+}
+
+/**
+ * @private
+ *
+ * Replaces a table whose buckets have all been moved by its next table.
+ *
+ * @param ht The hash table.
+ * @param t The table.
+ */
+static void chashtab_finish(chashtab_s * ht, chashtab_table_s * t){
+	pthread_mutex_lock(&ht->resize);
+	CHASHTAB_STORE(&ht->table, t->next);
+	t->garbage = ht->garbage;
+	__atomic_store_n(&ht->garbage, t, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&ht->resize);
+}
+
+/**
+ * @private
+ *
+ * Moves a bucket of a growing table to its next table (if it has not been
+ * moved already). Must be called with the bucket's stripe locked.
+ *
+ * @param ht The hash table.
+ * @param t The growing table.
+ * @param b The index of the bucket.
+ * @param st The bucket's stripe.
+ */
+static void chashtab_moveBucket(chashtab_s * ht, chashtab_table_s * t, size_t b,
+		chashtab_stripe_u * st){
+	chashtab_table_s * nt = t->next;
+	chashtab_link_s * ll = t->buckets[b], * cpy;
+	size_t nb;
+
+	if(ll == CHASHTAB_MOVED){
+		return;
+	}
+
+	/* Readers may still be walking the old links, so they are copied */
+	for(; ll; ll = ll->next){
+		cpy = safeMalloc(sizeof *cpy);
+		cpy->item = ll->item;
+		cpy->hash = ll->hash;
+		nb = ll->hash & (nt->size - 1);
+		cpy->next = nt->buckets[nb];
+		CHASHTAB_STORE(&nt->buckets[nb], cpy);
+		chashtab_retire(st, ll);
+	}
+	CHASHTAB_STORE(&t->buckets[b], CHASHTAB_MOVED);
+
+	if(__atomic_add_fetch(&t->moved, 1, __ATOMIC_ACQ_REL) == t->size){
+		chashtab_finish(ht, t);
+	}
+}
+
+/**
+ * @private
+ *
+ * Finds the table that writers of a hash should use: the last one, after
+ * moving the hash's bucket out of all the growing ones. Must be called with the
+ * hash's stripe locked.
+ *
+ * @param ht The hash table.
+ * @param hash The hash.
+ * @param st The hash's stripe.
+ * @return The table.
+ */
+static chashtab_table_s * chashtab_latest(chashtab_s * ht, size_t hash,
+		chashtab_stripe_u * st){
+	chashtab_table_s * t = CHASHTAB_LOAD(&ht->table), * next;
+
+	while((next = CHASHTAB_LOAD(&t->next))){
+		chashtab_moveBucket(ht, t, hash & (t->size - 1), st);
+		t = next;
+	}
+
+	return t;
+}
+
+/**
+ * @private
+ *
+ * Moves a chunk of (size / moveR) buckets of the current table, if it is
+ * growing. Every stripe is locked once for all of its buckets in the chunk.
+ *
+ * @param ht The hash table.
+ */
+static void chashtab_help(chashtab_s * ht){
+	chashtab_table_s * t = CHASHTAB_LOAD(&ht->table);
+	size_t chunk, start, end, s, b;
+
+	if(!CHASHTAB_LOAD(&t->next)){
+		return;
+	}
+
+	chunk = t->size / ht->moveR;
+	if(!chunk){
+		chunk = 1;
+	}
+	start = __atomic_fetch_add(&t->cursor, chunk, __ATOMIC_RELAXED);
+	if(start >= t->size){
+		return;
+	}
+	end = start + chunk < t->size ? start + chunk : t->size;
+
+	for(s = start; s < end && s < start + ht->stripes; s++){
+		chashtab_stripe_u * st = ht->stripe + (s & (ht->stripes - 1));
+
+		pthread_mutex_lock(&st->s.lock);
+		for(b = s; b < end; b += ht->stripes){
+			chashtab_moveBucket(ht, t, b, st);
+		}
+		pthread_mutex_unlock(&st->s.lock);
+	}
+}
+
+/**
+ * @private
+ *
+ * Grows the table (starts a migration) if it is still the current one and not
+ * already growing.
+ *
+ * @param ht The hash table.
+ * @param t The table.
+ */
+static void chashtab_grow(chashtab_s * ht, chashtab_table_s * t){
+	pthread_mutex_lock(&ht->resize);
+	if(ht->table == t && !t->next){
+		CHASHTAB_STORE(&t->next, chashtab_tableMake(t->size * 2));
+	}
+	pthread_mutex_unlock(&ht->resize);
+}
+
+/**
+ * @private
+ *
+ * Checks whether a stripe is over its share of the load factor threshold, and
+ * if so whether the whole table is. Must be called with the stripe locked.
+ *
+ * @param ht The hash table.
+ * @param t The table the stripe's items are in.
+ * @param st The stripe.
+ * @return Whether the table should grow.
+ */
+static int chashtab_full(chashtab_s * ht, chashtab_table_s * t,
+		chashtab_stripe_u * st){
+	if(st->s.length <= ht->threshold * (t->size / ht->stripes)){
+		return 0;
+	}
+
+	return chashtab_length(ht) > ht->threshold * t->size;
+}
+
+/**
+ * @private
+ *
+ * Adds a link for an item to the bucket of its hash. Must be called with the
+ * hash's stripe locked.
+ *
+ * @param t The table.
+ * @param item The item.
+ * @param hash The hash of the item.
+ * @param st The hash's stripe.
+ */
+static void chashtab_link(chashtab_table_s * t, void * item, size_t hash,
+		chashtab_stripe_u * st){
+	chashtab_link_s * ll = safeMalloc(sizeof *ll);
+	size_t b = hash & (t->size - 1);
+
+	ll->item = item;
+	ll->hash = hash;
+	ll->next = t->buckets[b];
+	ll->garbage = NULL;
+	CHASHTAB_STORE(&t->buckets[b], ll);
+	__atomic_store_n(&st->s.length, st->s.length + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @private
+ *
+ * Ends a write operation: helps growing, grows and collects garbage. Must be
+ * called with the stripe unlocked.
+ *
+ * @param ht The hash table.
+ * @param t The table that was written, or NULL if it need not be grown.
+ * @param garbage Whether the stripe had enough garbage to collect.
+ * @param e The read-side counter of the operation.
+ */
+static void chashtab_done(chashtab_s * ht, chashtab_table_s * t, int garbage,
+		size_t e){
+	chashtab_help(ht);
+	if(t){
+		chashtab_grow(ht, t);
+	}
+	chashtab_leave(ht, e);
+
+	if(garbage || __atomic_load_n(&ht->garbage, __ATOMIC_RELAXED)){
+		chashtab_collect(ht);
+	}
+}
+
+chashtab_s * chashtab_make(size_t size, size_t (*hasher)(const void *),
+		int (*cmp)(const void *, const void *), float threshold, size_t moveR,
+		size_t stripes){
+	chashtab_s * ht = safeMalloc(sizeof *ht);
+	size_t i, n = 1;
+
+	if(!stripes){
+		stripes = CHASHTAB_STRIPES;
+	}
+	while(n < stripes){
+		n <<= 1;
+	}
+	stripes = n;
+	while(n < size){
+		n <<= 1;
+	}
+
+	ht->table = chashtab_tableMake(n);
+	ht->hasher = hasher;
+	ht->cmp = cmp;
+	ht->threshold = threshold;
+	ht->moveR = moveR ? moveR : 1;
+	ht->stripes = stripes;
+	ht->stripe = safeMalloc(stripes * sizeof *ht->stripe);
+	for(i = 0; i < stripes; i++){
+		pthread_mutex_init(&ht->stripe[i].s.lock, NULL);
+		ht->stripe[i].s.length = 0;
+		ht->stripe[i].s.garbage = NULL;
+		ht->stripe[i].s.garbages = 0;
+	}
+	pthread_mutex_init(&ht->resize, NULL);
+	pthread_mutex_init(&ht->collect, NULL);
+	ht->garbage = NULL;
+	ht->epoch = 0;
+	ht->readers[0].n = 0;
+	ht->readers[1].n = 0;
+
+	return ht;
+}
+
+void chashtab_add(chashtab_s * ht, void * item){
+	size_t hash = hashtab_mix(ht->hasher(item)), e = chashtab_enter(ht);
+	chashtab_stripe_u * st = ht->stripe + (hash & (ht->stripes - 1));
+	chashtab_table_s * t;
+	int full, garbage;
+
+	pthread_mutex_lock(&st->s.lock);
+	t = chashtab_latest(ht, hash, st);
+	chashtab_link(t, item, hash, st);
+	full = chashtab_full(ht, t, st);
+	garbage = st->s.garbages >= CHASHTAB_GARBAGE;
+	pthread_mutex_unlock(&st->s.lock);
+
+	chashtab_done(ht, full ? t : NULL, garbage, e);
+}
+
+void * chashtab_insert(chashtab_s * ht, void * item){
+	size_t hash = hashtab_mix(ht->hasher(item)), e = chashtab_enter(ht);
+	chashtab_stripe_u * st = ht->stripe + (hash & (ht->stripes - 1));
+	chashtab_table_s * t;
+	chashtab_link_s * ll;
+	void * old = NULL;
+	int full = 0, garbage;
+
+	pthread_mutex_lock(&st->s.lock);
+	t = chashtab_latest(ht, hash, st);
+	for(ll = t->buckets[hash & (t->size - 1)]; ll; ll = ll->next){
+		if(ll->hash == hash && !ht->cmp(item, ll->item)){
+			old = ll->item;
+			CHASHTAB_STORE(&ll->item, item);
+			break;
+		}
+	}
+	if(!ll){
+		chashtab_link(t, item, hash, st);
+		full = chashtab_full(ht, t, st);
+	}
+	garbage = st->s.garbages >= CHASHTAB_GARBAGE;
+	pthread_mutex_unlock(&st->s.lock);
+
+	chashtab_done(ht, full ? t : NULL, garbage, e);
+
+	return old;
+}
+
+void * chashtab_find(chashtab_s * ht, const void * item){
+	size_t hash = hashtab_mix(ht->hasher(item)), e = chashtab_enter(ht);
+	chashtab_table_s * t = CHASHTAB_LOAD(&ht->table);
+	chashtab_link_s * ll;
+	void * found = NULL, * it;
+
+	/* A moved bucket is complete in the next table before it is marked */
+	while((ll = CHASHTAB_LOAD(&t->buckets[hash & (t->size - 1)]))
+			== CHASHTAB_MOVED){
+		t = CHASHTAB_LOAD(&t->next);
+	}
+
+	for(; ll; ll = CHASHTAB_LOAD(&ll->next)){
+		if(ll->hash == hash){
+			it = CHASHTAB_LOAD(&ll->item);
+			if(!ht->cmp(item, it)){
+				found = it;
+				break;
+			}
+		}
+	}
+
+	chashtab_leave(ht, e);
+
+	return found;
+}
+
+void * chashtab_remove(chashtab_s * ht, const void * item){
+	size_t hash = hashtab_mix(ht->hasher(item)), e = chashtab_enter(ht);
+	chashtab_stripe_u * st = ht->stripe + (hash & (ht->stripes - 1));
+	chashtab_table_s * t;
+	chashtab_link_s ** pp, * ll;
+	void * found = NULL;
+	int garbage;
+
+	pthread_mutex_lock(&st->s.lock);
+	t = chashtab_latest(ht, hash, st);
+	for(pp = &t->buckets[hash & (t->size - 1)]; (ll = *pp); pp = &ll->next){
+		if(ll->hash == hash && !ht->cmp(item, ll->item)){
+			found = ll->item;
+			/* Readers on ll can still continue to ll->next */
+			CHASHTAB_STORE(pp, ll->next);
+			chashtab_retire(st, ll);
+			__atomic_store_n(&st->s.length, st->s.length - 1,
+				__ATOMIC_RELAXED);
+			break;
+		}
+	}
+	garbage = st->s.garbages >= CHASHTAB_GARBAGE;
+	pthread_mutex_unlock(&st->s.lock);
+
+	chashtab_done(ht, NULL, garbage, e);
+
+	return found;
+}
+
+size_t chashtab_length(chashtab_s * ht){
+	size_t i, length = 0;
+
+	for(i = 0; i < ht->stripes; i++){
+		length += __atomic_load_n(&ht->stripe[i].s.length, __ATOMIC_RELAXED);
+	}
+
+	return length;
+}
+
+void chashtab_forEach(chashtab_s * ht, void (*cb)(void * item, void * ctx),
+		void * ctx){
+	size_t e = chashtab_enter(ht), s, b;
+	chashtab_table_s * t;
+	chashtab_link_s * ll;
+
+	for(s = 0; s < ht->stripes; s++){
+		chashtab_stripe_u * st = ht->stripe + s;
+
+		pthread_mutex_lock(&st->s.lock);
+		/* Moved buckets are skipped: their items are in the next table */
+		for(t = CHASHTAB_LOAD(&ht->table); t; t = CHASHTAB_LOAD(&t->next)){
+			for(b = s; b < t->size; b += ht->stripes){
+				ll = t->buckets[b];
+				if(ll == CHASHTAB_MOVED){
+					continue;
+				}
+				for(; ll; ll = ll->next){
+					cb(ll->item, ctx);
+				}
+			}
+		}
+		pthread_mutex_unlock(&st->s.lock);
+	}
+
+	chashtab_leave(ht, e);
+}
+
+void chashtab_free(chashtab_s * ht, void (*cb)(void * item, void * ctx),
+		void * ctx){
+	chashtab_table_s * t, * next;
+	chashtab_link_s * ll, * nl;
+	size_t i;
+
+	for(t = ht->table; t; t = next){
+		next = t->next;
+		for(i = 0; i < t->size; i++){
+			if(t->buckets[i] == CHASHTAB_MOVED){
+				continue;
+			}
+			for(ll = t->buckets[i]; ll; ll = nl){
+				nl = ll->next;
+				if(cb){
+					cb(ll->item, ctx);
+				}
+				free(ll);
+			}
+		}
+		free(t);
+	}
+	for(t = ht->garbage; t; t = next){
+		next = t->garbage;
+		free(t);
+	}
+
+	for(i = 0; i < ht->stripes; i++){
+		for(ll = ht->stripe[i].s.garbage; ll; ll = nl){
+			nl = ll->garbage;
+			free(ll);
+		}
+		pthread_mutex_destroy(&ht->stripe[i].s.lock);
+	}
+	pthread_mutex_destroy(&ht->resize);
+	pthread_mutex_destroy(&ht->collect);
+
+	free(ht->stripe);
+	free(ht);
+}
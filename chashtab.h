@@ -0,0 +1,137 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    chashtab.h
+ *
+ * A concurrent hash table, safe to use from multiple threads at once. Writers
+ * (add, insert, remove) lock only the stripe of buckets their item maps to,
+ * readers (find) take no locks at all. See README.md for more general comments.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#ifndef CHASHTAB_H
+#define CHASHTAB_H
+
+#include <stdlib.h>
+
+/** The default number of lock stripes (for chashtab_make with stripes 0). */
+#define CHASHTAB_STRIPES 64
+
+/** A concurrent hash table. Its members are private: use the functions. */
+typedef struct chashtab chashtab_s;
+
+/**
+ * Allocate and initialize a concurrent hash table. The size and number of
+ * stripes are rounded up to powers of two, and the size is at least the number
+ * of stripes. Every hash is mixed (see hashtab_mix) before selecting a bucket.
+ *
+ * The hasher and cmp callbacks may be called from multiple threads at once.
+ *
+ * @param size The initial size (number of buckets).
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load factor at which the table is grown.
+ * @param moveR The move rate: every operation on a growing table moves
+ *        (size / moveR) buckets to the new table (1 moves them all at once).
+ * @param stripes The number of writer locks, 0 for CHASHTAB_STRIPES.
+ * @return The hash table.
+ */
+chashtab_s * chashtab_make(size_t size, size_t (*hasher)(const void *),
+	int (*cmp)(const void *, const void *), float threshold, size_t moveR,
+	size_t stripes);
+
+/**
+ * Add an item to the hash table. Note that this adds the item even if it
+ * already exists. To replace existing items use chashtab_insert.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ */
+void chashtab_add(chashtab_s * ht, void * item);
+
+/**
+ * Insert an item into the hash table: if an equal item is found it is replaced
+ * by the new item, otherwise the new item is added.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ * @return The replaced item, or NULL if it was added.
+ */
+void * chashtab_insert(chashtab_s * ht, void * item);
+
+/**
+ * Find an item in the hash table. This takes no locks, so it never waits for
+ * writers (and cannot be blocked by them).
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @return The found item or NULL if it could not be found.
+ */
+void * chashtab_find(chashtab_s * ht, const void * item);
+
+/**
+ * Remove an item from the hash table. It may still be returned by finds in
+ * other threads that started before it was removed.
+ *
+ * @param ht The hash table.
+ * @param item The item to remove.
+ * @return The removed item or NULL if it could not be found.
+ */
+void * chashtab_remove(chashtab_s * ht, const void * item);
+
+/**
+ * Count the items in the hash table. While other threads are writing this is
+ * only an approximation.
+ *
+ * @param ht The hash table.
+ * @return The number of items.
+ */
+size_t chashtab_length(chashtab_s * ht);
+
+/**
+ * Iterate over all the items in the hash table. Every stripe is locked while
+ * its items are visited, so every item that is not added or removed during the
+ * iteration is visited exactly once. The callback must not add, insert or
+ * remove items in the same table.
+ *
+ * @param ht The hash table.
+ * @param cb The callback, receives the item and ctx.
+ * @param ctx Passed to the callback.
+ */
+void chashtab_forEach(chashtab_s * ht, void (*cb)(void * item, void * ctx),
+	void * ctx);
+
+/**
+ * De-allocate the hash table. No other thread may use it anymore.
+ *
+ * @param ht The hash table.
+ * @param cb A callback for each item still in the table, or NULL.
+ * @param ctx Passed to the callback.
+ */
+void chashtab_free(chashtab_s * ht, void (*cb)(void * item, void * ctx),
+	void * ctx);
+
+#endif /* CHASHTAB_H */
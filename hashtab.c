@@ -30,15 +30,53 @@
  * the software.
  */
 
+/* For clock_gettime, where there is one. */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 
 #include "hashtab.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #pragma GCC diagnostic ignored "-Wformat"
 
+/* The counters shared by a table and its snapshots, which may be freed on
+   other threads. Without GNU builtins or C11 atomics they're plain, then
+   snapshots must be freed on the writer's thread. */
+#ifdef __GNUC__
+#define HASHTAB_ATOMIC(type) type
+#define HASHTAB_ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define HASHTAB_ATOMIC_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define HASHTAB_ATOMIC_INC(p) \
+		((void) __atomic_add_fetch(p, 1, __ATOMIC_RELAXED))
+#define HASHTAB_ATOMIC_DEC(p) __atomic_sub_fetch(p, 1, __ATOMIC_ACQ_REL)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+		!defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define HASHTAB_ATOMIC(type) _Atomic type
+#define HASHTAB_ATOMIC_LOAD(p) atomic_load_explicit(p, memory_order_acquire)
+#define HASHTAB_ATOMIC_STORE(p, v) \
+		atomic_store_explicit(p, v, memory_order_release)
+#define HASHTAB_ATOMIC_INC(p) \
+		((void) atomic_fetch_add_explicit(p, 1, memory_order_relaxed))
+#define HASHTAB_ATOMIC_DEC(p) \
+		(atomic_fetch_sub_explicit(p, 1, memory_order_acq_rel) - 1)
+#else
+#define HASHTAB_ATOMIC(type) type
+#define HASHTAB_ATOMIC_LOAD(p) (*(p))
+#define HASHTAB_ATOMIC_STORE(p, v) ((void)(*(p) = (v)))
+#define HASHTAB_ATOMIC_INC(p) ((void) ++*(p))
+#define HASHTAB_ATOMIC_DEC(p) (--*(p))
+#endif
+
 #ifdef HAVE_UTIL_H
 #include HAVE_UTIL_H
 #else
@@ -83,12 +121,16 @@ static void * safeRealloc(void * p, size_t n){
 #endif
 
 /*
- * Start linklist functions.
+ * Start linklist functions. Those that aren't used by the hash table itself
+ * are only compiled when exported.
  */
 
+#ifndef HASHTAB_NO_EXPORT_LL
+
 LLEXPORT linklist_s * linklist_make(void * item, linklist_s * next){
 	linklist_s * ret = safeMalloc(sizeof *ret);
 	ret->item = item;
+	ret->hash = 0;
 	ret->next = next;
 	
 	return ret;
@@ -117,6 +159,21 @@ LLEXPORT linklist_s * linklist_find(linklist_s * ll, const void * item,
 	return NULL;
 }
 
+LLEXPORT linklist_s * linklist_findHash(linklist_s * ll, const void * item,
+		size_t hash, int (*cmp)(const void * needle, const void * hay)){
+	while(ll){
+		if(ll->hash == hash && cmp(item, ll->item) == 0){
+			return ll;
+		}
+		
+		ll = ll->next;
+	}
+	
+	return NULL;
+}
+
+#endif /* HASHTAB_NO_EXPORT_LL */
+
 LLEXPORT void linklist_forEach(linklist_s * ll, 
 		void (*callback)(void * item, void * ctx), void * ctx){
 	while(ll){
@@ -125,57 +182,59 @@ LLEXPORT void linklist_forEach(linklist_s * ll,
 	}
 }
 
+#ifndef HASHTAB_NO_EXPORT_LL
+
 LLEXPORT linklist_s * linklist_remove(linklist_s * ll, const void * item, 
 		int (*cmp)(const void * a, const void * b), void ** ret){
-	linklist_s * next;
-	if(!ll){
-		return NULL;
-	}
+	linklist_s ** ref, * link;
 	
-	if(cmp(item, ll->item) == 0){
-		if(ret){
-			*ret = ll->item;
+	/* Only the pointer to the removed link is written, misses write nothing. */
+	for(ref = &ll; (link = *ref); ref = &link->next){
+		if(cmp(item, link->item) == 0){
+			if(ret){
+				*ret = link->item;
+			}
+			
+			*ref = link->next;
+			free(link);
+			break;
 		}
-		
-		next = ll->next;
-		free(ll);
-		return next;
 	}
 	
-	ll->next = linklist_remove(ll->next, item, cmp, ret);
 	return ll;
 }
 
 LLEXPORT void linklist_free(linklist_s * ll, void (*cb)(void * item, void * ctx),
 		void * ctx){
-	if(ll){
-		linklist_free(ll->next, cb, ctx);
+	linklist_s * next;
+	
+	while(ll){
+		next = ll->next;
 		if(cb){
 			cb(ll->item, ctx);
 		}
 		free(ll);
+		ll = next;
 	}
 }
 
 LLEXPORT linklist_s * linklist_copy(const linklist_s * src, void * (cpy)(const
 		void * item, void * ctx), void * ctx){
-	linklist_s * ret = safeMalloc(sizeof *ret);
-	
-	if(src->next){
-		ret->next = linklist_copy(src->next, cpy, ctx);
-	}else{
-		ret->next = NULL;
-	}
+	linklist_s * ret, ** tail = &ret;
 	
-	if(cpy){
-		ret->item = cpy(src->item, ctx);
-	}else{
-		ret->item = src->item;
+	for(; src; src = src->next){
+		*tail = safeMalloc(sizeof **tail);
+		(*tail)->item = cpy ? cpy(src->item, ctx) : src->item;
+		(*tail)->hash = src->hash;
+		tail = &(*tail)->next;
 	}
+	*tail = NULL;
 	
 	return ret;
 }
 
+#endif /* HASHTAB_NO_EXPORT_LL */
+
 /* Print a linklist, using callback to print each item itself. */
 LLEXPORT void linklist_print(linklist_s * ll, void (*callback)(const void * item)){
 	while(ll){
@@ -190,341 +249,4041 @@ LLEXPORT void linklist_print(linklist_s * ll, void (*callback)(const void * item
 }
 
 /*
- * Start hashtab functions.
+ * Start memory functions.
  */
- 
-size_t hashtab_length(hashtab_s * ht){
-	return ht->length + (ht->other ? hashtab_length(ht->other) : 0);
-}
+
+/** @private The number of links in the first slab of a pool. */
+#define HASHTAB_SLAB_MIN 16
+/** @private The maximum number of links in a slab (later slabs double). */
+#define HASHTAB_SLAB_MAX 4096
+
+/** @private A block of links, allocated at once. */
+typedef struct hashtab_slab{
+	/** The previously allocated slab. */
+	struct hashtab_slab * next;
+	/** The links. */
+	linklist_s links[];
+} hashtab_slab_s;
+
+/**
+ * @private
+ *
+ * The allocator of a hash table and the pool its links come from. Shared by a
+ * table and its other tables.
+ */
+/** @private A snapshot, in the list of snapshots of a pool. */
+struct hashtab_snap{
+	/** The next (later) snapshot. */
+	struct hashtab_snap * next;
+	/** The number of snapshots taken before, and including, this one. */
+	size_t gen;
+	/** Set when the snapshot is freed (possibly on another thread). */
+	HASHTAB_ATOMIC(int) freed;
+};
+
+/** @private A chain replaced while snapshots shared it. */
+typedef struct hashtab_retired{
+	/** The first link. */
+	linklist_s * chain;
+	/** The latest snapshot when it was replaced: only it, and those before,
+	    can see the chain. */
+	size_t gen;
+} hashtab_retired_s;
+
+struct hashtab_pool{
+	/** The allocator, or all NULL for malloc & free. */
+	hashtab_alloc_s alloc;
+	/** Links that were released, linked through their next pointers. */
+	linklist_s * free;
+	/** The slabs allocated so far, the latest first. */
+	hashtab_slab_s * slabs;
+	/** The next unused link in the latest slab. */
+	linklist_s * unused;
+	/** The number of unused links left in the latest slab. */
+	size_t left;
+	/** The number of links in the next slab. */
+	size_t slabSize;
+	/** The number of links in all slabs. */
+	size_t links;
+	/** The number of (re-)allocations made for the tables of this pool. */
+	size_t allocs, reallocs;
+	/** The number of tables using the pool: the table itself and its
+	    snapshots. It's freed by the last one freed. */
+	HASHTAB_ATOMIC(size_t) refs;
+	/** The snapshots of the table that may not have been freed yet, the
+	    oldest first, and the latest. */
+	hashtab_snap_s * snaps, * lastSnap;
+	/** The number of snapshots taken so far. */
+	size_t gen;
+	/** The chains the table replaced by copies while snapshots shared them,
+	    the oldest first. */
+	hashtab_retired_s * retired;
+	/** The number of retired chains, and the room for them. */
+	size_t nRetired, maxRetired;
+#ifdef HASHTAB_COUNTERS
+	/** The number of lookups, and the links (or groups of slots) they probed
+	    and the cmp calls they made. */
+	size_t finds, probes, cmps;
+#endif
+};
+
+#ifdef HASHTAB_COUNTERS
+/** @private Adds n to a counter of the pool of ht. */
+#define HASHTAB_COUNT(ht, counter, n) ((ht)->pool->counter += (n))
+#else
+#define HASHTAB_COUNT(ht, counter, n) ((void) 0)
+#endif
 
 /**
  * @private
  *
- * Adds the provided link to the hash table. The next pointer in ll will be
- * overwritten, regardless of its original content. Updates ht->first as well.
+ * Allocates memory with the allocator of a pool. Failure is fatal, just like
+ * for safeMalloc.
  *
- * @param ht The hash table.
- * @param ll The link.
- * @return The hash of the item added.
+ * @param pool The pool.
+ * @param n The number of bytes.
+ * @return The memory.
  */
-static size_t hashtab_addLink(hashtab_s * ht, linklist_s * link){
-	size_t hash = ht->hasher(link->item) % ht->size;
+static void * hashtab_malloc(hashtab_pool_s * pool, size_t n){
+	void * p;
 	
-	link->next = NULL;
-	if(ht->data[hash] != NULL){
-		link->next = ht->data[hash];
-	}
+	++pool->allocs;
 	
-	ht->data[hash] = link;
-	++ht->length;
+	if(!pool->alloc.allocate){
+		return safeMalloc(n);
+	}
 	
-	if(ht->first > hash){
-		ht->first = hash;
+	p = pool->alloc.allocate(n, pool->alloc.ctx);
+	if(!p){
+		fprintf(stderr, "allocate(%u) failed\n", n);
+		exit(1);
 	}
 	
-	return hash;
+	++mallocs;
+	
+	return p;
 }
 
 /**
  * @private
  *
- * Adds all the links in the linklist to the hash table.
+ * Releases memory allocated with hashtab_malloc.
  *
- * @param ht The hash table.
- * @param link The linklist.
- * @return The number of items added.
+ * @param pool The pool.
+ * @param p The memory, may be NULL.
  */
-static size_t hashtab_linkAdd(hashtab_s * ht, linklist_s * ll){
-	size_t ret = 0;
-	linklist_s * next;
+static void hashtab_release(hashtab_pool_s * pool, void * p){
+	if(!pool->alloc.release){
+		free(p);
+	}else if(p){
+		pool->alloc.release(p, pool->alloc.ctx);
+	}
+}
+
+/**
+ * @private
+ *
+ * Re-allocates memory allocated with hashtab_malloc. Custom allocators have no
+ * realloc, so the memory is copied instead.
+ *
+ * @param pool The pool.
+ * @param p The memory.
+ * @param old The old number of bytes.
+ * @param n The new number of bytes.
+ * @return The re-allocated memory.
+ */
+static void * hashtab_realloc(hashtab_pool_s * pool, void * p, size_t old,
+		size_t n){
+	void * np;
 	
-	while(ll){
-		next = ll->next;
-		
-		hashtab_addLink(ht, ll);
-		
-		ll = next;
-		++ret;
+	++pool->reallocs;
+	
+	if(!pool->alloc.allocate){
+		return safeRealloc(p, n);
 	}
 	
-	return ret;
+	np = hashtab_malloc(pool, n);
+	--pool->allocs;
+	memcpy(np, p, old < n ? old : n);
+	hashtab_release(pool, p);
+	
+	++reallocs;
+	
+	return np;
 }
 
 /**
  * @private
  *
- * Finds the first non-empty (non-NULL) slot (bucket) in the hash table.
+ * Allocates an (empty) pool.
  *
- * @param ht The hash table.
- * @param i The starting position. If not 0 the caller must make sure there are
- *        no filled slots before this.
- * @return The updated ht->first.
+ * @param alloc The allocator to use, or NULL for malloc & free.
+ * @return The pool.
  */
-static size_t hashtab_findFirst(hashtab_s * ht, size_t i){
-	for(; i < ht->size && ht->data[i] == NULL; ++i);
+static hashtab_pool_s * hashtab_poolMake(const hashtab_alloc_s * alloc){
+	hashtab_pool_s * pool;
+	
+	if(alloc && alloc->allocate){
+		pool = alloc->allocate(sizeof *pool, alloc->ctx);
+		if(!pool){
+			fprintf(stderr, "allocate(%u) failed\n", sizeof *pool);
+			exit(1);
+		}
+		
+		++mallocs;
+		pool->alloc = *alloc;
+	}else{
+		pool = safeMalloc(sizeof *pool);
+		pool->alloc.allocate = NULL;
+		pool->alloc.release = NULL;
+		pool->alloc.ctx = NULL;
+	}
+	
+	pool->free = NULL;
+	pool->slabs = NULL;
+	pool->unused = NULL;
+	pool->left = 0;
+	pool->slabSize = HASHTAB_SLAB_MIN;
+	pool->links = 0;
+	pool->allocs = 1;
+	pool->reallocs = 0;
+	pool->refs = 1;
+	pool->snaps = NULL;
+	pool->lastSnap = NULL;
+	pool->gen = 0;
+	pool->retired = NULL;
+	pool->nRetired = 0;
+	pool->maxRetired = 0;
+#ifdef HASHTAB_COUNTERS
+	pool->finds = 0;
+	pool->probes = 0;
+	pool->cmps = 0;
+#endif
 	
-	return ht->first = i;
+	return pool;
 }
 
 /**
  * @private
- * 
- * Migrates exisiting items to the other table. Called when growing.
  *
- * @param ht The hash table.
+ * Frees a pool, releasing all slabs at once, whether their links are in use or
+ * not.
+ *
+ * @param pool The pool.
  */
-static void hashtab_moveOver(hashtab_s * ht){
-	size_t i, moved;
-	linklist_s * link;
+static void hashtab_poolFree(hashtab_pool_s * pool){
+	hashtab_slab_s * slab, * next;
+	hashtab_snap_s * snap, * nextSnap;
+	hashtab_alloc_s alloc = pool->alloc;
 	
-	for(i = 0; i < ht->size / ht->moveR && ht->length > 0; ++i){
-		link = ht->data[ht->first];
-		ht->data[ht->first] = NULL;
-		moved = hashtab_linkAdd(ht->other, link);
-		ht->length -= moved;
-	
-		hashtab_findFirst(ht, ht->first);
+	for(slab = pool->slabs; slab; slab = next){
+		next = slab->next;
+		hashtab_release(pool, slab);
+	}
+	for(snap = pool->snaps; snap; snap = nextSnap){
+		nextSnap = snap->next;
+		hashtab_release(pool, snap);
 	}
+	hashtab_release(pool, pool->retired);
 	
-	/* Merge the other table back into this one. */
-	if(ht->length == 0){
-		free(ht->data);
-		ht->data = ht->other->data;
-		ht->size = ht->other->size;
-		ht->length = ht->other->length;
-		ht->first = ht->other->first;
-		
-		free(ht->other);
-		ht->other = NULL;
+	if(alloc.release){
+		alloc.release(pool, alloc.ctx);
+	}else{
+		free(pool);
 	}
 }
 
 /**
- * @private 
+ * @private
  *
- * Re-hashes and moves all the links in the given linklist with the new size to
- * the new data store.
+ * Releases all slabs of a pool, which must have no links in use anymore.
  *
- * @param ll The linklist.
- * @param ht The hash table.
- * @param newData The new data store (bucket list).
- * @param newSize The size of the new data store.
- * @return The smallest non-empty index.
+ * @param pool The pool.
  */
-static size_t hashtab_rehashLink(linklist_s * ll, hashtab_s * ht, 
-		linklist_s ** newData, size_t newSize){
-	size_t hash, first = newSize;
-	linklist_s * next;
+static void hashtab_poolTrim(hashtab_pool_s * pool){
+	hashtab_slab_s * slab, * next;
 	
-	while(ll){
-		next = ll->next;
-		ll->next = NULL;
-		
-		hash = ht->hasher(ll->item) % newSize;
-		if(newData[hash] != NULL){
-			ll->next = newData[hash];
-		}
-		newData[hash] = ll;
-		
-		if(hash < first){
-			first = hash;
-		}
-		
-		ll = next;
+	for(slab = pool->slabs; slab; slab = next){
+		next = slab->next;
+		hashtab_release(pool, slab);
 	}
 	
-	return first;
+	pool->free = NULL;
+	pool->slabs = NULL;
+	pool->unused = NULL;
+	pool->left = 0;
+	pool->slabSize = HASHTAB_SLAB_MIN;
+	pool->links = 0;
 }
 
 /**
  * @private
  *
- * Re-hashes the entire table after either growing or shrinking. This re-hashing
- * is done inline, so some items may be re-hashed (at most) twice. Also safeReallocs
- * the data store of the table either before or after.
+ * Takes a link from the pool: a released one if there is any, otherwise a
+ * new one from the latest slab.
  *
- * @param ht The hash table.
- * @param newSize The new size of the table.
+ * @param pool The pool.
+ * @param item The item of the link.
+ * @param hash The hash of the item.
+ * @return The link, its next pointer is not set.
  */
-static void hashtab_rehash(hashtab_s * ht, size_t newSize){
-	size_t i, tfirst, first = newSize;
-	linklist_s * tdata;
-	
-	if(newSize > ht->size){ /* growth */
-		ht->data = safeRealloc(ht->data, newSize * sizeof *ht->data);
-		for(i = ht->size; i < newSize; i++){
-			ht->data[i] = NULL;
-		}
-	}
+static linklist_s * hashtab_linkMake(hashtab_pool_s * pool, void * item,
+		size_t hash){
+	linklist_s * link = pool->free;
+	hashtab_slab_s * slab;
 	
-	for(i = 0; i < ht->size; ++i){
-		if(ht->data[i] == NULL){
-			continue;
+	if(link){
+		pool->free = link->next;
+	}else{
+		if(!pool->left){
+			slab = hashtab_malloc(pool, sizeof *slab +
+					pool->slabSize * sizeof *slab->links);
+			slab->next = pool->slabs;
+			pool->slabs = slab;
+			pool->unused = slab->links;
+			pool->left = pool->slabSize;
+			pool->links += pool->slabSize;
+			
+			if(pool->slabSize < HASHTAB_SLAB_MAX){
+				pool->slabSize *= 2;
+			}
 		}
 		
-		tdata = ht->data[i];
-		ht->data[i] = NULL;
-		tfirst = hashtab_rehashLink(tdata, ht, ht->data, newSize);
-		if(tfirst < first){
-			first = tfirst;
-		}
+		link = pool->unused++;
+		--pool->left;
 	}
-	ht->first = first;
 	
-	if(newSize < ht->size){ /* shrinkage */
-		ht->data = safeRealloc(ht->data, ht->size * sizeof *ht->data);
-	}
+	link->item = item;
+	link->hash = hash;
 	
-	ht->size = newSize;
+	return link;
 }
 
 /**
  * @private
  *
- * Grows the table by either re-hashing (see above) or allocating a new table
- * for incremental resizing. Growing always happens by doubling the size.
+ * Allocates a block of links as a slab of its own, for tables that are built
+ * at once.
  *
- * @param ht The hash table.
+ * @param pool The pool.
+ * @param n The number of links.
+ * @return The links, none of their members are set.
  */
-static void hashtab_grow(hashtab_s * ht){
-	/* special case: no incremental resizing, but a complete rehash. */
-	if(ht->moveR == 1){
-		hashtab_rehash(ht, ht->size * 2);
-	}else{
-		ht->other = hashtab_make(ht->size * 2, ht->hasher, ht->cmp, 
-				ht->threshold, ht->moveR, ht->shrink);
-	}
+static linklist_s * hashtab_linksMake(hashtab_pool_s * pool, size_t n){
+	hashtab_slab_s * slab = hashtab_malloc(pool, sizeof *slab +
+			n * sizeof *slab->links);
 	
-	++ht->grows;
+	/* Pushing it keeps the unused links of the latest slab available. */
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->links += n;
+	
+	return slab->links;
 }
 
 /**
  * @private
  *
- * Finds the link containing item.
+ * Returns a link to the pool, for later re-use.
  *
- * @param ht The hash table.
- * @param item The item to find.
- * @return The link containing the item, or NULL if it's not in the table.
+ * @param pool The pool.
+ * @param link The link.
  */
-static linklist_s * hashtab_findLink(hashtab_s * ht, const void * item){
-	size_t hash = ht->hasher(item) % ht->size;
-	
-	linklist_s * datum = linklist_find(ht->data[hash], item, ht->cmp);
-	
-	if(datum == NULL && ht->other){
-		return hashtab_findLink(ht->other, item);
-	}
-	
-	return datum;
+static void hashtab_linkRelease(hashtab_pool_s * pool, linklist_s * link){
+	link->next = pool->free;
+	pool->free = link;
 }
 
-hashtab_s * hashtab_make(size_t size, 
-		size_t (*hasher)(const void * item), 
-		int (*cmp)(const void * a, const void * b), float threshold, 
-		size_t moveR, int shrink){
-	hashtab_s * ret = safeMalloc(sizeof *ret);
-	ret->size = size;
-	ret->length = 0;
-	
-	ret->hasher = hasher;
-	ret->cmp = cmp;
-	ret->threshold = threshold;
-	ret->moveR = moveR;
-	ret->shrink = (shrink ? 1 : 0) * size;
-	
-	ret->first = ret->size;
-	
-	ret->grows = 0;
-	ret->shrinks = 0;
-	
-	ret->data = safeMalloc(size * sizeof *(ret->data));
-	ret->other = NULL;
+/**
+ * @private
+ *
+ * Moves all slabs of a pool to another, along with the links in them, which
+ * then belong to the other pool. Both must have the same allocator.
+ *
+ * @param pool The pool to move the slabs to.
+ * @param from The pool to take them from, left without links.
+ */
+static void hashtab_poolSplice(hashtab_pool_s * pool, hashtab_pool_s * from){
+	hashtab_slab_s ** tail;
+	linklist_s * link, * next;
 	
-	for(size_t i = 0; i < size; i++){
-		ret->data[i] = NULL;
+	/* The latest slab of pool stays its latest, so the unused links of the
+	   latest slab of from are released instead. */
+	for(; from->left; --from->left){
+		hashtab_linkRelease(pool, from->unused++);
 	}
-	
-	return ret;
-}
-
-size_t hashtab_add(hashtab_s * ht, void * item){
-	if(!ht->other && hashtab_load(ht) > ht->threshold){
-		hashtab_grow(ht);
+	for(link = from->free; link; link = next){
+		next = link->next;
+		hashtab_linkRelease(pool, link);
 	}
 	
-	if(ht->other != NULL){
-		hashtab_add(ht->other, item);
+	if(from->slabs){
+		for(tail = &from->slabs; *tail; tail = &(*tail)->next);
 		
-		hashtab_moveOver(ht);
-	}else{
-		hashtab_addLink(ht, linklist_make(item, NULL));
+		if(pool->slabs){
+			*tail = pool->slabs->next;
+			pool->slabs->next = from->slabs;
+		}else{
+			pool->slabs = from->slabs;
+		}
 	}
+	pool->links += from->links;
 	
-	return ht->length;
+	from->free = NULL;
+	from->slabs = NULL;
+	from->unused = NULL;
+	from->slabSize = HASHTAB_SLAB_MIN;
+	from->links = 0;
 }
 
-void * hashtab_find(hashtab_s * ht, const void * item){
-	linklist_s * link = hashtab_findLink(ht, item);
+/*
+ * Start hash & bucket functions.
+ */
+
+size_t hashtab_mix(size_t h){
+#if SIZE_MAX > 0xFFFFFFFFu
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+#else
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+#endif
 	
-	return link ? link->item : NULL;
+	return h;
 }
 
-void * hashtab_insert(hashtab_s * ht, void * item){
-	linklist_s * link = hashtab_findLink(ht, item);
-	void * ret = NULL;
-	
-	if(link){
-		ret = link->item;
-		link->item = item;
-	}else{
-		hashtab_add(ht, item);
-	}
+/**
+ * @private
+ *
+ * Computes the (full) hash of an item (with the seed of seeded tables), mixing
+ * it if the table needs that.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ * @return The hash.
+ */
+static size_t hashtab_hash(const hashtab_s * ht, const void * item){
+	size_t hash = ht->seededHasher ? ht->seededHasher(item, ht->hashSeed) :
+			ht->hasher(item);
 	
-	return ret;
+	return ht->flags & HASHTAB_MIX ? hashtab_mix(hash) : hash;
 }
 
-void hashtab_forEach(hashtab_s * ht, 
-		void (*callback)(void * item, void * ctx), void * ctx){
-	size_t i;
-	
-	for(i = 0; i < ht->size; ++i){
-		if(ht->data[i]){ /* not strictly necessary, but avoids useless calls */
-			linklist_forEach(ht->data[i], callback, ctx);
-		}
-	}
-	
-	if(ht->other){
-		hashtab_forEach(ht->other, callback, ctx);
-	}
+/**
+ * @private
+ *
+ * Whether two tables hash items the same, so each can use the hashes the other
+ * cached.
+ *
+ * @param a A hash table.
+ * @param b Another hash table.
+ * @return Non-zero if they do.
+ */
+static int hashtab_sameHash(const hashtab_s * a, const hashtab_s * b){
+	return a->hasher == b->hasher && a->seededHasher == b->seededHasher &&
+			(!a->seededHasher || a->hashSeed == b->hashSeed) &&
+			(a->flags & HASHTAB_MIX) == (b->flags & HASHTAB_MIX);
 }
 
-void * hashtab_remove(hashtab_s * ht, const void * item){
-	void * ret = NULL;
-	size_t hash = ht->hasher(item) % ht->size;
-	
-	ht->data[hash] = linklist_remove(ht->data[hash], item, ht->cmp, &ret);
-	if(ht->other){
-		if(ret == NULL){
-			ret = hashtab_remove(ht->other, item);
-		}else{
+/**
+ * @private
+ *
+ * Selects the bucket (or first slot) for a hash: by masking for tables with
+ * power-of-two sizes, otherwise by taking the remainder.
+ *
+ * @param flags The flags of the table.
+ * @param hash The (full) hash.
+ * @param size The size of the table.
+ * @return The bucket.
+ */
+static size_t hashtab_bucket(int flags, size_t hash, size_t size){
+	return flags & HASHTAB_POW2 ? hash & (size - 1) : hash % size;
+}
+
+/**
+ * @private
+ *
+ * Rounds up to the next power of two.
+ *
+ * @param n The number.
+ * @return The smallest power of two >= n.
+ */
+static size_t hashtab_roundPow2(size_t n){
+	size_t p = 1;
+	
+	while(p < n){
+		p <<= 1;
+	}
+	
+	return p;
+}
+
+/*
+ * Start flat table functions.
+ */
+
+/** @private The number of control bytes probed at once. */
+#define HASHTAB_GROUP 8
+
+/** @private Control byte of a slot that has never held an item. */
+#define HASHTAB_EMPTY ((unsigned char)0x80)
+/** @private Control byte of a slot whose item was removed. */
+#define HASHTAB_DELETED ((unsigned char)0xFE)
+/** @private Whether a control byte belongs to a slot holding an item. */
+#define HASHTAB_ISFULL(c) (((c) & 0x80) == 0)
+
+#define HASHTAB_LSBS 0x0101010101010101ULL
+#define HASHTAB_MSBS 0x8080808080808080ULL
+
+/**
+ * @private
+ *
+ * Loads a group of control bytes such that the byte at ctrl[i] ends up in bits
+ * 8i to 8i+7.
+ *
+ * @param ctrl The first control byte.
+ * @return The group.
+ */
+static uint64_t hashtab_groupLoad(const unsigned char * ctrl){
+	uint64_t g = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(&g, ctrl, sizeof g);
+#else
+	int i;
+	
+	for(i = HASHTAB_GROUP - 1; i >= 0; --i){
+		g = (g << 8) | ctrl[i];
+	}
+#endif
+	
+	return g;
+}
+
+/**
+ * @private
+ *
+ * Counts the number of trailing zero bits.
+ *
+ * @param x The value, must not be 0.
+ * @return The number of trailing zeroes.
+ */
+static unsigned hashtab_ctz(uint64_t x){
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	unsigned n = 0;
+	
+	for(; !(x & 1); x >>= 1, ++n);
+	
+	return n;
+#endif
+}
+
+/**
+ * @private
+ *
+ * Counts the number of leading zero bits.
+ *
+ * @param x The value, must not be 0.
+ * @return The number of leading zeroes.
+ */
+static unsigned hashtab_clz(uint64_t x){
+#ifdef __GNUC__
+	return __builtin_clzll(x);
+#else
+	unsigned n = 0;
+	
+	for(; !(x & 0x8000000000000000ULL); x <<= 1, ++n);
+	
+	return n;
+#endif
+}
+
+/**
+ * @private
+ *
+ * Finds the control bytes in a group that are equal to tag. May report false
+ * positives (when the byte just after a match equals tag ^ 1), but never
+ * false negatives, and never reports anything if there are no true matches.
+ *
+ * @param g The group.
+ * @param tag The tag to look for.
+ * @return A mask with the high bit of each matching byte set.
+ */
+static uint64_t hashtab_groupMatch(uint64_t g, unsigned char tag){
+	uint64_t x = g ^ (HASHTAB_LSBS * tag);
+	
+	return (x - HASHTAB_LSBS) & ~x & HASHTAB_MSBS;
+}
+
+/**
+ * @private
+ *
+ * Finds the empty slots in a group.
+ *
+ * @param g The group.
+ * @return A mask with the high bit of each empty byte set.
+ */
+static uint64_t hashtab_groupEmpty(uint64_t g){
+	return g & ~(g << 6) & HASHTAB_MSBS;
+}
+
+/**
+ * @private
+ *
+ * Finds the empty or deleted slots in a group.
+ *
+ * @param g The group.
+ * @return A mask with the high bit of each empty or deleted byte set.
+ */
+static uint64_t hashtab_groupFree(uint64_t g){
+	return g & ~(g << 7) & HASHTAB_MSBS;
+}
+
+/**
+ * @private
+ *
+ * Derives the 7-bit tag stored in the control byte from a hash. The hash is
+ * mixed so that weak hashes (with few significant bits) still yield
+ * different tags.
+ *
+ * @param hash The hash.
+ * @return The tag.
+ */
+static unsigned char hashtab_tag(size_t hash){
+	return (unsigned char)(((uint64_t)hash * 0x9E3779B97F4A7C15ULL) >> 57);
+}
+
+/**
+ * @private
+ *
+ * Sets a control byte. The first HASHTAB_GROUP - 1 bytes are mirrored after
+ * the end of the array, so a group can be loaded at any slot.
+ *
+ * @param ht The hash table.
+ * @param i The slot.
+ * @param c The new control byte.
+ */
+static void hashtab_setCtrl(hashtab_s * ht, size_t i, unsigned char c){
+	ht->ctrl[i] = c;
+	if(i < HASHTAB_GROUP - 1){
+		ht->ctrl[ht->size + i] = c;
+	}
+}
+
+/**
+ * @private
+ *
+ * Allocates (empty) slots and control bytes for a flat table. Any previous
+ * arrays are not freed.
+ *
+ * @param ht The hash table.
+ * @param size The new size, at least HASHTAB_GROUP.
+ */
+static void hashtab_flatAlloc(hashtab_s * ht, size_t size){
+	ht->size = size;
+	ht->length = 0;
+	ht->deleted = 0;
+	ht->first = size;
+	
+	ht->ctrl = hashtab_malloc(ht->pool, size + HASHTAB_GROUP - 1);
+	memset(ht->ctrl, HASHTAB_EMPTY, size + HASHTAB_GROUP - 1);
+	ht->slots = hashtab_malloc(ht->pool, size * sizeof *ht->slots);
+	ht->hashes = hashtab_malloc(ht->pool, size * sizeof *ht->hashes);
+}
+
+/**
+ * @private
+ *
+ * The maximum number of used (full or deleted) slots before a flat table must
+ * be resized. Flat tables always keep some empty slots, or unsuccessful
+ * searches would never terminate.
+ *
+ * @param ht The hash table.
+ * @return The limit.
+ */
+static size_t hashtab_flatLimit(const hashtab_s * ht){
+	float threshold = ht->threshold < 0.875f ? ht->threshold : 0.875f;
+	
+	return (size_t)(threshold * (float)ht->size);
+}
+
+/*
+ * Robin Hood tables (HASHTAB_ROBIN) are flat tables that keep every item's
+ * distance from its home slot (where its probe sequence starts) in its
+ * control byte, probing one slot at a time. An item being placed takes the
+ * slot of any item closer to its own home, which moves on instead, so all
+ * items stay about as far from home. Hence a search can stop as soon as it
+ * meets an item closer to home than itself, and deletion shifts the items
+ * after a slot back instead of leaving a tombstone. Control bytes are full
+ * slots for the other flat functions, so those work unchanged.
+ */
+
+/** @private The control byte of items at least this far from home. */
+#define HASHTAB_ROBIN_FAR 0x7F
+
+/**
+ * @private
+ *
+ * The distance of the item in slot i from its home slot.
+ *
+ * @param ht The hash table.
+ * @param i The (full) slot.
+ * @return The distance.
+ */
+static size_t hashtab_robinDist(const hashtab_s * ht, size_t i){
+	size_t home;
+	
+	if(ht->ctrl[i] < HASHTAB_ROBIN_FAR){
+		return ht->ctrl[i];
+	}
+	
+	home = hashtab_bucket(ht->flags, ht->hashes[i], ht->size);
+	
+	return i >= home ? i - home : i + ht->size - home;
+}
+
+/**
+ * @private
+ *
+ * Fills slot i with an item at distance d from its home slot.
+ *
+ * @param ht The hash table.
+ * @param i The slot.
+ * @param item The item.
+ * @param hash The (full) hash of item.
+ * @param d The distance.
+ */
+static void hashtab_robinSet(hashtab_s * ht, size_t i, void * item,
+		size_t hash, size_t d){
+	hashtab_setCtrl(ht, i, d < HASHTAB_ROBIN_FAR ? (unsigned char) d :
+			HASHTAB_ROBIN_FAR);
+	ht->slots[i] = item;
+	ht->hashes[i] = hash;
+}
+
+/**
+ * @private
+ *
+ * Finds the slot holding item in a Robin Hood table, see hashtab_flatFind.
+ */
+static size_t hashtab_robinFind(const hashtab_s * ht, const void * item,
+		size_t hash){
+	size_t i = hashtab_bucket(ht->flags, hash, ht->size), d;
+	unsigned char c, far;
+	
+	for(d = 0; d < ht->size; ++d){
+		c = ht->ctrl[i];
+		far = d < HASHTAB_ROBIN_FAR ? (unsigned char) d : HASHTAB_ROBIN_FAR;
+		HASHTAB_COUNT(ht, probes, 1);
+		
+		/* Had item been placed this far, it would have taken this slot. */
+		if(!HASHTAB_ISFULL(c) || c < far){
+			break;
+		}
+		
+		/* Only items as far from home can have the same home. */
+		if(c == far && ht->hashes[i] == hash){
+			HASHTAB_COUNT(ht, cmps, 1);
+			if(ht->cmp(item, ht->slots[i]) == 0){
+				return i;
+			}
+		}
+		
+		if(++i == ht->size){
+			i = 0;
+		}
+	}
+	
+	return ht->size;
+}
+
+/**
+ * @private
+ *
+ * Places item in a Robin Hood table, see hashtab_flatPlace.
+ */
+static size_t hashtab_robinPlace(hashtab_s * ht, void * item, size_t hash){
+	size_t i = hashtab_bucket(ht->flags, hash, ht->size), d = 0, e, ret;
+	size_t thash;
+	void * titem;
+	
+	ret = ht->size;
+	
+	while(HASHTAB_ISFULL(ht->ctrl[i])){
+		e = hashtab_robinDist(ht, i);
+		
+		if(e < d){
+			titem = ht->slots[i];
+			thash = ht->hashes[i];
+			hashtab_robinSet(ht, i, item, hash, d);
+			if(ret == ht->size){
+				ret = i;
+			}
+			
+			item = titem;
+			hash = thash;
+			d = e;
+		}
+		
+		++d;
+		if(++i == ht->size){
+			i = 0;
+		}
+	}
+	
+	hashtab_robinSet(ht, i, item, hash, d);
+	++ht->length;
+	
+	if(ht->first > i){
+		ht->first = i;
+	}
+	
+	return ret == ht->size ? i : ret;
+}
+
+/**
+ * @private
+ *
+ * Empties a full slot of a Robin Hood table, shifting the items after it
+ * that aren't in their home slot back by one.
+ *
+ * @param ht The hash table.
+ * @param i The slot.
+ */
+static void hashtab_robinErase(hashtab_s * ht, size_t i){
+	size_t j = i + 1 == ht->size ? 0 : i + 1, d;
+	
+	while(HASHTAB_ISFULL(ht->ctrl[j]) && (d = hashtab_robinDist(ht, j)) > 0){
+		hashtab_robinSet(ht, i, ht->slots[j], ht->hashes[j], d - 1);
+		i = j;
+		j = j + 1 == ht->size ? 0 : j + 1;
+	}
+	
+	hashtab_setCtrl(ht, i, HASHTAB_EMPTY);
+	--ht->length;
+}
+
+/**
+ * @private
+ *
+ * Finds the slot holding item. It can also find the slot the item would be
+ * placed in by hashtab_flatPlace: the first free one along the way.
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @param hash The (full) hash of item.
+ * @param [out] avail Receives the first free slot, may be NULL. Left as it is
+ *        if the item is found before a free slot, or there is none.
+ * @return The slot, or ht->size if the item is not in this table.
+ */
+static size_t hashtab_flatFind(const hashtab_s * ht, const void * item,
+		size_t hash, size_t * avail){
+	size_t pos = hashtab_bucket(ht->flags, hash, ht->size), i, probed;
+	unsigned char tag = hashtab_tag(hash);
+	uint64_t group, match, free;
+	
+	if(ht->flags & HASHTAB_ROBIN){
+		return hashtab_robinFind(ht, item, hash);
+	}
+	
+	for(probed = 0; probed < ht->size; probed += HASHTAB_GROUP){
+		group = hashtab_groupLoad(ht->ctrl + pos);
+		HASHTAB_COUNT(ht, probes, 1);
+		
+		if(avail && (free = hashtab_groupFree(group))){
+			*avail = pos + hashtab_ctz(free) / 8;
+			if(*avail >= ht->size){
+				*avail -= ht->size;
+			}
+			avail = NULL;
+		}
+		
+		for(match = hashtab_groupMatch(group, tag); match; match &= match - 1){
+			i = pos + hashtab_ctz(match) / 8;
+			if(i >= ht->size){
+				i -= ht->size;
+			}
+			
+			HASHTAB_COUNT(ht, cmps, 1);
+			if(ht->cmp(item, ht->slots[i]) == 0){
+				return i;
+			}
+		}
+		
+		/* An empty slot means item was never placed further along. */
+		if(hashtab_groupEmpty(group)){
+			break;
+		}
+		
+		pos += HASHTAB_GROUP;
+		if(pos >= ht->size){
+			pos -= ht->size;
+		}
+	}
+	
+	return ht->size;
+}
+
+/**
+ * @private
+ *
+ * Places item in a free slot. Updates ht->first as well.
+ *
+ * @param ht The hash table.
+ * @param i The free slot, see hashtab_flatPlace.
+ * @param item The item.
+ * @param hash The (full) hash of item.
+ * @return The slot.
+ */
+static size_t hashtab_flatPut(hashtab_s * ht, size_t i, void * item,
+		size_t hash){
+	if(ht->ctrl[i] == HASHTAB_DELETED){
+		--ht->deleted;
+	}
+	hashtab_setCtrl(ht, i, hashtab_tag(hash));
+	ht->slots[i] = item;
+	ht->hashes[i] = hash;
+	++ht->length;
+	
+	if(ht->first > i){
+		ht->first = i;
+	}
+	
+	return i;
+}
+
+/**
+ * @private
+ *
+ * Places item in the first free slot of its probe sequence. The caller must
+ * make sure there is a free slot. Updates ht->first as well.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ * @param hash The (full) hash of item.
+ * @return The slot the item was placed in.
+ */
+static size_t hashtab_flatPlace(hashtab_s * ht, void * item, size_t hash){
+	size_t pos = hashtab_bucket(ht->flags, hash, ht->size), i;
+	uint64_t avail;
+	
+	if(ht->flags & HASHTAB_ROBIN){
+		return hashtab_robinPlace(ht, item, hash);
+	}
+	
+	while(!(avail = hashtab_groupFree(hashtab_groupLoad(ht->ctrl + pos)))){
+		pos += HASHTAB_GROUP;
+		if(pos >= ht->size){
+			pos -= ht->size;
+		}
+	}
+	
+	i = pos + hashtab_ctz(avail) / 8;
+	if(i >= ht->size){
+		i -= ht->size;
+	}
+	
+	return hashtab_flatPut(ht, i, item, hash);
+}
+
+/**
+ * @private
+ *
+ * Empties a full slot. If no probe sequence can have passed over the slot
+ * (there's an empty slot in every group containing it) it's marked empty,
+ * otherwise it becomes a tombstone.
+ *
+ * @param ht The hash table.
+ * @param i The slot.
+ */
+static void hashtab_flatErase(hashtab_s * ht, size_t i){
+	size_t before = (i >= HASHTAB_GROUP ? i : i + ht->size) - HASHTAB_GROUP;
+	uint64_t emptyAfter = hashtab_groupEmpty(hashtab_groupLoad(ht->ctrl + i));
+	uint64_t emptyBefore = hashtab_groupEmpty(hashtab_groupLoad(ht->ctrl + before));
+	
+	if(ht->flags & HASHTAB_ROBIN){
+		hashtab_robinErase(ht, i);
+		return;
+	}
+	
+	if(emptyAfter && emptyBefore && hashtab_ctz(emptyAfter) / 8 +
+			hashtab_clz(emptyBefore) / 8 < HASHTAB_GROUP){
+		hashtab_setCtrl(ht, i, HASHTAB_EMPTY);
+	}else{
+		hashtab_setCtrl(ht, i, HASHTAB_DELETED);
+		++ht->deleted;
+	}
+	
+	--ht->length;
+}
+
+/**
+ * @private
+ *
+ * Finds the next full slot, starting at i.
+ *
+ * @param ht The hash table.
+ * @param i The starting position.
+ * @return The slot, or ht->size if there are no more items.
+ */
+static size_t hashtab_flatNext(const hashtab_s * ht, size_t i){
+	uint64_t full;
+	
+	/* The mirrored bytes after the end may report slots at or past size. */
+	for(; i < ht->size; i += HASHTAB_GROUP){
+		full = ~hashtab_groupLoad(ht->ctrl + i) & HASHTAB_MSBS;
+		if(full){
+			i += hashtab_ctz(full) / 8;
+			
+			return i < ht->size ? i : ht->size;
+		}
+	}
+	
+	return ht->size;
+}
+
+/**
+ * @private
+ *
+ * Re-hashes a flat table into freshly allocated slots of the new size, using
+ * the cached hashes. This also drops any tombstones.
+ *
+ * @param ht The hash table.
+ * @param newSize The new size of the table.
+ */
+static void hashtab_flatRehash(hashtab_s * ht, size_t newSize){
+	unsigned char * ctrl = ht->ctrl;
+	void ** slots = ht->slots;
+	size_t * hashes = ht->hashes;
+	size_t i, size = ht->size;
+	
+	hashtab_flatAlloc(ht, newSize);
+	
+	for(i = 0; i < size; ++i){
+		if(HASHTAB_ISFULL(ctrl[i])){
+			hashtab_flatPlace(ht, slots[i], hashes[i]);
+		}
+	}
+	
+	hashtab_release(ht->pool, ctrl);
+	hashtab_release(ht->pool, slots);
+	hashtab_release(ht->pool, hashes);
+}
+
+/*
+ * Start occupancy bitmap functions.
+ */
+
+/** @private The number of buckets per word of an occupancy bitmap. */
+#define HASHTAB_WORD 64
+
+/**
+ * @private
+ *
+ * Allocates an occupancy bitmap with all buckets marked empty.
+ *
+ * @param pool The pool to allocate from.
+ * @param size The number of buckets.
+ * @return The bitmap.
+ */
+static uint64_t * hashtab_bitsMake(hashtab_pool_s * pool, size_t size){
+	size_t n = (size + HASHTAB_WORD - 1) / HASHTAB_WORD;
+	uint64_t * bits = hashtab_malloc(pool, (n ? n : 1) * sizeof *bits);
+	
+	memset(bits, 0, (n ? n : 1) * sizeof *bits);
+	
+	return bits;
+}
+
+/**
+ * @private
+ *
+ * Marks a bucket as non-empty.
+ *
+ * @param bits The bitmap.
+ * @param i The bucket.
+ */
+static void hashtab_bitSet(uint64_t * bits, size_t i){
+	bits[i / HASHTAB_WORD] |= (uint64_t)1 << (i % HASHTAB_WORD);
+}
+
+/**
+ * @private
+ *
+ * Marks a bucket as empty.
+ *
+ * @param bits The bitmap.
+ * @param i The bucket.
+ */
+static void hashtab_bitClear(uint64_t * bits, size_t i){
+	bits[i / HASHTAB_WORD] &= ~((uint64_t)1 << (i % HASHTAB_WORD));
+}
+
+/**
+ * @private
+ *
+ * Whether a bucket is marked in a bitmap.
+ *
+ * @param bits The bitmap.
+ * @param i The bucket.
+ * @return Non-zero if it is.
+ */
+static int hashtab_bitTest(const uint64_t * bits, size_t i){
+	return (bits[i / HASHTAB_WORD] >> (i % HASHTAB_WORD)) & 1;
+}
+
+/**
+ * @private
+ *
+ * Finds the next non-empty bucket in a bitmap, skipping 64 empty buckets at a
+ * time.
+ *
+ * @param bits The bitmap.
+ * @param i The starting position.
+ * @param size The number of buckets.
+ * @return The bucket, or size if there are no more non-empty buckets.
+ */
+static size_t hashtab_bitNext(const uint64_t * bits, size_t i, size_t size){
+	size_t w = i / HASHTAB_WORD;
+	size_t words = (size + HASHTAB_WORD - 1) / HASHTAB_WORD;
+	uint64_t word;
+	
+	if(i >= size){
+		return size;
+	}
+	
+	for(word = bits[w] & (~(uint64_t)0 << (i % HASHTAB_WORD)); !word;
+			word = bits[w]){
+		if(++w >= words){
+			return size;
+		}
+	}
+	
+	return w * HASHTAB_WORD + hashtab_ctz(word);
+}
+
+/*
+ * Start compact bucket functions. Compact tables (HASHTAB_COMPACT) keep their
+ * buckets in ht->slots instead of ht->data: NULL if the bucket is empty, the
+ * item itself if it's the only one, or else the first link of its chain with
+ * the lowest bit set (items are at least 2-byte aligned, so theirs is clear).
+ */
+
+/** @private Whether a compact bucket holds a chain (rather than one item). */
+#define HASHTAB_TAGGED(b) (((uintptr_t)(b) & 1) != 0)
+
+/**
+ * @private
+ *
+ * Makes the bucket of a chain in a compact table.
+ *
+ * @param link The first link of the chain.
+ * @return The bucket.
+ */
+static void * hashtab_tagged(linklist_s * link){
+	return (void *)((uintptr_t)link | 1);
+}
+
+/**
+ * @private
+ *
+ * Gets the chain out of a compact bucket that holds one.
+ *
+ * @param b The bucket.
+ * @return The first link of the chain.
+ */
+static linklist_s * hashtab_untag(const void * b){
+	return (linklist_s *)((uintptr_t)b & ~(uintptr_t)1);
+}
+
+/**
+ * @private
+ *
+ * The links of a bucket in a chained table. In compact tables only chains have
+ * links, a bucket with a single item has none.
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket.
+ * @return The first link, or NULL.
+ */
+static linklist_s * hashtab_links(const hashtab_s * ht, size_t i){
+	if(!(ht->flags & HASHTAB_COMPACT)){
+		return ht->data[i];
+	}
+	
+	return HASHTAB_TAGGED(ht->slots[i]) ? hashtab_untag(ht->slots[i]) : NULL;
+}
+
+/**
+ * @private
+ *
+ * The items of a bucket in a chained table, as a linklist. A single item in a
+ * compact table is put in a given link (its hash is not set, as it isn't
+ * cached).
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket.
+ * @param one The link for a single item.
+ * @return The first link, or NULL if the bucket is empty.
+ */
+static linklist_s * hashtab_chain(const hashtab_s * ht, size_t i,
+		linklist_s * one){
+	if(ht->flags & HASHTAB_COMPACT && ht->slots[i] &&
+			!HASHTAB_TAGGED(ht->slots[i])){
+		one->item = ht->slots[i];
+		one->next = NULL;
+		
+		return one;
+	}
+	
+	return hashtab_links(ht, i);
+}
+
+/*
+ * Start copy-on-write functions, for tables with snapshots.
+ */
+
+/**
+ * @private
+ *
+ * Forgets the snapshots that were freed (up to the oldest one that wasn't),
+ * and re-uses the links of the retired chains no snapshot can see anymore.
+ *
+ * @param pool The pool.
+ */
+static void hashtab_reclaim(hashtab_pool_s * pool){
+	hashtab_snap_s * snap;
+	linklist_s * link, * next;
+	size_t i, n;
+	
+	while((snap = pool->snaps) &&
+			HASHTAB_ATOMIC_LOAD(&snap->freed)){
+		pool->snaps = snap->next;
+		hashtab_release(pool, snap);
+	}
+	if(!pool->snaps){
+		pool->lastSnap = NULL;
+	}
+	
+	for(n = 0; n < pool->nRetired && (!pool->snaps ||
+			pool->retired[n].gen < pool->snaps->gen); ++n){
+		for(link = pool->retired[n].chain; link; link = next){
+			next = link->next;
+			hashtab_linkRelease(pool, link);
+		}
+	}
+	
+	if(n > 0){
+		for(i = n; i < pool->nRetired; ++i){
+			pool->retired[i - n] = pool->retired[i];
+		}
+		pool->nRetired -= n;
+	}
+}
+
+/**
+ * @private
+ *
+ * Whether snapshots may share the chain of a bucket. Once the snapshots are
+ * all freed nothing is shared anymore, and the table stops keeping track.
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket.
+ * @return 1 if shared, 0 if the chain is the table's own.
+ */
+static int hashtab_shared(hashtab_s * ht, size_t i){
+	hashtab_pool_s * pool = ht->pool;
+	
+	if(!ht->owned || hashtab_bitTest(ht->owned, i)){
+		return 0;
+	}
+	
+	hashtab_reclaim(pool);
+	if(!pool->snaps){
+		hashtab_release(pool, ht->owned);
+		ht->owned = NULL;
+		
+		return 0;
+	}
+	
+	return 1;
+}
+
+/**
+ * @private
+ *
+ * Retires a chain the table no longer uses, but snapshots may: it's left as it
+ * is until the snapshots that can see it are freed.
+ *
+ * @param pool The pool.
+ * @param link The first link of the chain.
+ */
+static void hashtab_retire(hashtab_pool_s * pool, linklist_s * link){
+	if(pool->nRetired == pool->maxRetired){
+		if(pool->retired){
+			pool->retired = hashtab_realloc(pool, pool->retired,
+					pool->maxRetired * sizeof *pool->retired,
+					2 * pool->maxRetired * sizeof *pool->retired);
+			pool->maxRetired *= 2;
+		}else{
+			pool->maxRetired = 16;
+			pool->retired = hashtab_malloc(pool, pool->maxRetired *
+					sizeof *pool->retired);
+		}
+	}
+	pool->retired[pool->nRetired].chain = link;
+	pool->retired[pool->nRetired++].gen = pool->gen;
+}
+
+/**
+ * @private
+ *
+ * Lets go of the chains of a chained table that drops all its links at once:
+ * the shared ones are retired, and the table's own are re-used.
+ *
+ * @param ht The hash table (not its other tables).
+ */
+static void hashtab_dropChains(hashtab_s * ht){
+	linklist_s * link, * next;
+	size_t i;
+	
+	for(i = hashtab_bitNext(ht->occupied, 0, ht->size); i < ht->size;
+			i = hashtab_bitNext(ht->occupied, i + 1, ht->size)){
+		if(!(link = hashtab_links(ht, i))){
+			continue;
+		}
+		
+		if(hashtab_shared(ht, i)){
+			hashtab_retire(ht->pool, link);
+			continue;
+		}
+		
+		for(; link; link = next){
+			next = link->next;
+			hashtab_linkRelease(ht->pool, link);
+		}
+	}
+}
+
+/**
+ * @private
+ *
+ * Makes the chain of a bucket the table's own before the table changes it:
+ * while snapshots may share it its links are copied, and the shared ones are
+ * retired (left as they are, for the snapshots).
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket.
+ */
+static void hashtab_own(hashtab_s * ht, size_t i){
+	hashtab_pool_s * pool = ht->pool;
+	linklist_s * link, * head, ** tail = &head;
+	
+	if(!hashtab_shared(ht, i)){
+		return;
+	}
+	
+	hashtab_bitSet(ht->owned, i);
+	
+	if(!(link = hashtab_links(ht, i))){
+		return;
+	}
+	
+	hashtab_retire(pool, link);
+	
+	for(; link; link = link->next){
+		*tail = hashtab_linkMake(pool, link->item, link->hash);
+		tail = &(*tail)->next;
+	}
+	*tail = NULL;
+	
+	if(ht->flags & HASHTAB_COMPACT){
+		ht->slots[i] = hashtab_tagged(head);
+	}else{
+		ht->data[i] = head;
+	}
+}
+
+/**
+ * @private
+ *
+ * Makes the chains of all buckets the table's own, see hashtab_own.
+ *
+ * @param ht The hash table (not its other tables).
+ */
+static void hashtab_ownAll(hashtab_s * ht){
+	size_t i;
+	
+	for(i = hashtab_bitNext(ht->occupied, 0, ht->size); ht->owned &&
+			i < ht->size; i = hashtab_bitNext(ht->occupied, i + 1, ht->size)){
+		hashtab_own(ht, i);
+	}
+}
+
+/**
+ * @private
+ *
+ * Allocates the (empty) buckets of a chained table and its occupancy bitmap.
+ *
+ * @param ht The hash table.
+ * @param size The number of buckets.
+ */
+static void hashtab_bucketsMake(hashtab_s * ht, size_t size){
+	size_t i;
+	
+	ht->occupied = hashtab_bitsMake(ht->pool, size);
+	
+	if(ht->flags & HASHTAB_COMPACT){
+		ht->slots = hashtab_malloc(ht->pool, size * sizeof *ht->slots);
+		for(i = 0; i < size; i++){
+			ht->slots[i] = NULL;
+		}
+	}else{
+		ht->data = hashtab_malloc(ht->pool, size * sizeof *ht->data);
+		for(i = 0; i < size; i++){
+			ht->data[i] = NULL;
+		}
+	}
+}
+
+/*
+ * Start hashtab functions.
+ */
+ 
+size_t hashtab_length(hashtab_s * ht){
+	return ht->length + (ht->other ? hashtab_length(ht->other) : 0);
+}
+
+/**
+ * @private
+ *
+ * The number of non-empty buckets (or full slots) hashtab_migrateStep moves
+ * between looking at the clock, and operations move when migration is left to
+ * it (move rate 0) but can't wait.
+ */
+#define HASHTAB_STEP 64
+
+/**
+ * @private
+ *
+ * The number of non-empty buckets (or full slots) to move per operation when
+ * migrating. At least one, so migration always finishes.
+ *
+ * @param ht The hash table.
+ * @return The number of buckets to move.
+ */
+static size_t hashtab_moveCount(const hashtab_s * ht){
+	size_t n = ht->moveR ? ht->size / ht->moveR : HASHTAB_STEP;
+	
+	return n ? n : 1;
+}
+
+/**
+ * @private
+ *
+ * Adds the provided link to the hash table, in the bucket of its cached hash.
+ * The next pointer in ll will be overwritten, regardless of its original
+ * content. Updates ht->first as well. Compact tables store the item in an
+ * empty bucket by itself and release the link, and make a link for an item
+ * that was by itself before (hashing it again).
+ *
+ * @param ht The hash table.
+ * @param ll The link.
+ * @return The bucket of the item added.
+ */
+static size_t hashtab_addLink(hashtab_s * ht, linklist_s * link){
+	size_t hash = hashtab_bucket(ht->flags, link->hash, ht->size);
+	void * b;
+	
+	hashtab_own(ht, hash);
+	
+	if(ht->flags & HASHTAB_COMPACT){
+		b = ht->slots[hash];
+		
+		if(b == NULL){
+			ht->slots[hash] = link->item;
+			hashtab_linkRelease(ht->pool, link);
+		}else{
+			if(HASHTAB_TAGGED(b)){
+				link->next = hashtab_untag(b);
+			}else{
+				link->next = hashtab_linkMake(ht->pool, b, hashtab_hash(ht, b));
+				link->next->next = NULL;
+			}
+			
+			ht->slots[hash] = hashtab_tagged(link);
+		}
+	}else{
+		link->next = NULL;
+		if(ht->data[hash] != NULL){
+			link->next = ht->data[hash];
+		}
+		
+		ht->data[hash] = link;
+	}
+	
+	hashtab_bitSet(ht->occupied, hash);
+	++ht->length;
+	
+	if(ht->first > hash){
+		ht->first = hash;
+	}
+	
+	return hash;
+}
+
+/**
+ * @private
+ *
+ * Adds a new item to a chained table, without a link if it's by itself in a
+ * bucket of a compact table.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ * @param hash The (full) hash of item.
+ * @return The bucket of the item added.
+ */
+static size_t hashtab_addItem(hashtab_s * ht, void * item, size_t hash){
+	size_t i = hashtab_bucket(ht->flags, hash, ht->size);
+	
+	if(!(ht->flags & HASHTAB_COMPACT) || ht->slots[i] != NULL){
+		return hashtab_addLink(ht, hashtab_linkMake(ht->pool, item, hash));
+	}
+	
+	ht->slots[i] = item;
+	hashtab_bitSet(ht->occupied, i);
+	++ht->length;
+	
+	if(ht->first > i){
+		ht->first = i;
+	}
+	
+	return i;
+}
+
+/**
+ * @private
+ *
+ * Whether an item just added to a table landed too far from where it's found
+ * first, see maxChain. In chained tables: if its bucket holds more than
+ * maxChain items with other hashes among the first 2 * maxChain. Those with
+ * the same hash aren't counted: they're most likely duplicates, which no seed
+ * sets apart. In flat tables: if it's more than maxChain groups of slots from
+ * where its probe starts.
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket (or slot) of the item.
+ * @param hash The (full) hash of the item.
+ * @return Non-zero if the item is too far.
+ */
+static int hashtab_flooded(const hashtab_s * ht, size_t i, size_t hash){
+	size_t n = 0, seen = 0, start;
+	linklist_s * link;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		start = hashtab_bucket(ht->flags, hash, ht->size);
+		
+		return (i >= start ? i - start : i + ht->size - start) /
+				HASHTAB_GROUP > ht->maxChain;
+	}
+	
+	for(link = hashtab_links(ht, i); link && seen < 2 * ht->maxChain;
+			link = link->next, ++seen){
+		if(link->hash != hash && ++n > ht->maxChain){
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+ * @private
+ *
+ * Adds all the links in the linklist to the hash table.
+ *
+ * @param ht The hash table.
+ * @param link The linklist.
+ * @return The number of items added.
+ */
+static size_t hashtab_linkAdd(hashtab_s * ht, linklist_s * ll){
+	size_t ret = 0;
+	linklist_s * next;
+	
+	while(ll){
+		next = ll->next;
+		
+		hashtab_addLink(ht, ll);
+		
+		ll = next;
+		++ret;
+	}
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Finds the next non-empty bucket (or full slot in flat tables).
+ *
+ * @param ht The hash table.
+ * @param i The starting position.
+ * @return The bucket, or ht->size if there are no more items.
+ */
+static size_t hashtab_next(const hashtab_s * ht, size_t i){
+	if(ht->flags & HASHTAB_FLAT){
+		return hashtab_flatNext(ht, i);
+	}
+	
+	return hashtab_bitNext(ht->occupied, i, ht->size);
+}
+
+static int hashtab_addHash(hashtab_s * ht, void * item, size_t hash);
+
+/**
+ * @private
+ *
+ * Merges the other table back into this one, once this one is empty: takes
+ * over its buckets (or slots) and releases it. If it is migrating itself its
+ * own other table takes its place.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_absorb(hashtab_s * ht){
+	hashtab_s * other = ht->other;
+	
+	hashtab_release(ht->pool, ht->data);
+	hashtab_release(ht->pool, ht->occupied);
+	hashtab_release(ht->pool, ht->owned);
+	hashtab_release(ht->pool, ht->ctrl);
+	hashtab_release(ht->pool, ht->slots);
+	hashtab_release(ht->pool, ht->hashes);
+	ht->data = other->data;
+	ht->occupied = other->occupied;
+	ht->owned = other->owned;
+	ht->ctrl = other->ctrl;
+	ht->slots = other->slots;
+	ht->hashes = other->hashes;
+	ht->size = other->size;
+	ht->length = other->length;
+	ht->deleted = other->deleted;
+	ht->first = other->first;
+	ht->other = other->other;
+	
+	hashtab_release(ht->pool, other);
+}
+
+/**
+ * @private
+ * 
+ * Migrates exisiting items to the other table. Called when growing.
+ *
+ * @param ht The hash table.
+ * @param n The number of non-empty buckets (or full slots) to move.
+ */
+static void hashtab_moveSome(hashtab_s * ht, size_t n){
+	size_t i, moved, hash;
+	linklist_s * link;
+	void * item;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		for(i = 0; i < n && ht->length > 0; ++i){
+			ht->first = hashtab_flatNext(ht, ht->first);
+			item = ht->slots[ht->first];
+			hash = ht->hashes[ht->first];
+			
+			if(ht->flags & HASHTAB_ROBIN){
+				/* Items only shift back, to the slot moved next. */
+				hashtab_robinErase(ht, ht->first);
+			}else{
+				/* No more finds can pass this slot, so nothing is lost by
+				   marking it deleted rather than probing the group. */
+				hashtab_setCtrl(ht, ht->first, HASHTAB_DELETED);
+				++ht->deleted;
+				--ht->length;
+			}
+			
+			/* The other table may be full if it is migrating itself (see
+			   hashtab_moveOn), adding the item takes care of that. */
+			hashtab_addHash(ht->other, item, hash);
+		}
+	}else{
+		for(i = 0; i < n && ht->length > 0; ++i){
+			ht->first = hashtab_next(ht, ht->first);
+			hashtab_own(ht, ht->first);
+			hashtab_bitClear(ht->occupied, ht->first);
+			
+			if(ht->flags & HASHTAB_COMPACT){
+				item = ht->slots[ht->first];
+				ht->slots[ht->first] = NULL;
+				
+				if(!HASHTAB_TAGGED(item)){
+					hashtab_addItem(ht->other, item, hashtab_hash(ht, item));
+					--ht->length;
+					continue;
+				}
+				link = hashtab_untag(item);
+			}else{
+				link = ht->data[ht->first];
+				ht->data[ht->first] = NULL;
+			}
+			
+			moved = hashtab_linkAdd(ht->other, link);
+			ht->length -= moved;
+		}
+	}
+	
+	if(ht->length == 0){
+		hashtab_absorb(ht);
+	}
+}
+
+/**
+ * @private
+ *
+ * Migrates a move rate's worth of items to the other table.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_moveOver(hashtab_s * ht){
+	hashtab_moveSome(ht, hashtab_moveCount(ht));
+}
+
+/**
+ * @private
+ *
+ * The migration step of an operation on a migrating table. Tables with a move
+ * rate of 0 leave it to hashtab_migrateStep, unless the table they migrate to
+ * is migrating as well: then they must catch up, or tables would pile up.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_moveOn(hashtab_s * ht){
+	if(ht->moveR || ht->other->other){
+		hashtab_moveOver(ht);
+	}
+}
+
+/**
+ * @private 
+ *
+ * Re-hashes (using the cached hashes) and moves all the links in the given
+ * linklist with the new size to the new data store.
+ *
+ * @param ll The linklist.
+ * @param flags The flags of the hash table.
+ * @param newData The new data store (bucket list).
+ * @param newBits The occupancy bitmap of the new data store.
+ * @param newSize The size of the new data store.
+ * @return The smallest non-empty index.
+ */
+static size_t hashtab_rehashLink(linklist_s * ll, int flags,
+		linklist_s ** newData, uint64_t * newBits, size_t newSize){
+	size_t hash, first = newSize;
+	linklist_s * next;
+	
+	while(ll){
+		next = ll->next;
+		ll->next = NULL;
+		
+		hash = hashtab_bucket(flags, ll->hash, newSize);
+		if(newData[hash] != NULL){
+			ll->next = newData[hash];
+		}
+		newData[hash] = ll;
+		hashtab_bitSet(newBits, hash);
+		
+		if(hash < first){
+			first = hash;
+		}
+		
+		ll = next;
+	}
+	
+	return first;
+}
+
+/**
+ * @private
+ *
+ * Re-hashes a compact table into new buckets. Chains are re-hashed with their
+ * cached hashes, items by themselves are hashed again.
+ *
+ * @param ht The hash table.
+ * @param newSize The new size of the table.
+ */
+static void hashtab_compactRehash(hashtab_s * ht, size_t newSize){
+	void ** slots;
+	uint64_t * bits = ht->occupied;
+	size_t i, size = ht->size;
+	
+	/* Re-hashing re-links the chains, the new buckets are all owned. */
+	hashtab_ownAll(ht);
+	hashtab_release(ht->pool, ht->owned);
+	ht->owned = NULL;
+	
+	slots = ht->slots;
+	hashtab_bucketsMake(ht, newSize);
+	ht->size = newSize;
+	ht->length = 0;
+	ht->first = newSize;
+	
+	for(i = hashtab_bitNext(bits, 0, size); i < size;
+			i = hashtab_bitNext(bits, i + 1, size)){
+		if(HASHTAB_TAGGED(slots[i])){
+			hashtab_linkAdd(ht, hashtab_untag(slots[i]));
+		}else{
+			hashtab_addItem(ht, slots[i], hashtab_hash(ht, slots[i]));
+		}
+	}
+	
+	hashtab_release(ht->pool, slots);
+	hashtab_release(ht->pool, bits);
+}
+
+/**
+ * @private
+ *
+ * Re-hashes the entire table after either growing or shrinking. This re-hashing
+ * is done inline, so some items may be re-hashed (at most) twice. Also reallocs
+ * the data store of the table either before or after. Flat and compact tables
+ * are re-hashed into a new data store instead.
+ *
+ * @param ht The hash table.
+ * @param newSize The new size of the table.
+ */
+static void hashtab_rehash(hashtab_s * ht, size_t newSize){
+	size_t i, tfirst, first = newSize;
+	uint64_t * bits = ht->occupied;
+	linklist_s * tdata;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		hashtab_flatRehash(ht, newSize);
+		return;
+	}
+	
+	if(ht->flags & HASHTAB_COMPACT){
+		hashtab_compactRehash(ht, newSize);
+		return;
+	}
+	
+	/* Re-hashing re-links the chains, the new buckets are all owned. */
+	hashtab_ownAll(ht);
+	hashtab_release(ht->pool, ht->owned);
+	ht->owned = NULL;
+	
+	ht->occupied = hashtab_bitsMake(ht->pool, newSize);
+	
+	if(newSize > ht->size){ /* growth */
+		ht->data = hashtab_realloc(ht->pool, ht->data,
+				ht->size * sizeof *ht->data, newSize * sizeof *ht->data);
+		for(i = ht->size; i < newSize; i++){
+			ht->data[i] = NULL;
+		}
+	}
+	
+	for(i = hashtab_bitNext(bits, 0, ht->size); i < ht->size;
+			i = hashtab_bitNext(bits, i + 1, ht->size)){
+		tdata = ht->data[i];
+		ht->data[i] = NULL;
+		tfirst = hashtab_rehashLink(tdata, ht->flags, ht->data, ht->occupied,
+				newSize);
+		if(tfirst < first){
+			first = tfirst;
+		}
+	}
+	ht->first = first;
+	hashtab_release(ht->pool, bits);
+	
+	if(newSize < ht->size){ /* shrinkage */
+		ht->data = hashtab_realloc(ht->pool, ht->data,
+				ht->size * sizeof *ht->data, newSize * sizeof *ht->data);
+	}
+	
+	ht->size = newSize;
+}
+
+/**
+ * @private
+ *
+ * The size a new table gets when it's made with a given size.
+ *
+ * @param flags The flags of the table.
+ * @param size The size asked for.
+ * @return The size.
+ */
+static size_t hashtab_tableSize(int flags, size_t size){
+	if(flags & HASHTAB_POW2){
+		size = hashtab_roundPow2(size);
+	}
+	
+	if(flags & (HASHTAB_FLAT | HASHTAB_ROBIN) && size < HASHTAB_GROUP){
+		size = HASHTAB_GROUP;
+	}
+	
+	return size;
+}
+
+/**
+ * @private
+ *
+ * Allocates and initializes a new hash table that uses an existing pool.
+ *
+ * @see hashtab_makeAlloc
+ */
+static hashtab_s * hashtab_makePooled(size_t size, 
+		size_t (*hasher)(const void * item), 
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags, hashtab_pool_s * pool){
+	hashtab_s * ret = hashtab_malloc(pool, sizeof *ret);
+	
+	ret->pool = pool;
+	ret->ctx = NULL;
+	ret->hasher = hasher;
+	ret->seededHasher = NULL;
+	ret->hashSeed = 0;
+	ret->maxChain = 0;
+	ret->cmp = cmp;
+	ret->threshold = threshold;
+	ret->moveR = moveR;
+	
+	ret->grows = 0;
+	ret->shrinks = 0;
+	ret->reseeds = 0;
+	ret->reseedAt = 0;
+	
+	size = hashtab_tableSize(flags, size);
+	
+	if(flags & HASHTAB_ROBIN){
+		flags |= HASHTAB_FLAT;
+	}
+	
+	if(flags & HASHTAB_FLAT){
+		flags &= ~HASHTAB_COMPACT;
+	}
+	
+	ret->flags = flags;
+	ret->data = NULL;
+	ret->occupied = NULL;
+	ret->owned = NULL;
+	ret->snap = NULL;
+	ret->ctrl = NULL;
+	ret->slots = NULL;
+	ret->hashes = NULL;
+	ret->pilots = NULL;
+	ret->pilotCount = 0;
+	ret->seed = 0;
+	ret->deleted = 0;
+	ret->other = NULL;
+	ret->spare = NULL;
+	
+	if(flags & HASHTAB_FLAT){
+		hashtab_flatAlloc(ret, size);
+	}else{
+		ret->size = size;
+		ret->length = 0;
+		ret->first = ret->size;
+		
+		hashtab_bucketsMake(ret, size);
+	}
+	
+	ret->shrink = (shrink ? 1 : 0) * size;
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Makes a table for a table to migrate to, with the same settings (and seed).
+ *
+ * @param ht The hash table.
+ * @param size The size of the new table.
+ * @return The new table.
+ */
+static hashtab_s * hashtab_makeOther(const hashtab_s * ht, size_t size){
+	hashtab_s * ret = hashtab_makePooled(size, ht->hasher, ht->cmp,
+			ht->threshold, ht->moveR, ht->shrink, ht->flags, ht->pool);
+	
+	ret->seededHasher = ht->seededHasher;
+	ret->hashSeed = ht->hashSeed;
+	ret->maxChain = ht->maxChain;
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Releases the memory of a table (not its other tables), which must have no
+ * links in use anymore, or they must be freed with the pool.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_drop(hashtab_s * ht){
+	if(ht->spare){
+		hashtab_drop(ht->spare);
+	}
+	
+	hashtab_release(ht->pool, ht->data);
+	hashtab_release(ht->pool, ht->occupied);
+	hashtab_release(ht->pool, ht->owned);
+	hashtab_release(ht->pool, ht->ctrl);
+	hashtab_release(ht->pool, ht->slots);
+	hashtab_release(ht->pool, ht->hashes);
+	hashtab_release(ht->pool, ht->pilots);
+	hashtab_release(ht->pool, ht);
+}
+
+/**
+ * @private
+ *
+ * Starts resizing the table: either by re-hashing (see above) or allocating a
+ * new table for incremental resizing.
+ *
+ * @param ht The hash table.
+ * @param newSize The new size.
+ */
+static void hashtab_resize(hashtab_s * ht, size_t newSize){
+	hashtab_s * spare = ht->spare;
+	
+	ht->spare = NULL;
+	
+	/* special case: no incremental resizing, but a complete rehash. */
+	if(ht->moveR == 1){
+		hashtab_rehash(ht, newSize);
+	}else if(spare && spare->size == hashtab_tableSize(ht->flags, newSize)){
+		/* Prepared by hashtab_prepareGrow, the settings may have changed. */
+		spare->threshold = ht->threshold;
+		spare->moveR = ht->moveR;
+		spare->maxChain = ht->maxChain;
+		spare->shrink = ht->shrink ? spare->size : 0;
+		ht->other = spare;
+		
+		return;
+	}else{
+		ht->other = hashtab_makeOther(ht, newSize);
+	}
+	
+	if(spare){
+		hashtab_drop(spare);
+	}
+}
+
+/**
+ * @private
+ *
+ * Grows the table by either re-hashing or allocating a new table for
+ * incremental resizing. Growing always happens by doubling the size.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_grow(hashtab_s * ht){
+	hashtab_resize(ht, ht->size * 2);
+	
+	++ht->grows;
+}
+
+/**
+ * @private
+ *
+ * Whether a table must be grown (or cleaned up) before adding an item to it.
+ *
+ * @param ht The hash table (not its other tables).
+ * @return Non-zero if it must.
+ */
+static int hashtab_mustGrow(hashtab_s * ht){
+	if(ht->flags & HASHTAB_FLAT){
+		return ht->length + ht->deleted + 1 > hashtab_flatLimit(ht);
+	}
+	
+	return hashtab_load(ht) > ht->threshold;
+}
+
+/**
+ * @private
+ *
+ * Checks whether a table must be grown before adding an item, and does so.
+ * Flat tables that are mostly filled with tombstones are cleaned up (resized
+ * to the same size) instead.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_checkGrow(hashtab_s * ht){
+	if(ht->other || !hashtab_mustGrow(ht)){
+		return;
+	}
+	
+	if(ht->flags & HASHTAB_FLAT && ht->length * 2 < hashtab_flatLimit(ht)){
+		hashtab_resize(ht, ht->size);
+	}else{
+		hashtab_grow(ht);
+	}
+}
+
+/**
+ * @private
+ *
+ * The size a table must have to hold n items without growing.
+ *
+ * @param flags The flags of the table.
+ * @param threshold The load factor threshold of the table.
+ * @param n The number of items.
+ * @return The size.
+ */
+static size_t hashtab_sizeFor(int flags, float threshold, size_t n){
+	size_t size;
+	
+	if(flags & HASHTAB_FLAT && threshold > 0.875f){
+		threshold = 0.875f;
+	}
+	
+	/* Flat tables need room for one more item before they grow. */
+	size = (size_t)((double)(n + 1) / threshold) + 1;
+	
+	if(flags & HASHTAB_FLAT && size < HASHTAB_GROUP){
+		size = HASHTAB_GROUP;
+	}
+	
+	return flags & HASHTAB_POW2 ? hashtab_roundPow2(size) : size;
+}
+
+/*
+ * Perfect hashing of compiled tables. The items are divided into groups (of
+ * HASHTAB_PILOT_LOAD on average) by their hashes, and every group has a pilot:
+ * a number that is mixed with the hash of each of its items to select their
+ * slots. The pilots are chosen (by trying 0, 1, 2, ...) so no two items get
+ * the same slot, starting with the biggest groups, which are hardest to place.
+ */
+
+/** @private The average number of items per pilot. */
+#define HASHTAB_PILOT_LOAD 4
+/** @private The number of pilots tried for a group before taking a new seed. */
+#define HASHTAB_PILOT_MAX ((uint32_t)1 << 20)
+/** @private The number of seeds tried before giving up. */
+#define HASHTAB_SEEDS 8
+/** @private Set by hashtab_compile on tables that were chained before. */
+#define HASHTAB_CHAINED 0x100
+/** @private Set on snapshots, see hashtab_snapshot. */
+#define HASHTAB_SNAPSHOT 0x200
+
+/**
+ * @private
+ *
+ * Selects the group (pilot) of a hash.
+ *
+ * @param hash The (full) hash.
+ * @param seed The seed.
+ * @param n The number of pilots, a power of two.
+ * @return The group.
+ */
+static size_t hashtab_perfectGroup(size_t hash, size_t seed, size_t n){
+	return hashtab_mix(hash ^ seed) & (n - 1);
+}
+
+/**
+ * @private
+ *
+ * Selects the slot of a hash.
+ *
+ * @param hash The (full) hash.
+ * @param seed The seed.
+ * @param pilot The pilot of the hash's group.
+ * @param size The number of slots.
+ * @return The slot.
+ */
+static size_t hashtab_perfectSlot(size_t hash, size_t seed, uint32_t pilot,
+		size_t size){
+	return (hashtab_mix(~hash ^ seed) ^ hashtab_mix((size_t)pilot + seed)) %
+			size;
+}
+
+/**
+ * @private
+ *
+ * Finds the slot holding item in a compiled table.
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @param hash The (full) hash of item.
+ * @return The slot, or ht->size if the item is not in the table.
+ */
+static size_t hashtab_perfectFind(const hashtab_s * ht, const void * item,
+		size_t hash){
+	size_t i = hashtab_perfectSlot(hash, ht->seed, ht->pilots[
+			hashtab_perfectGroup(hash, ht->seed, ht->pilotCount)], ht->size);
+	
+	HASHTAB_COUNT(ht, probes, 1);
+	if(HASHTAB_ISFULL(ht->ctrl[i]) && ht->hashes[i] == hash){
+		HASHTAB_COUNT(ht, cmps, 1);
+		if(ht->cmp(item, ht->slots[i]) == 0){
+			return i;
+		}
+	}
+	
+	return ht->size;
+}
+
+/**
+ * @private
+ *
+ * Tries to find pilots that give every hash a slot of its own.
+ *
+ * @param pool The pool to allocate scratch memory from.
+ * @param hashes The hashes.
+ * @param n The number of hashes.
+ * @param size The number of slots.
+ * @param seed The seed.
+ * @param pilots Receives the pilots.
+ * @param count The number of pilots, a power of two.
+ * @param slots Receives the slot of every hash.
+ * @return 1 on success, 0 if some group needs more than HASHTAB_PILOT_MAX
+ *         tries (a new seed may do better), -1 if hashes are equal (no seed
+ *         can tell them apart).
+ */
+static int hashtab_perfectSearch(hashtab_pool_s * pool, const size_t * hashes,
+		size_t n, size_t size, size_t seed, uint32_t * pilots, size_t count,
+		size_t * slots){
+	size_t * start = hashtab_malloc(pool, (count + 1) * sizeof *start);
+	size_t * order = hashtab_malloc(pool, (n ? n : 1) * sizeof *order);
+	size_t * bySize, * at, words = (size + HASHTAB_WORD - 1) / HASHTAB_WORD;
+	uint64_t * taken = hashtab_malloc(pool, words * sizeof *taken);
+	size_t i, j, k, g, len, max = 0, slot;
+	uint32_t pilot;
+	int ret = 1;
+	
+	/* Sort the hashes by group (see hashtab_linkAll). */
+	memset(start, 0, (count + 1) * sizeof *start);
+	for(i = 0; i < n; ++i){
+		++start[hashtab_perfectGroup(hashes[i], seed, count) + 1];
+	}
+	for(g = 0; g < count; ++g){
+		if(start[g + 1] > max){
+			max = start[g + 1];
+		}
+		start[g + 1] += start[g];
+	}
+	at = hashtab_malloc(pool, (max + 1) * sizeof *at);
+	for(i = 0; i < n; ++i){
+		order[start[hashtab_perfectGroup(hashes[i], seed, count)]++] = i;
+	}
+	for(g = count; g > 0; --g){
+		start[g] = start[g - 1];
+	}
+	start[0] = 0;
+	
+	/* Sort the groups by size, biggest first. */
+	bySize = hashtab_malloc(pool, count * sizeof *bySize);
+	memset(at, 0, (max + 1) * sizeof *at);
+	for(g = 0; g < count; ++g){
+		++at[max - (start[g + 1] - start[g])];
+	}
+	for(i = 0, k = 0; i <= max; ++i){
+		j = at[i];
+		at[i] = k;
+		k += j;
+	}
+	for(g = 0; g < count; ++g){
+		bySize[at[max - (start[g + 1] - start[g])]++] = g;
+	}
+	
+	memset(taken, 0, words * sizeof *taken);
+	memset(pilots, 0, count * sizeof *pilots);
+	
+	for(k = 0; k < count && ret == 1; ++k){
+		g = bySize[k];
+		len = start[g + 1] - start[g];
+		if(!len){
+			break;
+		}
+		
+		for(i = 0; i < len; ++i){
+			for(j = 0; j < i; ++j){
+				if(hashes[order[start[g] + i]] == hashes[order[start[g] + j]]){
+					ret = -1;
+				}
+			}
+		}
+		
+		for(pilot = 0; pilot < HASHTAB_PILOT_MAX && ret == 1; ++pilot){
+			for(i = 0; i < len; ++i){
+				slot = hashtab_perfectSlot(hashes[order[start[g] + i]], seed,
+						pilot, size);
+				/* The slot must not be taken by an earlier group. */
+				if(taken[slot / HASHTAB_WORD] >> (slot % HASHTAB_WORD) & 1){
+					break;
+				}
+				/* Nor by another item of the group. */
+				for(j = 0; j < i; ++j){
+					if(at[j] == slot){
+						break;
+					}
+				}
+				if(j < i){
+					break;
+				}
+				at[i] = slot;
+			}
+			
+			if(i == len){
+				break;
+			}
+		}
+		
+		if(pilot == HASHTAB_PILOT_MAX){
+			ret = 0;
+		}else if(ret == 1){
+			pilots[g] = pilot;
+			for(i = 0; i < len; ++i){
+				hashtab_bitSet(taken, at[i]);
+				slots[order[start[g] + i]] = at[i];
+			}
+		}
+	}
+	
+	hashtab_release(pool, start);
+	hashtab_release(pool, order);
+	hashtab_release(pool, bySize);
+	hashtab_release(pool, at);
+	hashtab_release(pool, taken);
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Turns a compiled table back into a normal one (chained or flat).
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_decompile(hashtab_s * ht){
+	unsigned char * ctrl = ht->ctrl;
+	void ** slots = ht->slots;
+	size_t * hashes = ht->hashes;
+	size_t i, size = ht->size, newSize;
+	
+	hashtab_release(ht->pool, ht->pilots);
+	ht->pilots = NULL;
+	ht->pilotCount = 0;
+	ht->flags &= ~HASHTAB_COMPILED;
+	
+	if(!(ht->flags & HASHTAB_CHAINED)){
+		hashtab_flatRehash(ht, hashtab_sizeFor(ht->flags, ht->threshold,
+				ht->length));
+		return;
+	}
+	
+	ht->flags &= ~(HASHTAB_CHAINED | HASHTAB_FLAT);
+	newSize = hashtab_sizeFor(ht->flags, ht->threshold, ht->length);
+	
+	ht->slots = NULL;
+	hashtab_bucketsMake(ht, newSize);
+	ht->size = newSize;
+	ht->first = newSize;
+	ht->length = 0;
+	ht->ctrl = NULL;
+	ht->hashes = NULL;
+	
+	for(i = 0; i < size; ++i){
+		if(HASHTAB_ISFULL(ctrl[i])){
+			hashtab_addItem(ht, slots[i], hashes[i]);
+		}
+	}
+	
+	hashtab_release(ht->pool, ctrl);
+	hashtab_release(ht->pool, slots);
+	hashtab_release(ht->pool, hashes);
+}
+
+/**
+ * @private
+ *
+ * Finds the link containing item.
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @param hash The (full) hash of item.
+ * @return The link containing the item, or NULL if it's not in the table.
+ */
+static linklist_s * hashtab_findLink(hashtab_s * ht, const void * item,
+		size_t hash){
+	linklist_s * datum = ht->data[hashtab_bucket(ht->flags, hash, ht->size)];
+	
+	for(; datum; datum = datum->next){
+		HASHTAB_COUNT(ht, probes, 1);
+		if(datum->hash == hash){
+			HASHTAB_COUNT(ht, cmps, 1);
+			if(ht->cmp(item, datum->item) == 0){
+				break;
+			}
+		}
+	}
+	
+	if(datum == NULL && ht->other){
+		return hashtab_findLink(ht->other, item, hash);
+	}
+	
+	return datum;
+}
+
+/**
+ * @private
+ *
+ * Finds item in a compact table. Items by themselves in a bucket have no
+ * cached hash, so they are compared right away.
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @param hash The (full) hash of item.
+ * @return A pointer to the stored item, or NULL if it's not in the table.
+ */
+static void ** hashtab_compactFind(hashtab_s * ht, const void * item,
+		size_t hash){
+	linklist_s * link;
+	void ** ref;
+	
+	for(; ht; ht = ht->other){
+		ref = &ht->slots[hashtab_bucket(ht->flags, hash, ht->size)];
+		if(*ref == NULL){
+			continue;
+		}
+		
+		if(!HASHTAB_TAGGED(*ref)){
+			HASHTAB_COUNT(ht, probes, 1);
+			HASHTAB_COUNT(ht, cmps, 1);
+			if(ht->cmp(item, *ref) == 0){
+				return ref;
+			}
+			continue;
+		}
+		
+		for(link = hashtab_untag(*ref); link; link = link->next){
+			HASHTAB_COUNT(ht, probes, 1);
+			if(link->hash == hash){
+				HASHTAB_COUNT(ht, cmps, 1);
+				if(ht->cmp(item, link->item) == 0){
+					return &link->item;
+				}
+			}
+		}
+	}
+	
+	return NULL;
+}
+
+/**
+ * @private
+ *
+ * Finds where item is stored: either in a link or a slot.
+ *
+ * @param ht The hash table.
+ * @param item The item to find.
+ * @param hash The (full) hash of item.
+ * @return A pointer to the stored item, or NULL if it's not in the table.
+ */
+static void ** hashtab_findRef(hashtab_s * ht, const void * item, size_t hash){
+	linklist_s * link;
+	size_t i;
+	
+	HASHTAB_COUNT(ht, finds, 1);
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		i = hashtab_perfectFind(ht, item, hash);
+		
+		return i < ht->size ? &ht->slots[i] : NULL;
+	}
+	
+	if(ht->flags & HASHTAB_COMPACT && !(ht->flags & HASHTAB_FLAT)){
+		return hashtab_compactFind(ht, item, hash);
+	}
+	
+	if(!(ht->flags & HASHTAB_FLAT)){
+		link = hashtab_findLink(ht, item, hash);
+		
+		return link ? &link->item : NULL;
+	}
+	
+	for(; ht; ht = ht->other){
+		i = hashtab_flatFind(ht, item, hash, NULL);
+		if(i < ht->size){
+			return &ht->slots[i];
+		}
+	}
+	
+	return NULL;
+}
+
+/**
+ * @private
+ *
+ * Adds an item with a known hash to the hash table.
+ *
+ * @param ht The hash table.
+ * @param item The item.
+ * @param hash The (full) hash of item.
+ * @return Non-zero if the bucket it was added to holds more than maxChain
+ *         items, see hashtab_defend.
+ */
+static int hashtab_addHash(hashtab_s * ht, void * item, size_t hash){
+	int flooded = 0;
+	size_t i;
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	hashtab_checkGrow(ht);
+	
+	if(ht->other != NULL){
+		flooded = hashtab_addHash(ht->other, item, hash);
+		
+		hashtab_moveOn(ht);
+	}else{
+		i = ht->flags & HASHTAB_FLAT ? hashtab_flatPlace(ht, item, hash) :
+				hashtab_addItem(ht, item, hash);
+		flooded = ht->maxChain && hashtab_flooded(ht, i, hash);
+	}
+	
+	return flooded;
+}
+
+hashtab_s * hashtab_makeAlloc(size_t size, 
+		size_t (*hasher)(const void * item), 
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags, const hashtab_alloc_s * alloc){
+	return hashtab_makePooled(size, hasher, cmp, threshold, moveR, shrink,
+			flags, hashtab_poolMake(alloc));
+}
+
+/**
+ * @private
+ *
+ * Fills an empty chained table with items at once. The items are counted per
+ * bucket first, so the links of every bucket can be placed next to each other
+ * in one block.
+ *
+ * @param ht The hash table.
+ * @param items The items.
+ * @param hashes The hashes of the items.
+ * @param n The number of items.
+ */
+static void hashtab_linkAll(hashtab_s * ht, void * const * items,
+		const size_t * hashes, size_t n){
+	size_t * end = hashtab_malloc(ht->pool, (ht->size + 1) * sizeof *end);
+	linklist_s * links = hashtab_linksMake(ht->pool, n);
+	size_t i, b, begin;
+	
+	memset(end, 0, (ht->size + 1) * sizeof *end);
+	for(i = 0; i < n; ++i){
+		++end[hashtab_bucket(ht->flags, hashes[i], ht->size) + 1];
+	}
+	for(b = 1; b <= ht->size; ++b){
+		end[b] += end[b - 1];
+	}
+	
+	/* Afterwards end[b] is the end of bucket b (instead of its beginning). */
+	for(i = 0; i < n; ++i){
+		b = hashtab_bucket(ht->flags, hashes[i], ht->size);
+		links[end[b]].item = items[i];
+		links[end[b]].hash = hashes[i];
+		++end[b];
+	}
+	
+	for(b = 0, begin = 0; b < ht->size; begin = end[b++]){
+		if(begin == end[b]){
+			continue;
+		}
+		
+		for(i = begin; i + 1 < end[b]; ++i){
+			links[i].next = &links[i + 1];
+		}
+		links[i].next = NULL;
+		
+		ht->data[b] = &links[begin];
+		hashtab_bitSet(ht->occupied, b);
+		if(ht->first > b){
+			ht->first = b;
+		}
+	}
+	
+	ht->length = n;
+	hashtab_release(ht->pool, end);
+}
+
+hashtab_s * hashtab_fromArray(void * const * items, size_t n,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags){
+	hashtab_s * ht = hashtab_makeFlags(hashtab_sizeFor(flags, threshold, n),
+			hasher, cmp, threshold, moveR, shrink, flags);
+	size_t * hashes = hashtab_malloc(ht->pool, (n ? n : 1) * sizeof *hashes);
+	size_t i;
+	
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for(i = 0; i < n; ++i){
+		hashes[i] = hashtab_hash(ht, items[i]);
+	}
+	
+	if(ht->flags & HASHTAB_FLAT){
+		for(i = 0; i < n; ++i){
+			hashtab_flatPlace(ht, items[i], hashes[i]);
+		}
+	}else if(ht->flags & HASHTAB_COMPACT){
+		for(i = 0; i < n; ++i){
+			hashtab_addItem(ht, items[i], hashes[i]);
+		}
+	}else if(n){
+		hashtab_linkAll(ht, items, hashes, n);
+	}
+	
+	hashtab_release(ht->pool, hashes);
+	
+	return ht;
+}
+
+/**
+ * @private
+ *
+ * Makes a table ready to hold a number of items without growing: turns a
+ * compiled table back into a normal one, finishes migrating and re-hashes it
+ * at once if it's too small.
+ *
+ * @param ht The hash table.
+ * @param n The number of items.
+ * @return Non-zero if the table was resized.
+ */
+static int hashtab_presize(hashtab_s * ht, size_t n){
+	size_t size;
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	size = hashtab_sizeFor(ht->flags, ht->threshold, n);
+	
+	while(ht->other){
+		hashtab_moveOver(ht);
+	}
+	
+	if(size <= ht->size){
+		return 0;
+	}
+	
+	hashtab_rehash(ht, size);
+	
+	return 1;
+}
+
+size_t hashtab_reserve(hashtab_s * ht, size_t n){
+	if(hashtab_presize(ht, n) && ht->shrink){
+		ht->shrink = ht->size;
+	}
+	
+	return ht->size;
+}
+
+size_t hashtab_prepareGrow(hashtab_s * ht){
+	hashtab_s * spare;
+	
+	if(ht->other || ht->moveR == 1 || ht->flags & HASHTAB_COMPILED){
+		return 0;
+	}
+	
+	/* One prepared for another size (before a reserve or shrink) is no use. */
+	if(ht->spare && ht->spare->size != hashtab_tableSize(ht->flags,
+			ht->size * 2)){
+		hashtab_drop(ht->spare);
+		ht->spare = NULL;
+	}
+	
+	if(!ht->spare){
+		spare = hashtab_makeOther(ht, ht->size * 2);
+		
+		/* Chained buckets are cleared when allocated, slots are not. */
+		if(spare->flags & HASHTAB_FLAT){
+			memset(spare->slots, 0, spare->size * sizeof *spare->slots);
+			memset(spare->hashes, 0, spare->size * sizeof *spare->hashes);
+		}
+		
+		ht->spare = spare;
+	}
+	
+	return ht->spare->size;
+}
+
+/**
+ * @private
+ *
+ * A monotonic clock. Without POSIX clocks it's the processor time instead.
+ *
+ * @return The time in nanoseconds.
+ */
+static uint64_t hashtab_now(void){
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#else
+	return (uint64_t)((double) clock() * 1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * @private
+ *
+ * A random seed for a seeded table: from /dev/urandom where there is one,
+ * mixed with the time and an address (which differs between processes with
+ * address space randomization).
+ *
+ * @return The seed.
+ */
+static size_t hashtab_randomSeed(void){
+	FILE * f = fopen("/dev/urandom", "rb");
+	size_t seed = 0;
+	
+	if(f){
+		if(fread(&seed, sizeof seed, 1, f) != 1){
+			seed = 0;
+		}
+		fclose(f);
+	}
+	
+	return seed ^ hashtab_mix((size_t) hashtab_now() ^ (size_t) time(NULL) ^
+			(size_t)(uintptr_t) &seed);
+}
+
+int hashtab_migrateStep(hashtab_s * ht, size_t ns){
+	uint64_t end = hashtab_now() + ns;
+	hashtab_s * t;
+	
+	while(ht->other){
+		/* The last migration first, so no item is moved twice. */
+		t = ht;
+		while(t->other->other){
+			t = t->other;
+		}
+		
+		hashtab_moveSome(t, HASHTAB_STEP);
+		
+		if(hashtab_now() >= end){
+			break;
+		}
+	}
+	
+	return ht->other != NULL;
+}
+
+void hashtab_reseed(hashtab_s * ht){
+	linklist_s * link;
+	size_t i;
+	
+	if(!ht->seededHasher){
+		return;
+	}
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	while(ht->other){
+		hashtab_moveOver(ht);
+	}
+	
+	/* The prepared table would be hashed with the old seed. */
+	if(ht->spare){
+		hashtab_drop(ht->spare);
+		ht->spare = NULL;
+	}
+	
+	ht->hashSeed = hashtab_randomSeed();
+	
+	/* Cache the new hashes first, re-hashing places the items by them. Items
+	   by themselves in compact tables are hashed when they're placed. */
+	if(ht->flags & HASHTAB_FLAT){
+		for(i = hashtab_next(ht, 0); i < ht->size; i = hashtab_next(ht, i + 1)){
+			ht->hashes[i] = hashtab_hash(ht, ht->slots[i]);
+		}
+	}else{
+		hashtab_ownAll(ht);
+		for(i = hashtab_next(ht, 0); i < ht->size; i = hashtab_next(ht, i + 1)){
+			for(link = hashtab_links(ht, i); link; link = link->next){
+				link->hash = hashtab_hash(ht, link->item);
+			}
+		}
+	}
+	
+	hashtab_rehash(ht, ht->size);
+	
+	++ht->reseeds;
+}
+
+/**
+ * @private
+ *
+ * Reseeds the table after an add left a bucket with too many items, unless it
+ * was reseeded since it had half as many items. Reseeding doesn't help a
+ * bucket full of duplicates (of a few items), this keeps what it costs then
+ * about what growing costs.
+ *
+ * @param ht The hash table.
+ * @return Non-zero if the table was reseeded.
+ */
+static int hashtab_defend(hashtab_s * ht){
+	size_t n = hashtab_length(ht);
+	
+	if(!ht->seededHasher || n < ht->reseedAt){
+		return 0;
+	}
+	
+	hashtab_reseed(ht);
+	ht->reseedAt = 2 * n;
+	
+	return 1;
+}
+
+int hashtab_compile(hashtab_s * ht){
+	size_t n, size, count, seed, i, k;
+	size_t * hashes, * slots;
+	void ** items;
+	uint32_t * pilots;
+	linklist_s * link, one;
+	int ret = 0;
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		return 1;
+	}
+	
+	while(ht->other){
+		hashtab_moveOver(ht);
+	}
+	
+	n = ht->length;
+	items = hashtab_malloc(ht->pool, (n ? n : 1) * sizeof *items);
+	hashes = hashtab_malloc(ht->pool, (n ? n : 1) * sizeof *hashes);
+	slots = hashtab_malloc(ht->pool, (n ? n : 1) * sizeof *slots);
+	
+	k = 0;
+	for(i = hashtab_next(ht, 0); i < ht->size; i = hashtab_next(ht, i + 1)){
+		if(ht->flags & HASHTAB_FLAT){
+			items[k] = ht->slots[i];
+			hashes[k++] = ht->hashes[i];
+			continue;
+		}
+		
+		for(link = hashtab_chain(ht, i, &one); link; link = link->next){
+			items[k] = link->item;
+			hashes[k++] = link == &one ? hashtab_hash(ht, link->item) :
+					link->hash;
+		}
+	}
+	
+	size = n + n / 64;
+	if(size < HASHTAB_GROUP){
+		size = HASHTAB_GROUP;
+	}
+	count = 1;
+	while(count * HASHTAB_PILOT_LOAD < n){
+		count *= 2;
+	}
+	pilots = hashtab_malloc(ht->pool, count * sizeof *pilots);
+	
+	for(i = 0, seed = 0; i < HASHTAB_SEEDS && ret == 0; ++i){
+		seed = hashtab_mix(seed + 0x9E3779B9u);
+		ret = hashtab_perfectSearch(ht->pool, hashes, n, size, seed, pilots,
+				count, slots);
+	}
+	
+	if(ret == 1){
+		/* Compiled tables don't grow. */
+		if(ht->spare){
+			hashtab_drop(ht->spare);
+			ht->spare = NULL;
+		}
+		
+		/* All links are unused now (there are no other tables). While
+		   snapshots still see some, those are retired and the table's own
+		   are re-used. */
+		if(!(ht->flags & HASHTAB_FLAT)){
+			hashtab_reclaim(ht->pool);
+			if(!ht->pool->snaps){
+				hashtab_poolTrim(ht->pool);
+				ht->pool->nRetired = 0;
+			}else{
+				hashtab_dropChains(ht);
+			}
+			ht->flags |= HASHTAB_FLAT | HASHTAB_CHAINED;
+		}
+		
+		hashtab_release(ht->pool, ht->ctrl);
+		hashtab_release(ht->pool, ht->slots);
+		hashtab_release(ht->pool, ht->hashes);
+		hashtab_release(ht->pool, ht->data);
+		hashtab_release(ht->pool, ht->occupied);
+		hashtab_release(ht->pool, ht->owned);
+		ht->data = NULL;
+		ht->occupied = NULL;
+		ht->owned = NULL;
+		ht->flags |= HASHTAB_COMPILED;
+		
+		hashtab_flatAlloc(ht, size);
+		for(k = 0; k < n; ++k){
+			ht->slots[slots[k]] = items[k];
+			ht->hashes[slots[k]] = hashes[k];
+			hashtab_setCtrl(ht, slots[k], hashtab_tag(hashes[k]));
+		}
+		ht->length = n;
+		ht->first = 0;
+		ht->pilots = pilots;
+		ht->pilotCount = count;
+		ht->seed = seed;
+	}else{
+		hashtab_release(ht->pool, pilots);
+	}
+	
+	hashtab_release(ht->pool, items);
+	hashtab_release(ht->pool, hashes);
+	hashtab_release(ht->pool, slots);
+	
+	return ret == 1;
+}
+
+hashtab_s * hashtab_makeFlags(size_t size, 
+		size_t (*hasher)(const void * item), 
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags){
+	return hashtab_makeAlloc(size, hasher, cmp, threshold, moveR, shrink, flags,
+			NULL);
+}
+
+hashtab_s * hashtab_make(size_t size, 
+		size_t (*hasher)(const void * item), 
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink){
+	return hashtab_makeFlags(size, hasher, cmp, threshold, moveR, shrink, 0);
+}
+
+hashtab_s * hashtab_makeFlat(size_t size, 
+		size_t (*hasher)(const void * item), 
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink){
+	return hashtab_makeFlags(size, hasher, cmp, threshold, moveR, shrink,
+			HASHTAB_FLAT);
+}
+
+hashtab_s * hashtab_makeSeeded(size_t size, 
+		size_t (*hasher)(const void * item, size_t seed),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags){
+	hashtab_s * ret = hashtab_makeFlags(size, NULL, cmp, threshold, moveR,
+			shrink, flags);
+	
+	ret->seededHasher = hasher;
+	ret->hashSeed = hashtab_randomSeed();
+	ret->maxChain = HASHTAB_MAX_CHAIN;
+	
+	return ret;
+}
+
+size_t hashtab_add(hashtab_s * ht, void * item){
+	if(hashtab_addHash(ht, item, hashtab_hash(ht, item))){
+		hashtab_defend(ht);
+	}
+	
+	return ht->length;
+}
+
+void * hashtab_find(hashtab_s * ht, const void * item){
+	void ** ref = hashtab_findRef(ht, item, hashtab_hash(ht, item));
+	
+	return ref ? *ref : NULL;
+}
+
+void * hashtab_insert(hashtab_s * ht, void * item){
+	size_t hash = hashtab_hash(ht, item);
+	void * ret = NULL;
+	hashtab_s * t;
+	void ** ref;
+	
+	/* The item is replaced in its link, which a snapshot may share. */
+	for(t = ht; t; t = t->other){
+		if(t->owned){
+			hashtab_own(t, hashtab_bucket(t->flags, hash, t->size));
+		}
+	}
+	
+	ref = hashtab_findRef(ht, item, hash);
+	if(ref){
+		ret = *ref;
+		*ref = item;
+	}else if(hashtab_addHash(ht, item, hash)){
+		hashtab_defend(ht);
+	}
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Makes the migration steps of hashtab_addHash after an item was added to the
+ * last of the other tables: moves items over in every table that migrates,
+ * starting with the last.
+ *
+ * @param ht The hash table.
+ */
+static void hashtab_moveChain(hashtab_s * ht){
+	if(ht->other){
+		hashtab_moveChain(ht->other);
+		hashtab_moveOn(ht);
+	}
+}
+
+void * hashtab_findOrInsert(hashtab_s * ht, const void * key,
+		void * (*make)(const void * key, void * ctx), void * ctx,
+		int * inserted){
+	size_t hash = hashtab_hash(ht, key), avail = 0, i;
+	hashtab_s * last = ht;
+	linklist_s * link;
+	int flooded = 0;
+	void ** ref;
+	void * item;
+	
+	if(inserted){
+		*inserted = 0;
+	}
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		if((ref = hashtab_findRef(ht, key, hash))){
+			return *ref;
+		}
+	}else if(ht->flags & HASHTAB_FLAT){
+		HASHTAB_COUNT(ht, finds, 1);
+		
+		/* New items go into the last table, remember where. */
+		for(;; last = last->other){
+			avail = last->size;
+			i = hashtab_flatFind(last, key, hash, &avail);
+			if(i < last->size){
+				return last->slots[i];
+			}
+			
+			if(!last->other){
+				break;
+			}
+		}
+	}else{
+		HASHTAB_COUNT(ht, finds, 1);
+		
+		if(ht->flags & HASHTAB_COMPACT){
+			if((ref = hashtab_compactFind(ht, key, hash))){
+				return *ref;
+			}
+		}else if((link = hashtab_findLink(ht, key, hash))){
+			return link->item;
+		}
+		
+		while(last->other){
+			last = last->other;
+		}
+	}
+	
+	item = make(key, ctx);
+	if(inserted){
+		*inserted = 1;
+	}
+	
+	/* Growing (or decompiling) moves items, so the free slot is lost. */
+	if(ht->flags & HASHTAB_COMPILED || hashtab_mustGrow(last) ||
+			(ht->flags & HASHTAB_FLAT && avail >= last->size)){
+		flooded = hashtab_addHash(ht, item, hash);
+	}else{
+		i = ht->flags & HASHTAB_FLAT ? hashtab_flatPut(last, avail, item, hash) :
+				hashtab_addItem(last, item, hash);
+		flooded = last->maxChain && hashtab_flooded(last, i, hash);
+		hashtab_moveChain(ht);
+	}
+	
+	if(flooded){
+		hashtab_defend(ht);
+	}
+	
+	return item;
+}
+
+void hashtab_forEach(hashtab_s * ht, 
+		void (*callback)(void * item, void * ctx), void * ctx){
+	linklist_s one;
+	size_t i;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		for(i = hashtab_next(ht, 0); i < ht->size; i = hashtab_next(ht, i + 1)){
+			callback(ht->slots[i], ctx);
+		}
+	}else{
+		for(i = hashtab_next(ht, 0); i < ht->size; i = hashtab_next(ht, i + 1)){
+			linklist_forEach(hashtab_chain(ht, i, &one), callback, ctx);
+		}
+	}
+	
+	if(ht->other){
+		hashtab_forEach(ht->other, callback, ctx);
+	}
+}
+
+/**
+ * @private
+ *
+ * Applies a function to the items in a single bucket (or slot).
+ *
+ * @param ht The hash table (not its other tables).
+ * @param i The bucket.
+ * @param callback The function.
+ * @param ctx A context supplied to the callback.
+ * @return The number of items.
+ */
+static size_t hashtab_forBucket(const hashtab_s * ht, size_t i,
+		void (*callback)(void * item, void * ctx), void * ctx){
+	const linklist_s * link;
+	linklist_s one;
+	size_t n = 0;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		if(HASHTAB_ISFULL(ht->ctrl[i])){
+			callback(ht->slots[i], ctx);
+			++n;
+		}
+	}else{
+		for(link = hashtab_chain(ht, i, &one); link; link = link->next){
+			callback(link->item, ctx);
+			++n;
+		}
+	}
+	
+	return n;
+}
+
+void hashtab_iterInit(hashtab_iter_s * it, hashtab_s * ht){
+	it->table = ht;
+	it->i = 0;
+	it->link = NULL;
+}
+
+void * hashtab_iterNext(hashtab_iter_s * it){
+	const linklist_s * link = it->link;
+	const hashtab_s * t;
+	size_t i;
+	
+	while(!link){
+		if(!(t = it->table)){
+			return NULL;
+		}
+		
+		i = hashtab_next(t, it->i);
+		if(i >= t->size){
+			it->table = t->other;
+			it->i = 0;
+			continue;
+		}
+		
+		it->i = i + 1;
+		if(t->flags & HASHTAB_FLAT || (t->flags & HASHTAB_COMPACT &&
+				!HASHTAB_TAGGED(t->slots[i]))){
+			return t->slots[i];
+		}
+		link = hashtab_links(t, i);
+	}
+	
+	it->link = link->next;
+	
+	return link->item;
+}
+
+/*
+ * Start scan functions. Tables with power-of-two sizes are scanned in units
+ * that hold all items whose hashes end in the same bits: buckets in chained
+ * tables, and in flat tables groups of slots where probe sequences start.
+ * A unit of a table holds the items of the units with the same number in
+ * larger tables, and of a part of a unit in smaller ones. The cursor goes over
+ * the units with the bits of its number reversed (counting from the most to
+ * the least significant bit), so the units visited before it, in the table's
+ * size at the time, are those whose numbers (in any size) it has passed.
+ */
+
+/**
+ * @private
+ *
+ * Reverses the bits of a cursor.
+ *
+ * @param v The cursor.
+ * @return v with its bits reversed.
+ */
+static size_t hashtab_reverse(size_t v){
+	size_t s = CHAR_BIT * sizeof v, mask = ~(size_t)0;
+	
+	while((s >>= 1) > 0){
+		mask ^= mask << s;
+		v = ((v >> s) & mask) | ((v << s) & ~mask);
+	}
+	
+	return v;
+}
+
+/**
+ * @private
+ *
+ * The number of units a table is scanned in.
+ *
+ * @param ht The hash table (not its other tables).
+ * @return The number of units, a power of two.
+ */
+static size_t hashtab_scanUnits(const hashtab_s * ht){
+	return ht->flags & HASHTAB_FLAT ? ht->size / HASHTAB_GROUP : ht->size;
+}
+
+/**
+ * @private
+ *
+ * Applies a function to the items in a unit of a table. In flat tables these
+ * are the items whose probe sequence starts in group u. An item can be
+ * anywhere in the first group of slots from its start, even past empty slots
+ * (left by removals), so the first groups of all starts in the unit are looked
+ * at in full. Items further along were placed past a run of full slots from
+ * their start, which removals only turn into tombstones: from there on they
+ * can be found up to the first empty slot.
+ *
+ * @param ht The hash table (not its other tables).
+ * @param u The unit.
+ * @param callback The function.
+ * @param ctx A context supplied to the callback.
+ * @return The number of items.
+ */
+static size_t hashtab_scanUnit(const hashtab_s * ht, size_t u,
+		void (*callback)(void * item, void * ctx), void * ctx){
+	size_t mask = ht->size - 1, i, k, n = 0;
+	
+	if(!(ht->flags & HASHTAB_FLAT)){
+		return hashtab_forBucket(ht, u, callback, ctx);
+	}
+	
+	for(k = 0; k < ht->size; ++k){
+		i = (u * HASHTAB_GROUP + k) & mask;
+		
+		if(HASHTAB_ISFULL(ht->ctrl[i])){
+			if((ht->hashes[i] & mask) / HASHTAB_GROUP == u){
+				callback(ht->slots[i], ctx);
+				++n;
+			}
+		}else if(ht->ctrl[i] == HASHTAB_EMPTY && k > 2 * HASHTAB_GROUP - 2){
+			break;
+		}
+	}
+	
+	return n;
+}
+
+/**
+ * @private
+ *
+ * Scans a table by position, for tables that can't be scanned in units: the
+ * cursor is the position of the next bucket (or slot) in the table and then in
+ * its other tables.
+ *
+ * @see hashtab_scan
+ */
+static size_t hashtab_scanSlots(const hashtab_s * ht, size_t cursor, size_t n,
+		void (*callback)(void * item, void * ctx), void * ctx){
+	const hashtab_s * t;
+	size_t base, i, done = 0;
+	
+	for(t = ht, base = 0; t; base += t->size, t = t->other){
+		if(cursor >= base + t->size){
+			continue;
+		}
+		
+		for(i = hashtab_next(t, cursor - base); i < t->size;
+				i = hashtab_next(t, i + 1)){
+			done += hashtab_forBucket(t, i, callback, ctx);
+			if(done >= n){
+				return base + i + 1;
+			}
+		}
+		
+		cursor = base + t->size;
+	}
+	
+	return 0;
+}
+
+size_t hashtab_scan(hashtab_s * ht, size_t cursor, size_t n,
+		void (*callback)(void * item, void * ctx), void * ctx){
+	const hashtab_s * t;
+	size_t mask, u, done = 0;
+	
+	if(!(ht->flags & HASHTAB_POW2) || ht->flags & HASHTAB_COMPILED){
+		return hashtab_scanSlots(ht, cursor, n, callback, ctx);
+	}
+	
+	/* The smallest table decides which units make a step. */
+	for(t = ht, mask = ~(size_t)0; t; t = t->other){
+		if(hashtab_scanUnits(t) - 1 < mask){
+			mask = hashtab_scanUnits(t) - 1;
+		}
+	}
+	
+	do{
+		for(t = ht; t; t = t->other){
+			for(u = cursor & mask; u < hashtab_scanUnits(t); u += mask + 1){
+				done += hashtab_scanUnit(t, u, callback, ctx);
+			}
+		}
+		
+		cursor |= ~mask;
+		cursor = hashtab_reverse(hashtab_reverse(cursor) + 1);
+	}while(cursor && done < n);
+	
+	return cursor;
+}
+
+/**
+ * @private
+ *
+ * Removes item from this compact table only (not from other). A chain that is
+ * left with one item is turned back into the item by itself.
+ *
+ * @see hashtab_removeHere
+ */
+static void * hashtab_compactRemove(hashtab_s * ht, const void * item,
+		size_t hash){
+	size_t i = hashtab_bucket(ht->flags, hash, ht->size);
+	linklist_s ** ref, * link, * head;
+	void * ret = ht->slots[i];
+	
+	if(ret == NULL){
+		return NULL;
+	}
+	
+	if(!HASHTAB_TAGGED(ret)){
+		HASHTAB_COUNT(ht, probes, 1);
+		HASHTAB_COUNT(ht, cmps, 1);
+		if(ht->cmp(item, ret) != 0){
+			return NULL;
+		}
+		
+		ht->slots[i] = NULL;
+		hashtab_bitClear(ht->occupied, i);
+		--ht->length;
+		
+		return ret;
+	}
+	
+	head = hashtab_untag(ret);
+	ret = NULL;
+	for(ref = &head; (link = *ref); ref = &link->next){
+		HASHTAB_COUNT(ht, probes, 1);
+		if(link->hash == hash && (HASHTAB_COUNT(ht, cmps, 1),
+				ht->cmp(item, link->item) == 0)){
+			ret = link->item;
+			*ref = link->next;
+			hashtab_linkRelease(ht->pool, link);
+			--ht->length;
+			
+			break;
+		}
+	}
+	
+	/* Chains always have two or more links. A miss leaves the slot be. */
+	if(ret){
+		if(head->next == NULL){
+			ht->slots[i] = head->item;
+			hashtab_linkRelease(ht->pool, head);
+		}else{
+			ht->slots[i] = hashtab_tagged(head);
+		}
+	}
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Removes item from this table only (not from other).
+ *
+ * @param ht The hash table.
+ * @param item The item to remove.
+ * @param hash The (full) hash of item.
+ * @return The removed item, or NULL if it's not in this table.
+ */
+static void * hashtab_removeHere(hashtab_s * ht, const void * item,
+		size_t hash){
+	void * ret = NULL;
+	size_t i;
+	linklist_s ** ref, * link;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		i = hashtab_flatFind(ht, item, hash, NULL);
+		if(i < ht->size){
+			ret = ht->slots[i];
+			hashtab_flatErase(ht, i);
+		}
+		
+		return ret;
+	}
+	
+	i = hashtab_bucket(ht->flags, hash, ht->size);
+	
+	/* A shared chain is only copied if the item is removed from it. */
+	if(hashtab_shared(ht, i)){
+		for(link = hashtab_links(ht, i); link; link = link->next){
+			if(link->hash == hash && ht->cmp(item, link->item) == 0){
+				break;
+			}
+		}
+		if(!link && hashtab_links(ht, i)){
+			return NULL;
+		}
+		
+		hashtab_own(ht, i);
+	}
+	
+	if(ht->flags & HASHTAB_COMPACT){
+		return hashtab_compactRemove(ht, item, hash);
+	}
+	
+	for(ref = &ht->data[i]; (link = *ref); ref = &link->next){
+		HASHTAB_COUNT(ht, probes, 1);
+		if(link->hash == hash && (HASHTAB_COUNT(ht, cmps, 1),
+				ht->cmp(item, link->item) == 0)){
+			ret = link->item;
+			*ref = link->next;
+			hashtab_linkRelease(ht->pool, link);
 			--ht->length;
+			
+			if(ht->data[i] == NULL){
+				hashtab_bitClear(ht->occupied, i);
+			}
+			
+			break;
+		}
+	}
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * The load factor below which a shrinking table shrinks: 1 - threshold, but at
+ * most a quarter of the threshold. Halving the table then at most doubles the
+ * load to half the threshold, so it isn't grown again right away (and vice
+ * versa).
+ *
+ * @param ht The hash table.
+ * @return The load factor.
+ */
+static float hashtab_shrinkLoad(const hashtab_s * ht){
+	float low = 1.0f - ht->threshold;
+	
+	return low < ht->threshold / 4 ? low : ht->threshold / 4;
+}
+
+/**
+ * @private
+ *
+ * Removes an item with a known hash from the hash table.
+ *
+ * @param ht The hash table.
+ * @param item The item to remove.
+ * @param hash The (full) hash of item.
+ * @return The item.
+ */
+static void * hashtab_removeHash(hashtab_s * ht, const void * item,
+		size_t hash){
+	void * ret;
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	ret = hashtab_removeHere(ht, item, hash);
+	
+	if(ht->other){
+		if(ret == NULL){
+			ret = hashtab_removeHash(ht->other, item, hash);
+		}
+		
+		hashtab_moveOn(ht);
+	}else if(ret != NULL){
+		if(ht->shrink && ht->size > ht->shrink &&
+				hashtab_load(ht) < hashtab_shrinkLoad(ht)){
+			hashtab_resize(ht, (ht->size / 2 > ht->shrink ? 
+					ht->size / 2 : ht->shrink));
+			++ht->shrinks;
+		}
+	}
+	
+	return ret;
+}
+
+void * hashtab_remove(hashtab_s * ht, const void * item){
+	HASHTAB_COUNT(ht, finds, 1);
+	
+	return hashtab_removeHash(ht, item, hashtab_hash(ht, item));
+}
+
+/*
+ * Start batch functions.
+ */
+
+/** @private The number of items the batch functions hash & prefetch at once. */
+#define HASHTAB_BATCH 16
+
+#ifdef __GNUC__
+#define HASHTAB_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define HASHTAB_PREFETCH(p) ((void)(p))
+#endif
+
+/**
+ * @private
+ *
+ * Hashes a batch of items and prefetches their buckets (or first slots), in
+ * this table as well as any other tables.
+ *
+ * @param ht The hash table.
+ * @param items The items.
+ * @param n The number of items, at most HASHTAB_BATCH.
+ * @param [out] hashes The hashes of the items.
+ */
+static void hashtab_prefetchBatch(const hashtab_s * ht,
+		const void * const * items, size_t n, size_t * hashes){
+	const hashtab_s * t;
+	size_t i, b;
+	
+	for(i = 0; i < n; ++i){
+		hashes[i] = hashtab_hash(ht, items[i]);
+		
+		for(t = ht; t; t = t->other){
+			b = hashtab_bucket(t->flags, hashes[i], t->size);
+			
+			if(t->flags & HASHTAB_FLAT){
+				HASHTAB_PREFETCH(t->ctrl + b);
+				HASHTAB_PREFETCH(t->slots + b);
+			}else if(t->flags & HASHTAB_COMPACT){
+				HASHTAB_PREFETCH(t->slots + b);
+			}else{
+				HASHTAB_PREFETCH(t->data + b);
+			}
+		}
+	}
+}
+
+/**
+ * @private
+ *
+ * Prefetches the first links of the buckets of a batch of hashes, which should
+ * themselves be prefetched by now. In compact tables that can be the item.
+ *
+ * @param ht The hash table.
+ * @param n The number of hashes, at most HASHTAB_BATCH.
+ * @param hashes The hashes.
+ */
+static void hashtab_prefetchLinks(const hashtab_s * ht, size_t n,
+		const size_t * hashes){
+	const hashtab_s * t;
+	size_t i, b;
+	
+	for(i = 0; i < n; ++i){
+		for(t = ht; t; t = t->other){
+			if(t->flags & HASHTAB_FLAT){
+				continue;
+			}
+			
+			b = hashtab_bucket(t->flags, hashes[i], t->size);
+			if(t->flags & HASHTAB_COMPACT){
+				HASHTAB_PREFETCH(hashtab_untag(t->slots[b]));
+			}else{
+				HASHTAB_PREFETCH(t->data[b]);
+			}
 		}
+	}
+}
+
+size_t hashtab_findMany(hashtab_s * ht, const void * const * items,
+		void ** out, size_t n){
+	size_t hashes[HASHTAB_BATCH], i, j, m, found = 0;
+	void ** ref;
+	
+	for(i = 0; i < n; i += m){
+		m = n - i < HASHTAB_BATCH ? n - i : HASHTAB_BATCH;
 		
-		hashtab_moveOver(ht);
-	}else if(ret != NULL){
-		--ht->length;
+		hashtab_prefetchBatch(ht, items + i, m, hashes);
+		hashtab_prefetchLinks(ht, m, hashes);
 		
-		if(hash == ht->first){
-			hashtab_findFirst(ht, hash);
+		for(j = 0; j < m; ++j){
+			ref = hashtab_findRef(ht, items[i + j], hashes[j]);
+			out[i + j] = ref ? *ref : NULL;
+			found += ref != NULL;
 		}
+	}
+	
+	return found;
+}
+
+size_t hashtab_addMany(hashtab_s * ht, void * const * items, size_t n){
+	size_t hashes[HASHTAB_BATCH], i, j, m;
+	
+	for(i = 0; i < n; i += m){
+		m = n - i < HASHTAB_BATCH ? n - i : HASHTAB_BATCH;
 		
-		if(ht->shrink && ht->size > ht->shrink &&
-				hashtab_load(ht) < 1.0f - ht->threshold){
-			hashtab_rehash(ht, (ht->size / 2 > ht->shrink ? 
-					ht->size / 2 : ht->shrink));
-			++ht->shrinks;
+		hashtab_prefetchBatch(ht, (const void * const *)items + i, m, hashes);
+		
+		for(j = 0; j < m; ++j){
+			if(hashtab_addHash(ht, items[i + j], hashes[j]) &&
+					hashtab_defend(ht)){
+				/* The rest of the batch was hashed with the old seed. */
+				m = j + 1;
+			}
+		}
+	}
+	
+	return ht->length;
+}
+
+size_t hashtab_removeMany(hashtab_s * ht, const void * const * items,
+		void ** out, size_t n){
+	size_t hashes[HASHTAB_BATCH], i, j, m, removed = 0;
+	void * ret;
+	
+	for(i = 0; i < n; i += m){
+		m = n - i < HASHTAB_BATCH ? n - i : HASHTAB_BATCH;
+		
+		hashtab_prefetchBatch(ht, items + i, m, hashes);
+		hashtab_prefetchLinks(ht, m, hashes);
+		
+		for(j = 0; j < m; ++j){
+			HASHTAB_COUNT(ht, finds, 1);
+			ret = hashtab_removeHash(ht, items[i + j], hashes[j]);
+			if(out){
+				out[i + j] = ret;
+			}
+			removed += ret != NULL;
+		}
+	}
+	
+	return removed;
+}
+
+/*
+ * Start set functions. These move links between tables rather than making new
+ * ones, and use the cached hashes of one table for the other when both hash
+ * items the same (see hashtab_sameHash).
+ */
+
+/**
+ * @private
+ *
+ * Replaces the items of a table: calls a callback for the items of the table
+ * and its other tables, releases their links and drops the other tables.
+ * Then the table takes the buckets (or slots) of the replacement.
+ *
+ * @param ht The hash table.
+ * @param with The replacement, made with hashtab_makeOther and not migrating.
+ * @param cb The callback, or NULL.
+ * @param ctx A context pointer for the callback.
+ */
+static void hashtab_replace(hashtab_s * ht, hashtab_s * with,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	linklist_s * link, * next, one;
+	hashtab_s * t, * other;
+	size_t i;
+	int shared;
+	
+	for(t = ht; t; t = other){
+		other = t->other;
+		
+		for(i = hashtab_next(t, 0); i < t->size; i = hashtab_next(t, i + 1)){
+			if(t->flags & HASHTAB_FLAT){
+				if(cb){
+					cb(t->slots[i], ctx);
+				}
+				continue;
+			}
+			
+			/* A shared chain is left to the snapshots as a whole. */
+			shared = hashtab_shared(t, i);
+			link = hashtab_chain(t, i, &one);
+			if(shared && link != &one){
+				hashtab_retire(t->pool, link);
+			}
+			for(; link; link = next){
+				next = link->next;
+				if(cb){
+					cb(link->item, ctx);
+				}
+				if(!shared && link != &one){
+					hashtab_linkRelease(t->pool, link);
+				}
+			}
+		}
+		
+		if(t != ht){
+			hashtab_drop(t);
+		}
+	}
+	
+	ht->other = with;
+	hashtab_absorb(ht);
+}
+
+/**
+ * @private
+ *
+ * Removes the items of a table that are equal to an item of another, looking
+ * up every item of the other (in all its tables) in the table.
+ *
+ * @param ht The hash table, not compiled.
+ * @param other The other table.
+ * @param keep A table (made with hashtab_makeOther) to add the removed items
+ *        to, or NULL.
+ * @param cb A callback for the removed items if they aren't kept, or NULL.
+ * @param ctx A context pointer for the callback.
+ * @return The number of items removed.
+ */
+static size_t hashtab_removeEach(hashtab_s * ht, const hashtab_s * other,
+		hashtab_s * keep, void (*cb)(void * item, void * ctx), void * ctx){
+	int same = hashtab_sameHash(ht, other);
+	const linklist_s * link;
+	linklist_s one;
+	const hashtab_s * o;
+	hashtab_s * t;
+	size_t i, hash, n = 0;
+	void * item;
+	
+	for(o = other; o; o = o->other){
+		for(i = hashtab_next(o, 0); i < o->size; i = hashtab_next(o, i + 1)){
+			if(o->flags & HASHTAB_FLAT){
+				one.item = o->slots[i];
+				one.hash = o->hashes[i];
+				one.next = NULL;
+				link = &one;
+			}else{
+				link = hashtab_chain(o, i, &one);
+			}
+			
+			for(; link; link = link->next){
+				hash = same && (o->flags & HASHTAB_FLAT || link != &one) ?
+						link->hash : hashtab_hash(ht, link->item);
+				
+				for(t = ht; t; t = t->other){
+					while((item = hashtab_removeHere(t, link->item, hash))){
+						if(keep){
+							hashtab_addHash(keep, item, hash);
+						}else if(cb){
+							cb(item, ctx);
+						}
+						++n;
+					}
+				}
+			}
+		}
+	}
+	
+	return n;
+}
+
+/**
+ * @private
+ *
+ * Removes the items of a table that are (or aren't) in another, looking up
+ * every item of the table in the other. Removed items leave the other buckets
+ * as they are, so the table is walked while removing. Except in Robin Hood
+ * tables, where the items after a removed one shift back: there the slot is
+ * looked at again.
+ *
+ * @param ht The hash table, not compiled.
+ * @param other The other table.
+ * @param in Non-zero to remove the items that are in other, zero to remove
+ *        those that aren't.
+ * @param cb A callback for the removed items, or NULL.
+ * @param ctx A context pointer for the callback.
+ * @return The number of items removed.
+ */
+static size_t hashtab_removeWhere(hashtab_s * ht, hashtab_s * other, int in,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	int same = hashtab_sameHash(ht, other);
+	linklist_s * link, one;
+	size_t i, k, kept, hash, n = 0;
+	hashtab_s * t;
+	void * item;
+	
+	for(t = ht; t; t = t->other){
+		for(i = hashtab_next(t, 0); i < t->size; i = hashtab_next(t, i + 1)){
+			for(kept = 0; ; ){
+				if(t->flags & HASHTAB_FLAT){
+					if(kept || !HASHTAB_ISFULL(t->ctrl[i])){
+						break;
+					}
+					one.item = t->slots[i];
+					one.hash = t->hashes[i];
+					link = &one;
+				}else{
+					/* The chain may have been copied (or turned into a single
+					   item) by the last removal, the kept links come first. */
+					link = hashtab_chain(t, i, &one);
+					for(k = 0; link && k < kept; ++k){
+						link = link->next;
+					}
+					if(!link){
+						break;
+					}
+				}
+				
+				item = link->item;
+				hash = t->flags & HASHTAB_FLAT || link != &one ? link->hash :
+						hashtab_hash(t, item);
+				
+				if(!hashtab_findRef(other, item, same ? hash :
+						hashtab_hash(other, item)) == !!in){
+					++kept;
+					continue;
+				}
+				
+				if(t->flags & HASHTAB_FLAT){
+					hashtab_flatErase(t, i);
+				}else{
+					hashtab_removeHere(t, item, hash);
+				}
+				
+				if(cb){
+					cb(item, ctx);
+				}
+				++n;
+			}
+		}
+	}
+	
+	return n;
+}
+
+size_t hashtab_merge(hashtab_s * dst, hashtab_s * src,
+		void (*combine)(void * item, void * other, void * ctx), void * ctx){
+	hashtab_pool_s * pool = src->pool;
+	int same, steal, flooded;
+	linklist_s * link, * next, one;
+	size_t i, j, hash, n = 0;
+	hashtab_s * t;
+	void ** ref;
+	void * item;
+	
+	if(src->flags & HASHTAB_COMPILED){
+		hashtab_decompile(src);
+	}
+	
+	hashtab_presize(dst, hashtab_length(dst) + hashtab_length(src));
+	same = hashtab_sameHash(dst, src);
+	
+	/* The links of src can only become dst's if no snapshot still sees them,
+	   and they can be released the same way. */
+	steal = !(dst->flags & HASHTAB_FLAT) && !(src->flags & HASHTAB_FLAT) &&
+			pool != dst->pool &&
+			pool->alloc.allocate == dst->pool->alloc.allocate &&
+			pool->alloc.release == dst->pool->alloc.release &&
+			pool->alloc.ctx == dst->pool->alloc.ctx &&
+			HASHTAB_ATOMIC_LOAD(&pool->refs) == 1;
+	if(steal){
+		hashtab_reclaim(pool);
+		hashtab_poolSplice(dst->pool, pool);
+		pool = dst->pool;
+	}
+	
+	for(t = src; t; t = t->other){
+		for(i = hashtab_next(t, 0); i < t->size; i = hashtab_next(t, i + 1)){
+			if(t->flags & HASHTAB_FLAT){
+				one.item = t->slots[i];
+				one.hash = t->hashes[i];
+				one.next = NULL;
+				link = &one;
+			}else{
+				hashtab_own(t, i);
+				link = hashtab_chain(t, i, &one);
+				
+				if(t->flags & HASHTAB_COMPACT){
+					t->slots[i] = NULL;
+				}else{
+					t->data[i] = NULL;
+				}
+			}
+			
+			for(; link; link = next){
+				next = link->next;
+				item = link->item;
+				hash = same && (t->flags & HASHTAB_FLAT || link != &one) ?
+						link->hash : hashtab_hash(dst, item);
+				
+				if(combine && (ref = hashtab_findRef(dst, item, hash))){
+					combine(*ref, item, ctx);
+					flooded = 0;
+				}else if(steal && link != &one){
+					link->hash = hash;
+					j = hashtab_addLink(dst, link);
+					flooded = dst->maxChain && hashtab_flooded(dst, j, hash);
+					link = NULL;
+					++n;
+				}else{
+					flooded = hashtab_addHash(dst, item, hash);
+					++n;
+				}
+				
+				if(link && link != &one){
+					hashtab_linkRelease(pool, link);
+				}
+				
+				/* Reseeding changes the hashes of dst. */
+				if(flooded && hashtab_defend(dst)){
+					same = hashtab_sameHash(dst, src);
+				}
+			}
+		}
+	}
+	
+	hashtab_replace(src, hashtab_makeOther(src, src->size), NULL, NULL);
+	
+	return n;
+}
+
+size_t hashtab_intersect(hashtab_s * ht, hashtab_s * other,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	size_t n = hashtab_length(ht);
+	hashtab_s * keep, * t;
+	
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	if(n <= hashtab_length(other)){
+		return hashtab_removeWhere(ht, other, 0, cb, ctx);
+	}
+	
+	/* Move the items that are in other aside, and drop the rest at once. */
+	for(t = ht; t->other; t = t->other);
+	keep = hashtab_makeOther(ht, t->size);
+	
+	hashtab_removeEach(ht, other, keep, NULL, NULL);
+	hashtab_replace(ht, keep, cb, ctx);
+	
+	return n - ht->length;
+}
+
+size_t hashtab_difference(hashtab_s * ht, hashtab_s * other,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	if(ht->flags & HASHTAB_COMPILED){
+		hashtab_decompile(ht);
+	}
+	
+	if(hashtab_length(other) < hashtab_length(ht)){
+		return hashtab_removeEach(ht, other, NULL, cb, ctx);
+	}
+	
+	return hashtab_removeWhere(ht, other, 1, cb, ctx);
+}
+
+/**
+ * @private
+ *
+ * Copies a hash table (and its other tables), taking the links and memory
+ * from a given pool.
+ *
+ * @param src The original hash table.
+ * @param pool The pool for the copy.
+ * @param cpy The callback to make copies of the items, or NULL.
+ * @param ctx A context pointer for the callback.
+ * @return A copy of the hash table.
+ */
+static hashtab_s * hashtab_copyPooled(const hashtab_s * src,
+		hashtab_pool_s * pool, void * (cpy)(const void * item, void * ctx),
+		void * ctx){
+	hashtab_s * ret = hashtab_malloc(pool, sizeof *ret);
+	const linklist_s * link;
+	linklist_s ** tail, * head;
+	size_t i;
+	
+	memcpy(ret, src, sizeof *ret);
+	ret->pool = pool;
+	ret->spare = NULL;
+	ret->owned = NULL;
+	ret->snap = NULL;
+	ret->flags &= ~HASHTAB_SNAPSHOT;
+	
+	if(src->flags & HASHTAB_FLAT){
+		ret->ctrl = hashtab_malloc(pool, ret->size + HASHTAB_GROUP - 1);
+		memcpy(ret->ctrl, src->ctrl, ret->size + HASHTAB_GROUP - 1);
+		ret->slots = hashtab_malloc(pool, ret->size * sizeof *ret->slots);
+		ret->hashes = hashtab_malloc(pool, ret->size * sizeof *ret->hashes);
+		memcpy(ret->hashes, src->hashes, ret->size * sizeof *ret->hashes);
+		
+		for(i = 0; i < ret->size; i++){
+			if(HASHTAB_ISFULL(src->ctrl[i])){
+				ret->slots[i] = cpy ? cpy(src->slots[i], ctx) : src->slots[i];
+			}
+		}
+		
+		if(src->pilots){
+			ret->pilots = hashtab_malloc(pool, src->pilotCount *
+					sizeof *ret->pilots);
+			memcpy(ret->pilots, src->pilots, src->pilotCount *
+					sizeof *ret->pilots);
 		}
+	}else{
+		if(src->flags & HASHTAB_COMPACT){
+			ret->slots = hashtab_malloc(pool, ret->size * sizeof *ret->slots);
+		}else{
+			ret->data = hashtab_malloc(pool, ret->size * sizeof *ret->data);
+		}
+		ret->occupied = hashtab_bitsMake(pool, ret->size);
+		memcpy(ret->occupied, src->occupied, ((ret->size + HASHTAB_WORD - 1) /
+				HASHTAB_WORD) * sizeof *ret->occupied);
+		
+		for(i = 0; i < ret->size; i++){
+			if(src->flags & HASHTAB_COMPACT && !HASHTAB_TAGGED(src->slots[i])){
+				ret->slots[i] = src->slots[i] && cpy ?
+						cpy(src->slots[i], ctx) : src->slots[i];
+				continue;
+			}
+			
+			tail = &head;
+			
+			for(link = hashtab_links(src, i); link; link = link->next){
+				*tail = hashtab_linkMake(pool, cpy ? cpy(link->item, ctx) :
+						link->item, link->hash);
+				tail = &(*tail)->next;
+			}
+			
+			*tail = NULL;
+			
+			if(src->flags & HASHTAB_COMPACT){
+				ret->slots[i] = hashtab_tagged(head);
+			}else{
+				ret->data[i] = head;
+			}
+		}
+	}
+	
+	if(src->other){
+		ret->other = hashtab_copyPooled(src->other, pool, cpy, ctx);
 	}
 	
 	return ret;
@@ -532,42 +4291,442 @@ void * hashtab_remove(hashtab_s * ht, const void * item){
 
 hashtab_s * hashtab_copy(const hashtab_s * src, void * (cpy)(const void
 		* item, void * ctx), void * ctx){
-	hashtab_s * ret = safeMalloc(sizeof *ret);
+	return hashtab_copyPooled(src, hashtab_poolMake(&src->pool->alloc), cpy,
+			ctx);
+}
+
+/**
+ * @private
+ *
+ * Snapshots a table and its other tables. The buckets (or slots) are copied,
+ * chains are shared: all of them are marked as not owned by the table.
+ *
+ * @param ht The hash table.
+ * @return The snapshot.
+ */
+static hashtab_s * hashtab_snapshotTable(hashtab_s * ht){
+	hashtab_pool_s * pool = ht->pool;
+	hashtab_s * ret = hashtab_malloc(pool, sizeof *ret);
+	size_t words = (ht->size + HASHTAB_WORD - 1) / HASHTAB_WORD;
+	
+	memcpy(ret, ht, sizeof *ret);
+	ret->spare = NULL;
+	ret->owned = NULL;
+	ret->snap = NULL;
+	ret->flags |= HASHTAB_SNAPSHOT;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		ret->ctrl = hashtab_malloc(pool, ht->size + HASHTAB_GROUP - 1);
+		memcpy(ret->ctrl, ht->ctrl, ht->size + HASHTAB_GROUP - 1);
+		ret->slots = hashtab_malloc(pool, ht->size * sizeof *ret->slots);
+		memcpy(ret->slots, ht->slots, ht->size * sizeof *ret->slots);
+		ret->hashes = hashtab_malloc(pool, ht->size * sizeof *ret->hashes);
+		memcpy(ret->hashes, ht->hashes, ht->size * sizeof *ret->hashes);
+		
+		if(ht->pilots){
+			ret->pilots = hashtab_malloc(pool, ht->pilotCount *
+					sizeof *ret->pilots);
+			memcpy(ret->pilots, ht->pilots, ht->pilotCount *
+					sizeof *ret->pilots);
+		}
+	}else{
+		if(ht->flags & HASHTAB_COMPACT){
+			ret->slots = hashtab_malloc(pool, ht->size * sizeof *ret->slots);
+			memcpy(ret->slots, ht->slots, ht->size * sizeof *ret->slots);
+		}else{
+			ret->data = hashtab_malloc(pool, ht->size * sizeof *ret->data);
+			memcpy(ret->data, ht->data, ht->size * sizeof *ret->data);
+		}
+		ret->occupied = hashtab_bitsMake(pool, ht->size);
+		memcpy(ret->occupied, ht->occupied, words * sizeof *ret->occupied);
+		
+		if(!ht->owned){
+			ht->owned = hashtab_bitsMake(pool, ht->size);
+		}else{
+			memset(ht->owned, 0, words * sizeof *ht->owned);
+		}
+	}
+	
+	ret->other = ht->other ? hashtab_snapshotTable(ht->other) : NULL;
+	
+	return ret;
+}
+
+hashtab_s * hashtab_snapshot(hashtab_s * ht){
+	hashtab_pool_s * pool = ht->pool;
+	hashtab_snap_s * snap = hashtab_malloc(pool, sizeof *snap);
+	hashtab_s * ret;
+	
+	hashtab_reclaim(pool);
+	
+	snap->next = NULL;
+	snap->gen = ++pool->gen;
+	snap->freed = 0;
+	if(pool->lastSnap){
+		pool->lastSnap->next = snap;
+	}else{
+		pool->snaps = snap;
+	}
+	pool->lastSnap = snap;
+	HASHTAB_ATOMIC_INC(&pool->refs);
+	
+	ret = hashtab_snapshotTable(ht);
+	ret->snap = snap;
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Frees a hash table and its other tables, but not their links: those are
+ * freed with the pool.
+ *
+ * @param ht The hash table.
+ * @param cb A callback to free the items left in the hash table, or NULL.
+ * @param ctx A context pointer for the callback.
+ */
+static void hashtab_freeTables(hashtab_s * ht,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	linklist_s * link, one;
 	size_t i;
 	
-	memcpy(ret, src, sizeof *ret);
+	if(ht->other){
+		hashtab_freeTables(ht->other, cb, ctx);
+	}
+	
+	if(ht->flags & HASHTAB_FLAT){
+		for(i = hashtab_next(ht, 0); cb && i < ht->size;
+				i = hashtab_next(ht, i + 1)){
+			cb(ht->slots[i], ctx);
+		}
+	}else{
+		for(i = hashtab_next(ht, 0); cb && i < ht->size;
+				i = hashtab_next(ht, i + 1)){
+			for(link = hashtab_chain(ht, i, &one); link; link = link->next){
+				cb(link->item, ctx);
+			}
+		}
+	}
+	
+	hashtab_drop(ht);
+}
+
+void hashtab_free(hashtab_s * ht, void (*cb)(void * item, void * ctx),
+		void * ctx){
+	hashtab_pool_s * pool = ht->pool;
+	hashtab_snap_s * snap = ht->snap;
+	
+	hashtab_freeTables(ht, cb, ctx);
+	
+	/* The table re-uses the links only this snapshot could see, and the last
+	   of the table and its snapshots frees them. */
+	if(snap){
+		HASHTAB_ATOMIC_STORE(&snap->freed, 1);
+	}
+	if(HASHTAB_ATOMIC_DEC(&pool->refs) == 0){
+		hashtab_poolFree(pool);
+	}
+}
+
+/*
+ * Start parallel functions. Without OpenMP these run on the calling thread.
+ */
+
+/** @private The number of buckets a thread takes at a time. */
+#define HASHTAB_CHUNK 4096
+
+#ifdef _OPENMP
+/** @private The number of the calling thread in a parallel function. */
+#define HASHTAB_THREAD() omp_get_thread_num()
+#else
+#define HASHTAB_THREAD() 0
+#endif
+
+void hashtab_forEachParallel(hashtab_s * ht, int nthreads,
+		void (*callback)(void * item, void * ctx), void * const * ctxs,
+		void (*reduce)(void * ctx, void * other)){
+	int t;
+	
+	if(nthreads < 1){
+		nthreads = 1;
+	}
+	
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+	{
+		void * ctx = ctxs ? ctxs[HASHTAB_THREAD()] : NULL;
+		const hashtab_s * tab;
+		size_t i;
+		
+		/* No barrier between tables: threads done with one go on to the next. */
+		for(tab = ht; tab; tab = tab->other){
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, HASHTAB_CHUNK) nowait
+#endif
+			for(i = 0; i < tab->size; ++i){
+				hashtab_forBucket(tab, i, callback, ctx);
+			}
+		}
+	}
+	
+	for(t = 1; reduce && ctxs && t < nthreads; ++t){
+		reduce(ctxs[0], ctxs[t]);
+	}
+}
+
+/**
+ * @private
+ *
+ * Copies a hash table (and its other tables) in parallel, see
+ * hashtab_copyPooled. The links of a chained table are allocated as one block,
+ * so that every bucket knows where its links go before any are copied.
+ *
+ * @param src The original hash table.
+ * @param pool The pool for the copy.
+ * @param nthreads The number of threads.
+ * @param cpy The callback to make copies of the items, or NULL.
+ * @param ctxs The contexts for the callback, one per thread, or NULL.
+ * @return A copy of the hash table.
+ */
+static hashtab_s * hashtab_copyParallelPooled(const hashtab_s * src,
+		hashtab_pool_s * pool, int nthreads, void * (*cpy)(const void * item,
+		void * ctx), void * const * ctxs){
+	hashtab_s * ret = hashtab_malloc(pool, sizeof *ret);
+	linklist_s * links = NULL;
+	size_t * start = NULL, i;
 	
-	ret->data = safeMalloc(ret->size * sizeof *ret->data);
+	memcpy(ret, src, sizeof *ret);
+	ret->pool = pool;
+	ret->spare = NULL;
+	ret->owned = NULL;
+	ret->snap = NULL;
+	ret->flags &= ~HASHTAB_SNAPSHOT;
 	
-	for(i = 0; i < ret->size; i++){
-		if(src->data[i]){
-			ret->data[i] = linklist_copy(src->data[i], cpy, ctx);
+	if(src->flags & HASHTAB_FLAT){
+		ret->ctrl = hashtab_malloc(pool, ret->size + HASHTAB_GROUP - 1);
+		memcpy(ret->ctrl, src->ctrl, ret->size + HASHTAB_GROUP - 1);
+		ret->slots = hashtab_malloc(pool, ret->size * sizeof *ret->slots);
+		ret->hashes = hashtab_malloc(pool, ret->size * sizeof *ret->hashes);
+		memcpy(ret->hashes, src->hashes, ret->size * sizeof *ret->hashes);
+		
+		if(src->pilots){
+			ret->pilots = hashtab_malloc(pool, src->pilotCount *
+					sizeof *ret->pilots);
+			memcpy(ret->pilots, src->pilots, src->pilotCount *
+					sizeof *ret->pilots);
+		}
+	}else{
+		if(src->flags & HASHTAB_COMPACT){
+			ret->slots = hashtab_malloc(pool, ret->size * sizeof *ret->slots);
 		}else{
-			ret->data[i] = NULL;
+			ret->data = hashtab_malloc(pool, ret->size * sizeof *ret->data);
+		}
+		ret->occupied = hashtab_bitsMake(pool, ret->size);
+		memcpy(ret->occupied, src->occupied, ((ret->size + HASHTAB_WORD - 1) /
+				HASHTAB_WORD) * sizeof *ret->occupied);
+		
+		/* start[i + 1] is first the number of links of bucket i, then the end
+		   of its links. */
+		start = hashtab_malloc(pool, (ret->size + 1) * sizeof *start);
+		start[0] = 0;
+		
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, HASHTAB_CHUNK)
+#endif
+		for(i = 0; i < ret->size; ++i){
+			const linklist_s * link;
+			size_t n = 0;
+			
+			for(link = hashtab_links(src, i); link; link = link->next){
+				++n;
+			}
+			start[i + 1] = n;
+		}
+		
+		for(i = 0; i < ret->size; ++i){
+			start[i + 1] += start[i];
+		}
+		
+		links = hashtab_linksMake(pool, start[ret->size]);
+	}
+	
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+	{
+		void * ctx = ctxs ? ctxs[HASHTAB_THREAD()] : NULL;
+		const linklist_s * link;
+		linklist_s * to;
+		size_t j;
+		
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, HASHTAB_CHUNK)
+#endif
+		for(j = 0; j < ret->size; ++j){
+			if(src->flags & HASHTAB_FLAT){
+				if(HASHTAB_ISFULL(src->ctrl[j])){
+					ret->slots[j] = cpy ? cpy(src->slots[j], ctx) :
+							src->slots[j];
+				}
+				continue;
+			}
+			
+			to = links + start[j];
+			if(!(src->flags & HASHTAB_COMPACT)){
+				ret->data[j] = src->data[j] ? to : NULL;
+			}else if(HASHTAB_TAGGED(src->slots[j])){
+				ret->slots[j] = hashtab_tagged(to);
+			}else{
+				ret->slots[j] = src->slots[j] && cpy ?
+						cpy(src->slots[j], ctx) : src->slots[j];
+			}
+			
+			for(link = hashtab_links(src, j); link; link = link->next, ++to){
+				to->item = cpy ? cpy(link->item, ctx) : link->item;
+				to->hash = link->hash;
+				to->next = link->next ? to + 1 : NULL;
+			}
 		}
 	}
 	
+	hashtab_release(pool, start);
+	
 	if(src->other){
-		ret->other = hashtab_copy(src->other, cpy, ctx);
+		ret->other = hashtab_copyParallelPooled(src->other, pool, nthreads, cpy,
+				ctxs);
 	}
 	
 	return ret;
 }
 
-void hashtab_free(hashtab_s * ht, void (*cb)(void * item, void * ctx),
-		void * ctx){
-	size_t i;
+hashtab_s * hashtab_copyParallel(const hashtab_s * src, int nthreads,
+		void * (*cpy)(const void * item, void * ctx), void * const * ctxs){
+	return hashtab_copyParallelPooled(src, hashtab_poolMake(&src->pool->alloc),
+			nthreads < 1 ? 1 : nthreads, cpy, ctxs);
+}
+
+void hashtab_freeParallel(hashtab_s * ht, int nthreads,
+		void (*cb)(void * item, void * ctx), void * const * ctxs){
+	if(cb){
+		hashtab_forEachParallel(ht, nthreads, cb, ctxs, NULL);
+	}
 	
-	if(ht->other){
-		hashtab_free(ht->other, cb, ctx);
+	hashtab_free(ht, NULL, NULL);
+}
+
+/**
+ * @private
+ *
+ * Adds the chains (or probe lengths) and memory of a single table to stats.
+ *
+ * @param ht The hash table (not its other tables).
+ * @param stats The statistics to add to.
+ * @param probes Receives the sum of the probe lengths of all items.
+ */
+static void hashtab_statsTable(const hashtab_s * ht, hashtab_stats_s * stats,
+		size_t * probes){
+	size_t i, n, d;
+	linklist_s * ll, one;
+	
+	stats->bytes += sizeof *ht;
+	
+	if(ht->flags & HASHTAB_FLAT){
+		stats->bytes += ht->size + HASHTAB_GROUP - 1 +
+				ht->size * (sizeof *ht->slots + sizeof *ht->hashes) +
+				ht->pilotCount * sizeof *ht->pilots;
+		
+		for(i = 0; i < ht->size; ++i){
+			if(!HASHTAB_ISFULL(ht->ctrl[i])){
+				++stats->empty;
+				continue;
+			}
+			
+			/* Compiled tables find every item in its own slot. */
+			if(ht->flags & HASHTAB_COMPILED){
+				++stats->chains[0];
+				++*probes;
+				stats->maxProbe = 1;
+				continue;
+			}
+			
+			d = hashtab_bucket(ht->flags, ht->hashes[i], ht->size);
+			d = i >= d ? i - d : i + ht->size - d;
+			if(d > stats->maxDisplacement){
+				stats->maxDisplacement = d;
+			}
+			
+			/* The number of groups (or slots in Robin Hood tables) a find of
+			   the item probes. */
+			if(!(ht->flags & HASHTAB_ROBIN)){
+				d /= HASHTAB_GROUP;
+			}
+			
+			++stats->chains[d < HASHTAB_STATS_CHAINS ? d :
+					HASHTAB_STATS_CHAINS - 1];
+			*probes += d + 1;
+			if(d + 1 > stats->maxProbe){
+				stats->maxProbe = d + 1;
+			}
+		}
+		
+		return;
 	}
 	
+	stats->bytes += ht->size * sizeof *ht->data +
+			(ht->size + HASHTAB_WORD - 1) / HASHTAB_WORD * sizeof *ht->occupied;
+	
 	for(i = 0; i < ht->size; ++i){
-		linklist_free(ht->data[i], cb, ctx);
+		for(n = 0, ll = hashtab_chain(ht, i, &one); ll; ll = ll->next){
+			++n;
+		}
+		
+		++stats->chains[n < HASHTAB_STATS_CHAINS ? n :
+				HASHTAB_STATS_CHAINS - 1];
+		stats->empty += n == 0;
+		/* Finding the k-th item of a chain walks k links. */
+		*probes += n * (n + 1) / 2;
+		if(n > stats->maxProbe){
+			stats->maxProbe = n;
+		}
+	}
+}
+
+void hashtab_stats(const hashtab_s * ht, hashtab_stats_s * stats){
+	const hashtab_pool_s * pool = ht->pool;
+	const hashtab_slab_s * slab;
+	const hashtab_s * t;
+	size_t probes = 0, buckets = 0;
+	
+	memset(stats, 0, sizeof *stats);
+	
+	stats->size = ht->size;
+	stats->otherSize = ht->other ? ht->other->size : 0;
+	stats->pending = ht->other ? ht->length : 0;
+	
+	for(t = ht; t; t = t->other){
+		stats->length += t->length;
+		buckets += t->size;
+		hashtab_statsTable(t, stats, &probes);
+	}
+	
+	stats->emptyRatio = (float) stats->empty / (float) buckets;
+	stats->meanProbe = stats->length ? (float) probes / (float) stats->length
+			: 0;
+	
+	stats->bytes += sizeof *pool + pool->links * sizeof *pool->slabs->links;
+	for(slab = pool->slabs; slab; slab = slab->next){
+		stats->bytes += sizeof *slab;
 	}
 	
-	free(ht->data);
-	free(ht);
+	stats->allocs = pool->allocs;
+	stats->reallocs = pool->reallocs;
+#ifdef HASHTAB_COUNTERS
+	stats->finds = pool->finds;
+	stats->probes = pool->probes;
+	stats->cmps = pool->cmps;
+#endif
 }
 
 /* Print meta-data about a hash table. */
@@ -580,9 +4739,11 @@ void hashtab_printHead(hashtab_s * ht, int other){
 		   "grows:   %u\n"
 		   "shrinks: %u\n"
 		   "moveR:   %u\n"
+		   "flat:    %s\n"
 		   "other:   %s\n\n", ht->size, ht->length, hashtab_load(ht), 
 				ht->threshold, ht->first, ht->grows, ht->shrinks, 
-				ht->moveR, (ht->other ? "yes" : "no"));
+				ht->moveR, (ht->flags & HASHTAB_FLAT ? "yes" : "no"),
+				(ht->other ? "yes" : "no"));
 	if(other && ht->other){
 		hashtab_printHead(ht->other, other);
 	}
@@ -590,13 +4751,20 @@ void hashtab_printHead(hashtab_s * ht, int other){
 
 /* Print the hash table using callback to print each item itself. */
 void hashtab_print(hashtab_s * ht, void (*callback)(const void * item)){
+	linklist_s one;
 	size_t i;
 	
 	hashtab_printHead(ht, 0);
 	
 	for(i = 0; i < ht->size; ++i){
 		printf("	%u: ", i);
-		linklist_print(ht->data[i], callback);
+		if(!(ht->flags & HASHTAB_FLAT)){
+			linklist_print(hashtab_chain(ht, i, &one), callback);
+		}else if(HASHTAB_ISFULL(ht->ctrl[i])){
+			callback(ht->slots[i]);
+		}else if(ht->ctrl[i] == HASHTAB_DELETED){
+			printf("(deleted)");
+		}
 		putchar('\n');
 	}
 	
@@ -606,5 +4774,10 @@ void hashtab_print(hashtab_s * ht, void (*callback)(const void * item)){
 }
 
 void printMemStats(){
-	fprintf(stderr, "mallocs: %u, reallocs: %u\n", mallocs, reallocs);
+	fprintf(stderr, "mallocs: %zu, reallocs: %zu\n", mallocs, reallocs);
+}
+
+void getMemStats(size_t * nMallocs, size_t * nReallocs){
+	*nMallocs = mallocs;
+	*nReallocs = reallocs;
 }
@@ -34,6 +34,7 @@
 #define HASHTAB_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifndef HASHTAB_NO_EXPORT_LL
 
@@ -41,12 +42,59 @@
 typedef struct linklist{
 	/** The stored item. */
 	void * item;
+	/** The hash of the item, as cached by the hash table. */
+	size_t hash;
 	/** The next link (or NULL). */
 	struct linklist * next;
 } linklist_s;
 
 #endif /* HASHTAB_NO_EXPORT_LL */
 
+/** Table flag: store items in a flat, open-addressed table (see
+    hashtab_makeFlat). */
+#define HASHTAB_FLAT 0x1
+/** Table flag: round sizes up to powers of two and select buckets by masking
+    the hash instead of dividing by the size. */
+#define HASHTAB_POW2 0x2
+/** Table flag: mix the bits of every hash (with a MurmurHash3-style
+    finalizer) so weak hashes still spread over all buckets. */
+#define HASHTAB_MIX 0x4
+/** Table flag: set (along with HASHTAB_FLAT) on tables made static by
+    hashtab_compile. Not to be passed to hashtab_makeFlags. */
+#define HASHTAB_COMPILED 0x8
+/** Table flag: a flat table (implies HASHTAB_FLAT) with Robin Hood hashing:
+    items are kept about equally far from where their probe starts, so the
+    longest probes stay short, and removing leaves no tombstones. */
+#define HASHTAB_ROBIN 0x10
+/** Table flag: a chained table whose buckets hold a single item by itself,
+    without a link, and only make links when items collide. Items must be at
+    least 2-byte aligned. Ignored for flat tables. */
+#define HASHTAB_COMPACT 0x20
+
+/** The longest chain a bucket of a seeded table may have at first, see
+    hashtab_makeSeeded. With a random seed it's as good as never reached. */
+#define HASHTAB_MAX_CHAIN 16
+
+/**
+ * A custom memory allocator for hash tables (see hashtab_makeAlloc). It's used
+ * for the table itself, its buckets and its links, and for the scratch memory
+ * of hashtab_compile, hashtab_fromArray and hashtab_copyParallel.
+ */
+typedef struct hashtab_alloc{
+	/** Allocate n bytes. Returning NULL is fatal. */
+	void * (*allocate)(size_t n, void * ctx);
+	/** Release memory returned by allocate. */
+	void (*release)(void * p, void * ctx);
+	/** A context pointer for both callbacks. */
+	void * ctx;
+} hashtab_alloc_s;
+
+/** @private The allocator and link pool of a hash table. */
+typedef struct hashtab_pool hashtab_pool_s;
+
+/** @private A snapshot of a hash table, see hashtab_snapshot. */
+typedef struct hashtab_snap hashtab_snap_s;
+
 /** A simple but effective hash table. */
 typedef struct hashtab{
 	/** The number of items. */
@@ -57,8 +105,17 @@ typedef struct hashtab{
 	/** @private The first non-empty slot. */
 	size_t first;
 	
-	/** The hash function for items. */
+	/** The hash function for items, NULL in seeded tables. */
 	size_t (*hasher)(const void * item);
+	/** Seeded tables: the hash function for items, which gets the seed of the
+	    table as well. Otherwise NULL. */
+	size_t (*seededHasher)(const void * item, size_t seed);
+	/** @private Seeded tables: the (random) seed passed to seededHasher. */
+	size_t hashSeed;
+	/** Seeded tables: the longest chain a bucket may have after an add (in
+	    flat tables: the most groups of slots an added item may be from where
+	    its probe starts) before the table is reseeded, 0 to never reseed. */
+	size_t maxChain;
 	/** The compare function for items. */
 	int (*cmp)(const void * a, const void * b);
 	/** The load factor threshold. */
@@ -72,21 +129,134 @@ typedef struct hashtab{
 	size_t grows;
 	/** The number of times the table shrunk. */
 	size_t shrinks;
+	/** The number of times the table was reseeded. */
+	size_t reseeds;
+	/** @private The number of items from which the table may be reseeded by
+	    an add again. */
+	size_t reseedAt;
 	
 	/** @private The items. */
 #ifdef HASHTAB_NO_EXPORT_LL
 	struct hashtab_linklist{
 		void * item;
+		size_t hash;
 		struct hashtab_linklist * next;
 	} ** data;
 #else
 	linklist_s ** data;
 #endif
+	/** @private Chained tables: a bit per bucket, set if it's non-empty. */
+	uint64_t * occupied;
+	/** @private Chained tables that were snapshot: a bit per bucket, set if
+	    its chain is the table's own (not shared with a snapshot). NULL if
+	    they all are. */
+	uint64_t * owned;
 	
 	/** @private When migrating: the next table, otherwise NULL. */
 	struct hashtab * other;
+	/** @private The (empty) table made by hashtab_prepareGrow to grow into
+	    next, or NULL. */
+	struct hashtab * spare;
+	
+	/** Flags describing how the table is stored (HASHTAB_FLAT, ...). */
+	int flags;
+	/** @private Flat tables: the number of deleted slots (tombstones). */
+	size_t deleted;
+	/** @private Flat tables: a control byte per slot: empty, deleted or a
+	    7-bit tag of the item's hash. */
+	unsigned char * ctrl;
+	/** @private Flat tables: the items. */
+	void ** slots;
+	/** @private Flat tables: the (cached) hashes of the items. */
+	size_t * hashes;
+	/** @private Compiled tables: a pilot per group of items, which together
+	    with the seed selects the slots of the items in the group. */
+	uint32_t * pilots;
+	/** @private Compiled tables: the number of pilots, a power of two. */
+	size_t pilotCount;
+	/** @private Compiled tables: the seed of the perfect hash. */
+	size_t seed;
+	
+	/** @private The allocator and link pool, shared with other (and with
+	    snapshots). */
+	hashtab_pool_s * pool;
+	/** @private Snapshots: the snapshot in the list of its pool, NULL for
+	    other tables. */
+	hashtab_snap_s * snap;
+	
+	/** Free for use by the owner of the table (or wrappers like stringmap),
+	    NULL initially. hashtab_copy and hashtab_snapshot copy it as is. */
+	void * ctx;
 } hashtab_s;
 
+/** The number of chain lengths hashtab_stats counts separately. */
+#define HASHTAB_STATS_CHAINS 16
+
+/**
+ * Statistics about a hash table and the table it's migrating to (if any), see
+ * hashtab_stats.
+ */
+typedef struct hashtab_stats{
+	/** The number of items. */
+	size_t length;
+	/** The size of the table. */
+	size_t size;
+	/** When migrating: the size of the other table, otherwise 0. */
+	size_t otherSize;
+	/** When migrating: the number of items not yet moved to the other table,
+	    otherwise 0. */
+	size_t pending;
+	/** Chained tables: the number of buckets holding i items (the last one
+	    counts all longer chains as well). Flat tables: the number of items in
+	    the i-th group of slots (in Robin Hood tables: the i-th slot) from
+	    where their probe sequence starts. */
+	size_t chains[HASHTAB_STATS_CHAINS];
+	/** The number of empty buckets (or slots). */
+	size_t empty;
+	/** The number of empty buckets (or slots) as a fraction of all of them. */
+	float emptyRatio;
+	/** The longest probe length: the number of links (or groups of slots, or
+	    slots in Robin Hood tables) a find of any item has to look at. */
+	size_t maxProbe;
+	/** Flat tables: the largest distance (in slots) of any item from the slot
+	    its probe sequence starts at. Otherwise 0. */
+	size_t maxDisplacement;
+	/** The average probe length of the items. */
+	float meanProbe;
+	/** The number of bytes allocated for the tables, buckets and links. */
+	size_t bytes;
+	/** The number of allocations made for the table so far. */
+	size_t allocs;
+	/** The number of re-allocations made for the table so far. */
+	size_t reallocs;
+	/** When compiled with HASHTAB_COUNTERS: the number of lookups (by find,
+	    insert and remove) so far. Otherwise 0. */
+	size_t finds;
+	/** When compiled with HASHTAB_COUNTERS: the number of links (or groups of
+	    slots) the lookups probed. Otherwise 0. */
+	size_t probes;
+	/** When compiled with HASHTAB_COUNTERS: the number of cmp calls the lookups
+	    made. Otherwise 0. */
+	size_t cmps;
+} hashtab_stats_s;
+
+/**
+ * An iterator over the items of a hash table, see hashtab_iterNext. Its members
+ * are private.
+ */
+typedef struct hashtab_iter{
+	/** @private The table being walked, or NULL when done. */
+	const hashtab_s * table;
+	/** @private The next bucket (or slot) to look at. */
+	size_t i;
+	/** @private The next link in the current bucket, or NULL. */
+#ifdef HASHTAB_NO_EXPORT_LL
+	const struct hashtab_linklist * link;
+#else
+	const linklist_s * link;
+#endif
+} hashtab_iter_s;
+
 /**
  * The size of the hash table.
  *
@@ -127,10 +297,19 @@ size_t hashtab_length(hashtab_s * ht);
  */
 #define hashtab_shrinks(ht) (ht->shrinks)
 
+/**
+ * The pointer kept for the owner of the hash table, see hashtab_s.ctx.
+ *
+ * @param ht The hash table.
+ * @return The pointer.
+ */
+#define hashtab_ctx(ht) (ht->ctx)
+
 #ifndef HASHTAB_NO_EXPORT_LL
 
 /**
- * Allocate a linklist and fill it with an item and point it to the next.
+ * Allocate a linklist and fill it with an item and point it to the next. Its
+ * hash is set to 0.
  *
  * @param item The item.
  * @param next The next node, or NULL.
@@ -161,6 +340,20 @@ linklist_s * linklist_add(linklist_s * ll, void * item);
 linklist_s * linklist_find(linklist_s * ll, const void * item, 
 		int (*cmp)(const void * needle, const void * hay));
 
+/**
+ * Find the link that contains item, only calling cmp for links whose cached
+ * hash equals hash.
+ *
+ * @param ll The linklist to start with.
+ * @param item The item to find.
+ * @param hash The hash of item.
+ * @param cmp A function that gets item as its first argument, and a candidate
+ *        as the second. It must return 0 if they are considered equal.
+ * @return The link containing item, or NULL if not found.
+ */
+linklist_s * linklist_findHash(linklist_s * ll, const void * item, size_t hash,
+		int (*cmp)(const void * needle, const void * hay));
+
 /**
  * Apply a function for each item in a linklist.
  * 
@@ -232,9 +425,10 @@ void linklist_print(linklist_s * ll, void (*callback)(const void * item));
  * @param threshold The load threshold for enlarging the hash table.
  * @param moveR The move rate: when migrating to a new (bigger) hash table 
  *        size / moveR items are moved per add operation. Hence higher values
- *        move fewer items at a time.
+ *        move fewer items at a time. 0 leaves migrating to hashtab_migrateStep.
  * @param shrink Whether the table should shrink when the table load goes below
- *        1 - threshold.
+ *        1 - threshold (or threshold / 4, if that is lower). Shrinking is
+ *        incremental, like growing, and never goes below the initial size.
  * @return A new hash table.
  */
 hashtab_s * hashtab_make(size_t size, 
@@ -242,6 +436,224 @@ hashtab_s * hashtab_make(size_t size,
 		int (*cmp)(const void * a, const void * b), float threshold, 
 		size_t moveR, int shrink);
 
+/**
+ * Allocate and initialize a new flat hash table. Flat tables use open
+ * addressing: items are stored directly in an array of slots, next to an array
+ * of 1-byte control codes holding a part of each item's hash. Lookups compare
+ * these 8 at a time, so misses rarely call cmp and no links are allocated.
+ *
+ * The parameters are the same as for hashtab_make, except that the threshold
+ * can be at most 0.875 (higher values are clamped) and the size at least 8.
+ * All other hashtab functions work on flat tables as well. This is equivalent
+ * to hashtab_makeFlags with HASHTAB_FLAT.
+ *
+ * @param size The (initial) size.
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load threshold for enlarging the hash table.
+ * @param moveR The move rate.
+ * @param shrink Whether the table should shrink.
+ * @return A new flat hash table.
+ */
+hashtab_s * hashtab_makeFlat(size_t size, 
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink);
+
+/**
+ * Allocate and initialize a new hash table with flags. The other parameters
+ * are the same as for hashtab_make.
+ *
+ * HASHTAB_POW2 avoids the (relatively slow) division when selecting buckets,
+ * but then only the lower bits of hashes are used. So unless the hash function
+ * is known to spread well in its lower bits, combine it with HASHTAB_MIX. For
+ * example, identity hashes of ints that are multiples of 8 would only ever use
+ * one in 8 buckets.
+ *
+ * HASHTAB_ROBIN makes a flat table that probes one slot at a time instead of 8,
+ * but keeps all probes about equally long. It suits tables where the slowest
+ * lookups matter more than the average, or with many removals.
+ *
+ * HASHTAB_COMPACT saves the link (24 bytes on 64-bit machines) of every item
+ * that is alone in its bucket, which at the usual loads is most of them,
+ * and a dereference when finding it. But as their hashes aren't cached either,
+ * the hash function is called again for such items when the table is resized
+ * or they collide with a new item, and finding a different item in their
+ * bucket always calls the compare function.
+ *
+ * @param size The (initial) size.
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load threshold for enlarging the hash table.
+ * @param moveR The move rate.
+ * @param shrink Whether the table should shrink.
+ * @param flags Any combination of HASHTAB_FLAT, HASHTAB_ROBIN, HASHTAB_COMPACT,
+ *        HASHTAB_POW2 and HASHTAB_MIX.
+ * @return A new hash table.
+ */
+hashtab_s * hashtab_makeFlags(size_t size, 
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags);
+
+/**
+ * Allocate and initialize a new hash table with flags and a custom allocator.
+ * The other parameters are the same as for hashtab_makeFlags.
+ *
+ * Links are always taken from slabs (blocks of links) that belong to the
+ * table. Removed links are kept for re-use, and hashtab_free releases the
+ * slabs as a whole. The allocator is used for those slabs and all other
+ * memory of the table, its copies are made with the same allocator.
+ *
+ * @param size The (initial) size.
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load threshold for enlarging the hash table.
+ * @param moveR The move rate.
+ * @param shrink Whether the table should shrink.
+ * @param flags The flags, see hashtab_makeFlags.
+ * @param alloc The allocator, or NULL for malloc & free. It is copied.
+ * @return A new hash table.
+ */
+hashtab_s * hashtab_makeAlloc(size_t size, 
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags, const hashtab_alloc_s * alloc);
+
+/**
+ * Allocate and initialize a new seeded hash table: the hash function gets a
+ * seed along with the item, which is random for every table. Then what items
+ * collide can't be known outside of the process, and keys chosen to collide
+ * (say, keys of outside requests against a known hash function) don't slow
+ * down the table. The other parameters are the same as for hashtab_makeFlags.
+ *
+ * As a further defense, when an add leaves a bucket with more than maxChain
+ * items (of different hashes; or in flat tables puts an item more than
+ * maxChain groups of slots from where its probe starts) the table is
+ * reseeded, see hashtab_reseed. That is HASHTAB_MAX_CHAIN at first, set
+ * maxChain before adding items to change it. To keep floods of duplicates from
+ * reseeding it over and over, until the table has doubled in length it's not
+ * reseeded again.
+ *
+ * @param size The (initial) size.
+ * @param hasher The hash function. It is fed an item and the seed, and must
+ *        return the item's hash for that seed.
+ * @param cmp The compare function.
+ * @param threshold The load threshold for enlarging the hash table.
+ * @param moveR The move rate.
+ * @param shrink Whether the table should shrink.
+ * @param flags The flags, see hashtab_makeFlags.
+ * @return A new hash table.
+ */
+hashtab_s * hashtab_makeSeeded(size_t size, 
+		size_t (*hasher)(const void * item, size_t seed),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags);
+
+/**
+ * Build a hash table from an array of items in one pass. The table is sized to
+ * hold all items under the threshold (so it isn't grown on the way), and the
+ * links of a chained table are allocated as one block, ordered by bucket.
+ * When compiled with OpenMP the items are hashed in parallel, in that case the
+ * hasher must be thread-safe. Equal items are all added, as with hashtab_add.
+ *
+ * @param items The items.
+ * @param n The number of items.
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load threshold for enlarging the hash table.
+ * @param moveR The move rate.
+ * @param shrink Whether the table should shrink.
+ * @param flags The flags, see hashtab_makeFlags.
+ * @return A new hash table.
+ */
+hashtab_s * hashtab_fromArray(void * const * items, size_t n,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold, 
+		size_t moveR, int shrink, int flags);
+
+/**
+ * Resize the hash table (at once, without an other table) so it can hold n
+ * items without being grown. If it's migrating that is finished first. Tables
+ * that shrink won't shrink below the reserved size. Never shrinks the table.
+ *
+ * @param ht The hash table.
+ * @param n The number of items.
+ * @return The new size of the table.
+ */
+size_t hashtab_reserve(hashtab_s * ht, size_t n);
+
+/**
+ * Make the table the hash table grows into next, so the add that makes it
+ * grow only starts migrating, and doesn't have to allocate (and fault in the
+ * pages of) a table twice its size. Call it ahead of time, when the table
+ * nears its threshold, off the path that must be fast. Only for tables that
+ * resize incrementally (move rate > 1). The prepared table is used by the next
+ * resize if that is to its size, and dropped otherwise.
+ *
+ * @param ht The hash table.
+ * @return The size of the prepared table, or 0 if there's none: the table is
+ *         migrating, compiled or has a move rate of 1.
+ */
+size_t hashtab_prepareGrow(hashtab_s * ht);
+
+/**
+ * Migrate items of a resizing table to the table it's resizing to for a while,
+ * at least one small batch. For tables with a move rate of 0, whose adds and
+ * removes leave migrating to this function: call it when there's time, like
+ * from the idle hook of an event loop, so those stay fast while the table
+ * resizes. Only when the table it migrates to must grow as well before it's
+ * done, adds and removes move items again until it has caught up. Finds look
+ * in both tables while migrating, so finishing it soon speeds up misses.
+ *
+ * The table is not thread-safe: this may run on another thread only if it
+ * holds the same lock as all other operations on the table.
+ *
+ * @param ht The hash table.
+ * @param ns For how long to migrate, in nanoseconds.
+ * @return Non-zero if the table is still migrating afterwards.
+ */
+int hashtab_migrateStep(hashtab_s * ht, size_t ns);
+
+/**
+ * Give a seeded hash table a new random seed, and re-hash all its items with
+ * it (at once: a migration is finished first). Unseeded tables are left as
+ * they are.
+ *
+ * @param ht The hash table.
+ */
+void hashtab_reseed(hashtab_s * ht);
+
+/**
+ * Compile the hash table into a static one, for tables that no longer change:
+ * its items are placed by a minimal perfect hash function (built for exactly
+ * these items), in a flat table of (almost) as many slots as items. Then every
+ * find looks at a single slot: finding an item calls cmp exactly once, and
+ * missing one calls it at most once (only if its hash equals the one in the
+ * slot). If it's migrating that is finished first.
+ *
+ * Compiled tables can still be used as any other: inserting an item that is
+ * found replaces it in place, but adding or removing items (or reserving)
+ * turns the table back into a normal one (of the same kind as before) first.
+ *
+ * Compiling fails if items have equal hashes (the perfect hash function
+ * can only tell items apart by their hashes), then the table is unchanged.
+ *
+ * @param ht The hash table.
+ * @return 1 if the table was compiled, 0 if it failed.
+ */
+int hashtab_compile(hashtab_s * ht);
+
+/**
+ * Mixes the bits of a hash (with the 64- or 32-bit finalizer of MurmurHash3),
+ * so every bit of the input affects the lower bits of the output. This is what
+ * tables made with HASHTAB_MIX apply to every hash.
+ *
+ * @param hash The hash.
+ * @return The mixed hash.
+ */
+size_t hashtab_mix(size_t hash);
+
 /**
  * Add an item to the hash table. Note that this means the item is added even if
  * it already exists in the table. To replace-or-add use hashtab_insert.
@@ -271,6 +683,28 @@ void * hashtab_find(hashtab_s * ht, const void * item);
  */
 void * hashtab_insert(hashtab_s * ht, void * item);
 
+/**
+ * Find an item in the hash table, or add one if it isn't there. The table is
+ * searched only once: if the item isn't found it is made by the make-callback
+ * and placed right where the search ended. This suits counters and caches,
+ * where items are looked up far more often than they're added.
+ *
+ * The callback is given the key and ctx and must return the item to add,
+ * which must be equal to key (by the hasher and cmp of the table). It is only
+ * called when the key isn't in the table, and must not change the table.
+ *
+ * @param ht The hash table.
+ * @param key The item to find, it is not added itself.
+ * @param make The callback to make the item with.
+ * @param ctx A context pointer for the callback.
+ * @param [out] inserted Set to 1 if the item was made and added, otherwise to
+ *        0. May be NULL.
+ * @return The item in the table: the existing one or the one made.
+ */
+void * hashtab_findOrInsert(hashtab_s * ht, const void * key,
+		void * (*make)(const void * key, void * ctx), void * ctx,
+		int * inserted);
+
 /**
  * Apply a function to each item in the hash table.
  *
@@ -282,6 +716,60 @@ void * hashtab_insert(hashtab_s * ht, void * item);
 void hashtab_forEach(hashtab_s * ht, 
 		void (*callback)(void * item, void * ctx), void * ctx);
 
+/**
+ * Start iterating over the items in the hash table. The table must not be
+ * changed until the iteration is done, see hashtab_scan for that.
+ *
+ * @code
+ * hashtab_iter_s it;
+ * void * item;
+ * 
+ * for(hashtab_iterInit(&it, ht); (item = hashtab_iterNext(&it)); ){
+ *     ...
+ * }
+ * @endcode
+ *
+ * @param it The iterator.
+ * @param ht The hash table.
+ */
+void hashtab_iterInit(hashtab_iter_s * it, hashtab_s * ht);
+
+/**
+ * Get the next item of an iterator.
+ *
+ * @param it The iterator.
+ * @return The next item, or NULL if all have been returned.
+ */
+void * hashtab_iterNext(hashtab_iter_s * it);
+
+/**
+ * Scan a part of the hash table: apply a function to the items in the next
+ * few buckets (or slots) after a cursor, and return the cursor to continue
+ * with. Start with cursor 0, the scan is done when 0 is returned.
+ *
+ * The table may be changed between calls. Items in the table for the whole
+ * scan are visited at least once, even if the table grows, shrinks or
+ * migrates in the meantime, but may be visited more than once. Items added or
+ * removed during the scan may or may not be visited. The callback itself must
+ * not change the table.
+ *
+ * The cursor is only kept valid over resizes in tables with HASHTAB_POW2.
+ * In other tables (and compiled tables) it's a position in the table: items
+ * can be missed or visited twice if the table is resized during the scan (or
+ * compiled or decompiled).
+ *
+ * @param ht The hash table.
+ * @param cursor The cursor, 0 to start.
+ * @param n The number of items to visit (at least), the scan stops after the
+ *        bucket where this is reached.
+ * @param callback The function. The first argument is the item, the second is
+ *        ctx.
+ * @param ctx A context also supplied to the callback.
+ * @return The cursor for the next call, or 0 if the scan is done.
+ */
+size_t hashtab_scan(hashtab_s * ht, size_t cursor, size_t n,
+		void (*callback)(void * item, void * ctx), void * ctx);
+
 /**
  * Remove an item from the hash table.
  *
@@ -291,10 +779,109 @@ void hashtab_forEach(hashtab_s * ht,
  */
 void * hashtab_remove(hashtab_s * ht, const void * item);
 
+/**
+ * Find a batch of items in the hash table. All items in a batch are hashed and
+ * their buckets are prefetched before any of them are looked up, so the memory
+ * accesses of different lookups overlap instead of stalling one by one.
+ *
+ * @param ht The hash table.
+ * @param items The items to find.
+ * @param [out] out For every item: the found item, or NULL if it's not in the
+ *        table.
+ * @param n The number of items.
+ * @return The number of items found.
+ */
+size_t hashtab_findMany(hashtab_s * ht, const void * const * items,
+		void ** out, size_t n);
+
+/**
+ * Add a batch of items to the hash table, see hashtab_findMany and
+ * hashtab_add.
+ *
+ * @param ht The hash table.
+ * @param items The items to add.
+ * @param n The number of items.
+ * @return The new length of the table.
+ */
+size_t hashtab_addMany(hashtab_s * ht, void * const * items, size_t n);
+
+/**
+ * Remove a batch of items from the hash table, see hashtab_findMany and
+ * hashtab_remove.
+ *
+ * @param ht The hash table.
+ * @param items The items to remove.
+ * @param [out] out For every item: the removed item, or NULL if it wasn't in
+ *        the table. May be NULL if the removed items aren't needed.
+ * @param n The number of items.
+ * @return The number of items removed.
+ */
+size_t hashtab_removeMany(hashtab_s * ht, const void * const * items,
+		void ** out, size_t n);
+
+/**
+ * Move all items of one hash table into another, leaving the first one empty
+ * (but otherwise as it was). The destination is resized once, for both
+ * tables' items. If both hash items the same (the same hasher, seed and
+ * HASHTAB_MIX) the cached hashes are used, and if both are chained and use the
+ * same allocator the links of src are moved over as well, rather than
+ * allocating new ones (except while snapshots of src are left). For sharded
+ * tables, whose partial results are combined into one.
+ *
+ * Only the items are moved, not what the ctx of src points to. Tables whose
+ * items live in memory of their ctx must not be merged with it: stringmaps
+ * keep their arena there, merge them with stringmap_merge instead.
+ *
+ * @param dst The hash table to move the items to.
+ * @param src The hash table to take them from: another table than dst, and not
+ *        a snapshot.
+ * @param combine If not NULL, for every item of src that is equal to an item
+ *        already in dst: called as combine(dstItem, srcItem, ctx), and the item
+ *        of src is not added (so the callback may fold it into the item of dst
+ *        and free it). If NULL all items are added, like hashtab_add.
+ * @param ctx A context pointer for the callback.
+ * @return The number of items added to dst.
+ */
+size_t hashtab_merge(hashtab_s * dst, hashtab_s * src,
+		void (*combine)(void * item, void * other, void * ctx), void * ctx);
+
+/**
+ * Remove the items of the hash table that are not in another table (equal to
+ * one of its items, by the cmp of either). Whichever table holds fewer items
+ * is walked, and its items are looked up in the other, using the cached
+ * hashes if both hash items the same. Removing doesn't shrink the table (until
+ * a later hashtab_remove).
+ *
+ * @param ht The hash table.
+ * @param other The other table, which is not changed.
+ * @param cb A callback for the removed items, or NULL.
+ * @param ctx A context pointer for the callback.
+ * @return The number of items removed.
+ */
+size_t hashtab_intersect(hashtab_s * ht, hashtab_s * other,
+		void (*cb)(void * item, void * ctx), void * ctx);
+
+/**
+ * Remove the items of the hash table that are in another table, see
+ * hashtab_intersect.
+ *
+ * @param ht The hash table.
+ * @param other The other table, which is not changed.
+ * @param cb A callback for the removed items, or NULL.
+ * @param ctx A context pointer for the callback.
+ * @return The number of items removed.
+ */
+size_t hashtab_difference(hashtab_s * ht, hashtab_s * other,
+		void (*cb)(void * item, void * ctx), void * ctx);
+
 /**
  * Returns a copy of the hash table. The cpy-callback is called for every item
  * to make a copy of it. If cpy is NULL the item-pointers are copied shallowly.
  *
+ * The ctx of the table is copied as is, so tables whose ctx owns memory must
+ * fix it up in the copy. Stringmaps keep their arena there: copy them with
+ * stringmap_copy instead.
+ *
  * @param src The original hash table.
  * @param cpy The callback to make copies of the items.
  * @param ctx A context pointer for the callback.
@@ -304,7 +891,32 @@ hashtab_s * hashtab_copy(const hashtab_s * src, void * (*cpy)(const void
 		* item, void * ctx), void * ctx);
 
 /**
- * Free the hash table.
+ * Returns a snapshot of the hash table: a read-only view of its items as they
+ * are now, that the table (the writer) can go on changing. Only the buckets
+ * are copied, not the links of chained tables: those are shared until the
+ * writer changes a bucket, then it copies the links of only that bucket. So
+ * taking a snapshot costs a pointer per bucket, rather than a link per item.
+ * Flat tables have no links, their slots are copied like by hashtab_copy.
+ *
+ * A snapshot can only be searched and iterated over (finds, forEach, iterators,
+ * scans, stats and copies), not changed, and must be freed with hashtab_free
+ * (with a NULL callback, unless the items are no longer in the table). That
+ * may happen on another thread than the writer's, as long as the allocator of
+ * the table is thread-safe and the compiler has GNU builtins or C11 atomics.
+ * A single snapshot is not thread-safe by itself (and built with
+ * HASHTAB_COUNTERS, its finds count along with the table's).
+ *
+ * Memory of links is shared by the table and all its snapshots: the links the
+ * writer replaced are only re-used once no snapshots are left, and all of them
+ * are released when the last of the table and its snapshots is freed.
+ *
+ * @param ht The hash table.
+ * @return The snapshot.
+ */
+hashtab_s * hashtab_snapshot(hashtab_s * ht);
+
+/**
+ * Free the hash table, or a snapshot of one.
  *
  * @param ht The hash table.
  * @param cb A callback to free the items left in the hash table. May be NULL,
@@ -314,6 +926,72 @@ hashtab_s * hashtab_copy(const hashtab_s * src, void * (*cpy)(const void
 void hashtab_free(hashtab_s * ht, void (*cb)(void * item, void * ctx),
 		void * ctx);
 
+/**
+ * Apply a function to each item in the hash table, on several threads. The
+ * buckets of the table (and of the table it is migrating from) are divided
+ * among the threads in ranges, which they take as they go. This needs OpenMP
+ * (-fopenmp), without it the items are walked on the calling thread only.
+ *
+ * Every thread passes its own context to the callback: ctxs[t] on thread t,
+ * so results can be collected without locks or atomics. Afterwards reduce is
+ * called on the calling thread for every other context, as reduce(ctxs[0],
+ * ctxs[t]) for t = 1 .. nthreads - 1, to combine them into ctxs[0]. It is also
+ * called for threads that had no items (or weren't started at all), so all
+ * contexts must start out as the identity of reduce.
+ *
+ * The table must not be changed while this runs, and the callback must not
+ * change it either.
+ *
+ * @param ht The hash table.
+ * @param nthreads The number of threads (at most).
+ * @param callback The function. The first argument is the item, the second
+ *        is the context of the thread.
+ * @param ctxs The contexts, nthreads of them. May be NULL, then the callback
+ *        gets NULL.
+ * @param reduce The function to combine contexts with, may be NULL.
+ */
+void hashtab_forEachParallel(hashtab_s * ht, int nthreads,
+		void (*callback)(void * item, void * ctx), void * const * ctxs,
+		void (*reduce)(void * ctx, void * other));
+
+/**
+ * Returns a copy of the hash table, made on several threads. See
+ * hashtab_forEachParallel for the threads and contexts, and hashtab_copy for
+ * the cpy-callback (which must be thread-safe, unless it's NULL).
+ *
+ * @param src The original hash table.
+ * @param nthreads The number of threads (at most).
+ * @param cpy The callback to make copies of the items.
+ * @param ctxs The contexts for the callback, nthreads of them, or NULL.
+ * @return A copy of the hash table.
+ */
+hashtab_s * hashtab_copyParallel(const hashtab_s * src, int nthreads,
+		void * (*cpy)(const void * item, void * ctx), void * const * ctxs);
+
+/**
+ * Free the hash table, calling cb for its items on several threads. See
+ * hashtab_forEachParallel for the threads and contexts.
+ *
+ * @param ht The hash table.
+ * @param nthreads The number of threads (at most).
+ * @param cb A callback to free the items left in the hash table. May be NULL,
+ *        if the items need no freeing.
+ * @param ctxs The contexts for the callback, nthreads of them, or NULL.
+ */
+void hashtab_freeParallel(hashtab_s * ht, int nthreads,
+		void (*cb)(void * item, void * ctx), void * const * ctxs);
+
+/**
+ * Collects statistics about the hash table: how long its chains are, how much
+ * memory it uses and so on. This takes time linear in the size of the table.
+ * A table that is degenerate (by a poor hash function) has high probe lengths
+ * and a high empty ratio at a moderate load.
+ *
+ * @param ht The hash table.
+ * @param stats Receives the statistics.
+ */
+void hashtab_stats(const hashtab_s * ht, hashtab_stats_s * stats);
+
 /**
  * (Debug function, replacable by forEach)
  * 
@@ -336,4 +1014,13 @@ void hashtab_print(hashtab_s * ht, void (*callback)(const void * item));
 
 void printMemStats();
 
+/**
+ * Gets the number of (re-)allocations made by all hash tables so far, as
+ * printed by printMemStats.
+ *
+ * @param nMallocs Receives the number of allocations.
+ * @param nReallocs Receives the number of re-allocations.
+ */
+void getMemStats(size_t * nMallocs, size_t * nReallocs);
+
 #endif
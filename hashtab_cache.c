@@ -0,0 +1,333 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_cache.c
+ *
+ * The cache. Its items are in a hash table, and on a doubly linked list from
+ * the least to the most recently used through the nodes they embed. Using an
+ * item moves it to the most recent end, and eviction takes the least recent
+ * end: both without looking anything up in the table. Removing an item from
+ * the table is a lookup of its own, but with unique items that finds the item
+ * itself. A hand walks the list from the least recent end to evict expired
+ * items a few at a time, as items that are used are checked when they are.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hashtab.h"
+#include "hashtab_cache.h"
+
+struct hashtab_cache{
+	/** The table with the items. */
+	hashtab_s * ht;
+	/** The offset of the node in the items. */
+	size_t offset;
+	/** The nodes of the most and least recently used items. */
+	hashtab_cache_node_s * newest, * oldest;
+	/** The node the next sweep starts at, or NULL for the oldest. */
+	hashtab_cache_node_s * hand;
+	/** The limits, 0 if there is none. */
+	size_t maxItems, maxBytes;
+	/** The number of bytes of the items. */
+	size_t bytes;
+	/** The eviction callback and its context. */
+	void (*evict)(void * item, void * ctx);
+	void * ctx;
+};
+
+static void * safeMalloc(size_t n){
+	void * p = malloc(n);
+	if(!p){
+		fprintf(stderr, "malloc(%lu) failed\n", (unsigned long) n);
+		exit(1);
+	}
+	
+	return p;
+}
+
+/**
+ * @private
+ *
+ * A monotonic clock. Without POSIX clocks it's the processor time instead.
+ *
+ * @return The time in nanoseconds.
+ */
+static uint64_t hashtab_cacheNow(void){
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#else
+	return (uint64_t)((double) clock() * 1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * @private
+ *
+ * The node of an item.
+ *
+ * @param c The cache.
+ * @param item The item.
+ * @return Its node.
+ */
+static hashtab_cache_node_s * hashtab_cacheNode(const hashtab_cache_s * c,
+		void * item){
+	return (hashtab_cache_node_s *)((unsigned char *) item + c->offset);
+}
+
+/**
+ * @private
+ *
+ * The item of a node.
+ *
+ * @param c The cache.
+ * @param node The node.
+ * @return Its item.
+ */
+static void * hashtab_cacheItem(const hashtab_cache_s * c,
+		hashtab_cache_node_s * node){
+	return (unsigned char *) node - c->offset;
+}
+
+/**
+ * @private
+ *
+ * Takes a node off the list. The hand moves on to the next more recent node
+ * if it was on it.
+ *
+ * @param c The cache.
+ * @param node The node.
+ */
+static void hashtab_cacheUnlink(hashtab_cache_s * c,
+		hashtab_cache_node_s * node){
+	if(c->hand == node){
+		c->hand = node->newer;
+	}
+	
+	if(node->newer){
+		node->newer->older = node->older;
+	}else{
+		c->newest = node->older;
+	}
+	if(node->older){
+		node->older->newer = node->newer;
+	}else{
+		c->oldest = node->newer;
+	}
+	c->bytes -= node->bytes;
+}
+
+/**
+ * @private
+ *
+ * Puts a node on the list as the most recently used.
+ *
+ * @param c The cache.
+ * @param node The node.
+ */
+static void hashtab_cacheLink(hashtab_cache_s * c,
+		hashtab_cache_node_s * node){
+	node->newer = NULL;
+	node->older = c->newest;
+	if(c->newest){
+		c->newest->newer = node;
+	}else{
+		c->oldest = node;
+	}
+	c->newest = node;
+	c->bytes += node->bytes;
+}
+
+/**
+ * @private
+ *
+ * Removes the item of a node from the cache, and passes it to the eviction
+ * callback.
+ *
+ * @param c The cache.
+ * @param node The node.
+ */
+static void hashtab_cacheEvict(hashtab_cache_s * c,
+		hashtab_cache_node_s * node){
+	void * item = hashtab_cacheItem(c, node);
+	
+	hashtab_cacheUnlink(c, node);
+	hashtab_remove(c->ht, item);
+	
+	if(c->evict){
+		c->evict(item, c->ctx);
+	}
+}
+
+/**
+ * @private
+ *
+ * Whether a node has expired.
+ *
+ * @param node The node.
+ * @param now The time.
+ * @return 1 if it has, 0 if not.
+ */
+static int hashtab_cacheExpired(const hashtab_cache_node_s * node,
+		uint64_t now){
+	return node->expires && now >= node->expires;
+}
+
+/**
+ * @private
+ *
+ * Evicts the expired items among the next n from the hand, which wraps around
+ * to the oldest at the end of the list.
+ *
+ * @param c The cache.
+ * @param n The number of items to look at.
+ * @param now The time.
+ * @return The number of items evicted.
+ */
+static size_t hashtab_cacheSweep(hashtab_cache_s * c, size_t n, uint64_t now){
+	hashtab_cache_node_s * node;
+	size_t evicted = 0;
+	
+	for(; n && c->oldest; --n){
+		node = c->hand ? c->hand : c->oldest;
+		c->hand = node->newer;
+		
+		if(hashtab_cacheExpired(node, now)){
+			hashtab_cacheEvict(c, node);
+			++evicted;
+		}
+	}
+	
+	return evicted;
+}
+
+hashtab_cache_s * hashtab_cacheMake(size_t size,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold,
+		size_t moveR, int flags, size_t offset, size_t maxItems,
+		size_t maxBytes, void (*evict)(void * item, void * ctx), void * ctx){
+	hashtab_cache_s * c = safeMalloc(sizeof *c);
+	
+	c->ht = hashtab_makeFlags(size, hasher, cmp, threshold, moveR, 0, flags);
+	c->offset = offset;
+	c->newest = c->oldest = c->hand = NULL;
+	c->maxItems = maxItems;
+	c->maxBytes = maxBytes;
+	c->bytes = 0;
+	c->evict = evict;
+	c->ctx = ctx;
+	
+	return c;
+}
+
+void * hashtab_cachePut(hashtab_cache_s * c, void * item, size_t bytes,
+		uint64_t ttl){
+	hashtab_cache_node_s * node = hashtab_cacheNode(c, item);
+	uint64_t now = hashtab_cacheNow();
+	void * old = hashtab_insert(c->ht, item);
+	
+	if(old){
+		hashtab_cacheUnlink(c, hashtab_cacheNode(c, old));
+	}
+	
+	node->expires = ttl ? now + ttl : 0;
+	node->bytes = bytes;
+	hashtab_cacheLink(c, node);
+	
+	while(c->oldest != node &&
+			((c->maxItems && hashtab_length(c->ht) > c->maxItems) ||
+			(c->maxBytes && c->bytes > c->maxBytes))){
+		hashtab_cacheEvict(c, c->oldest);
+	}
+	
+	hashtab_cacheSweep(c, HASHTAB_CACHE_SWEEP, now);
+	
+	/* Putting an item that's in the cache already only refreshes it. */
+	return old == item ? NULL : old;
+}
+
+void * hashtab_cacheGet(hashtab_cache_s * c, const void * item){
+	void * found = hashtab_find(c->ht, item);
+	hashtab_cache_node_s * node;
+	
+	if(!found){
+		return NULL;
+	}
+	
+	node = hashtab_cacheNode(c, found);
+	if(node->expires && hashtab_cacheExpired(node, hashtab_cacheNow())){
+		hashtab_cacheEvict(c, node);
+		return NULL;
+	}
+	
+	if(node != c->newest){
+		hashtab_cacheUnlink(c, node);
+		hashtab_cacheLink(c, node);
+	}
+	
+	return found;
+}
+
+void * hashtab_cacheRemove(hashtab_cache_s * c, const void * item){
+	void * removed = hashtab_remove(c->ht, item);
+	
+	if(removed){
+		hashtab_cacheUnlink(c, hashtab_cacheNode(c, removed));
+	}
+	
+	return removed;
+}
+
+size_t hashtab_cacheExpire(hashtab_cache_s * c, size_t n){
+	return hashtab_cacheSweep(c, n, hashtab_cacheNow());
+}
+
+size_t hashtab_cacheLength(hashtab_cache_s * c){
+	return hashtab_length(c->ht);
+}
+
+size_t hashtab_cacheBytes(const hashtab_cache_s * c){
+	return c->bytes;
+}
+
+hashtab_s * hashtab_cacheTable(hashtab_cache_s * c){
+	return c->ht;
+}
+
+void hashtab_cacheFree(hashtab_cache_s * c,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	hashtab_free(c->ht, cb, ctx);
+	free(c);
+}
@@ -0,0 +1,184 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_cache.h
+ *
+ * A cache on top of a hash table: items are evicted least recently used
+ * first when there are too many (or they take too many bytes), and expire
+ * after a time to live of their own. The recency list runs through the items
+ * themselves, which embed a node for it, so the cache allocates nothing per
+ * item beyond what the table does. See README.md for more general comments.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#ifndef HASHTAB_CACHE_H
+#define HASHTAB_CACHE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hashtab.h"
+
+/** The number of items hashtab_cachePut looks at for expired ones. */
+#define HASHTAB_CACHE_SWEEP 4
+
+/**
+ * The node every item of a cache embeds, anywhere in the item (see
+ * hashtab_cacheMake). Its members are private.
+ */
+typedef struct hashtab_cache_node{
+	/** @private The next more and less recently used items' nodes. */
+	struct hashtab_cache_node * newer, * older;
+	/** @private When the item expires (see hashtab_cachePut), or 0. */
+	uint64_t expires;
+	/** @private The number of bytes the item counts for. */
+	size_t bytes;
+} hashtab_cache_node_s;
+
+/** A cache. Its members are private: use the functions. */
+typedef struct hashtab_cache hashtab_cache_s;
+
+/**
+ * Allocate and initialize a cache, with a hash table made by
+ * hashtab_makeFlags (that doesn't shrink).
+ *
+ * @code
+ * typedef struct{
+ *     hashtab_cache_node_s node;
+ *     char key[32];
+ *     ...
+ * } entry_s;
+ *
+ * hashtab_cache_s * c = hashtab_cacheMake(1024, entryHash, entryCmp, 0.75, 4,
+ *         0, offsetof(entry_s, node), 10000, 0, entryEvict, NULL);
+ * @endcode
+ *
+ * @param size The initial size of the table.
+ * @param hasher The hash function of the items.
+ * @param cmp The compare function of the items.
+ * @param threshold The load factor at which the table is grown.
+ * @param moveR The move rate of the table.
+ * @param flags The flags of the table.
+ * @param offset The offset of the hashtab_cache_node_s in the items.
+ * @param maxItems The most items the cache holds, or 0 for no limit.
+ * @param maxBytes The most bytes the items (see hashtab_cachePut) of the cache
+ *        take together, or 0 for no limit.
+ * @param evict A callback for the items that are evicted or expire, or NULL.
+ *        The cache no longer holds them, so it may free them.
+ * @param ctx A context pointer for the callback.
+ * @return The cache.
+ */
+hashtab_cache_s * hashtab_cacheMake(size_t size,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold,
+		size_t moveR, int flags, size_t offset, size_t maxItems,
+		size_t maxBytes, void (*evict)(void * item, void * ctx), void * ctx);
+
+/**
+ * Put an item in the cache, replacing an equal item (like hashtab_insert), as
+ * the most recently used. Then the least recently used items are evicted
+ * while there are too many, or they take too many bytes (but never the item
+ * just put). And a few items (HASHTAB_CACHE_SWEEP) are looked at for ones that
+ * expired, taking turns with those that aren't used.
+ *
+ * @param c The cache.
+ * @param item The item.
+ * @param bytes The number of bytes the item counts for (towards maxBytes).
+ * @param ttl The number of nanoseconds after which the item expires, or 0 if
+ *        it never does.
+ * @return The item that was replaced (not passed to the evict callback), or
+ *         NULL if there was none.
+ */
+void * hashtab_cachePut(hashtab_cache_s * c, void * item, size_t bytes,
+		uint64_t ttl);
+
+/**
+ * Find an item in the cache, and make it the most recently used. An item
+ * that has expired is evicted instead (and NULL is returned).
+ *
+ * @param c The cache.
+ * @param item The item to find.
+ * @return The item in the cache, or NULL if it's not in it.
+ */
+void * hashtab_cacheGet(hashtab_cache_s * c, const void * item);
+
+/**
+ * Remove an item from the cache. It is not passed to the evict callback.
+ *
+ * @param c The cache.
+ * @param item The item to remove.
+ * @return The removed item, or NULL if it's not in the cache.
+ */
+void * hashtab_cacheRemove(hashtab_cache_s * c, const void * item);
+
+/**
+ * Evict the expired items among the next n that aren't used, see
+ * hashtab_cachePut. Call this from time to time (like hashtab_migrateStep) if
+ * the cache isn't put to often, or items expire while nobody asks for them.
+ *
+ * @param c The cache.
+ * @param n The number of items to look at.
+ * @return The number of items evicted.
+ */
+size_t hashtab_cacheExpire(hashtab_cache_s * c, size_t n);
+
+/**
+ * The number of items in the cache.
+ *
+ * @param c The cache.
+ * @return The number of items.
+ */
+size_t hashtab_cacheLength(hashtab_cache_s * c);
+
+/**
+ * The number of bytes the items of the cache take together.
+ *
+ * @param c The cache.
+ * @return The number of bytes.
+ */
+size_t hashtab_cacheBytes(const hashtab_cache_s * c);
+
+/**
+ * The hash table of the cache, for the functions of hashtab.h that don't
+ * change it (like find, forEach and stats). Items must only be added or
+ * removed through the cache.
+ *
+ * @param c The cache.
+ * @return The hash table.
+ */
+hashtab_s * hashtab_cacheTable(hashtab_cache_s * c);
+
+/**
+ * Free the cache and its table.
+ *
+ * @param c The cache.
+ * @param cb A callback to free the items left in the cache, or NULL.
+ * @param ctx A context pointer for the callback.
+ */
+void hashtab_cacheFree(hashtab_cache_s * c,
+		void (*cb)(void * item, void * ctx), void * ctx);
+
+#endif /* HASHTAB_CACHE_H */
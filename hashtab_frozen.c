@@ -0,0 +1,452 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_frozen.c
+ *
+ * Frozen hash tables. The file holds a header followed by three arrays:
+ *
+ *  - buckets: for every bucket (a power of two of them) the index of its first
+ *    entry, and one more holding the number of entries, so the entries of
+ *    bucket b are those from buckets[b] up to buckets[b + 1].
+ *  - entries: the hash of every entry and where its bytes start in the blob,
+ *    and one more entry holding the size of the blob. The hash and offset are
+ *    next to each other, so a lookup touches only one line of entries.
+ *  - blob: the bytes of all entries.
+ *
+ * An item is looked up in the bucket selected by its (mixed) hash, and only
+ * compared with the entries whose hashes are equal. Everything is stored as
+ * offsets, so the file can be mapped anywhere.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hashtab.h"
+#include "hashtab_frozen.h"
+
+/** @private The first bytes of every frozen table. */
+#define HASHTAB_FROZEN_MAGIC "HTFROZEN"
+/** @private The version of the format. */
+#define HASHTAB_FROZEN_VERSION 1
+/** @private Reads differently on machines of another byte-order. */
+#define HASHTAB_FROZEN_ORDER 0x01020304u
+/** @private The size of the write buffer. */
+#define HASHTAB_FROZEN_BUFFER 65536
+
+/** @private The header of a frozen table. */
+typedef struct hashtab_frozenHead{
+	/** HASHTAB_FROZEN_MAGIC. */
+	char magic[8];
+	/** HASHTAB_FROZEN_VERSION. */
+	uint32_t version;
+	/** HASHTAB_FROZEN_ORDER. */
+	uint32_t order;
+	/** The size of size_t (and so of the hashes) of the writer. */
+	uint32_t sizeT;
+	/** Padding, 0. */
+	uint32_t reserved;
+	/** The number of entries. */
+	uint64_t length;
+	/** The number of buckets, a power of two. */
+	uint64_t buckets;
+	/** The size of the blob. */
+	uint64_t blob;
+} hashtab_frozenHead_s;
+
+/** @private An entry of a frozen table. */
+typedef struct hashtab_frozenEntry{
+	/** The hash of the item. */
+	uint64_t hash;
+	/** Where the bytes of the item start in the blob. */
+	uint64_t offset;
+} hashtab_frozenEntry_s;
+
+struct hashtab_frozen{
+	/** The mapped file. */
+	void * map;
+	/** The size of the mapped file. */
+	size_t mapSize;
+	/** The hash function for items. */
+	size_t (*hasher)(const void * item);
+	/** The compare function for items and stored bytes. */
+	int (*cmp)(const void * item, const void * data, size_t len);
+	/** The number of entries. */
+	size_t length;
+	/** The number of buckets - 1. */
+	size_t mask;
+	/** The size of the blob. */
+	size_t blobSize;
+	/** The arrays in the mapped file. */
+	const uint64_t * buckets;
+	const hashtab_frozenEntry_s * entries;
+	const unsigned char * blob;
+};
+
+/** @private Buffers writes to a file. */
+typedef struct hashtab_writer{
+	int fd;
+	size_t used;
+	unsigned char buf[HASHTAB_FROZEN_BUFFER];
+} hashtab_writer_s;
+
+static void * safeMalloc(size_t n){
+	void * p = malloc(n ? n : 1);
+	if(!p){
+		fprintf(stderr, "malloc(%lu) failed\n", (unsigned long) n);
+		exit(1);
+	}
+	
+	return p;
+}
+
+/**
+ * @private
+ *
+ * Writes n bytes to a file, retrying after partial writes and interrupts.
+ *
+ * @param fd The file.
+ * @param p The bytes.
+ * @param n The number of bytes.
+ * @return 0 on success, -1 on failure.
+ */
+static int hashtab_writeAll(int fd, const void * p, size_t n){
+	const unsigned char * b = p;
+	ssize_t w;
+	
+	while(n){
+		w = write(fd, b, n);
+		if(w < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		
+		b += w;
+		n -= w;
+	}
+	
+	return 0;
+}
+
+/**
+ * @private
+ *
+ * Writes the buffered bytes.
+ *
+ * @param w The writer.
+ * @return 0 on success, -1 on failure.
+ */
+static int hashtab_writerFlush(hashtab_writer_s * w){
+	size_t n = w->used;
+	
+	w->used = 0;
+	
+	return hashtab_writeAll(w->fd, w->buf, n);
+}
+
+/**
+ * @private
+ *
+ * Buffers n bytes for writing, large blocks are written directly.
+ *
+ * @param w The writer.
+ * @param p The bytes.
+ * @param n The number of bytes.
+ * @return 0 on success, -1 on failure.
+ */
+static int hashtab_writerPut(hashtab_writer_s * w, const void * p, size_t n){
+	if(w->used + n > sizeof w->buf){
+		if(hashtab_writerFlush(w)){
+			return -1;
+		}
+		if(n > sizeof w->buf){
+			return hashtab_writeAll(w->fd, p, n);
+		}
+	}
+	
+	memcpy(w->buf + w->used, p, n);
+	w->used += n;
+	
+	return 0;
+}
+
+/** @private Collects the items of a table for hashtab_freeze. */
+typedef struct hashtab_collect{
+	void ** items;
+	size_t n;
+} hashtab_collect_s;
+
+static void hashtab_collect(void * item, void * ctx){
+	hashtab_collect_s * c = ctx;
+	
+	c->items[c->n++] = item;
+}
+
+/**
+ * @private
+ *
+ * Serializes an item into a buffer, growing the buffer if it's too small.
+ *
+ * @return The number of bytes of the item.
+ */
+static size_t hashtab_serialize(const void * item, unsigned char ** buf,
+		size_t * cap, size_t (*serialize)(const void * item, void * buf,
+		size_t n, void * ctx), void * ctx){
+	size_t n = serialize(item, *buf, *cap, ctx);
+	
+	if(n > *cap){
+		free(*buf);
+		*cap = n * 2;
+		*buf = safeMalloc(*cap);
+		n = serialize(item, *buf, *cap, ctx);
+	}
+	
+	return n;
+}
+
+/**
+ * @private
+ *
+ * Selects the bucket of a hash.
+ */
+static size_t hashtab_frozenBucket(uint64_t hash, size_t mask){
+	return hashtab_mix((size_t) hash) & mask;
+}
+
+int hashtab_freeze(hashtab_s * ht, int fd, size_t (*serialize)(
+		const void * item, void * buf, size_t n, void * ctx), void * ctx){
+	hashtab_frozenHead_s head;
+	hashtab_collect_s c;
+	hashtab_writer_s * w = safeMalloc(sizeof *w);
+	size_t n = hashtab_length(ht), nb = 1, i, b, cap = 256;
+	uint64_t * buckets, * hashes;
+	hashtab_frozenEntry_s * entries;
+	size_t * order;
+	unsigned char * buf;
+	int ret = -1;
+	
+	/* The random seed of a seeded table can't be had when opening the file. */
+	if(!ht->hasher){
+		free(w);
+		errno = EINVAL;
+		return -1;
+	}
+	
+	buf = safeMalloc(cap);
+	while(nb < n){
+		nb *= 2;
+	}
+	
+	c.items = safeMalloc(n * sizeof *c.items);
+	c.n = 0;
+	hashtab_forEach(ht, hashtab_collect, &c);
+	
+	buckets = safeMalloc((nb + 1) * sizeof *buckets);
+	hashes = safeMalloc(n * sizeof *hashes);
+	entries = safeMalloc((n + 1) * sizeof *entries);
+	order = safeMalloc(n * sizeof *order);
+	
+	/* Sort the items by bucket, counting the items per bucket first. */
+	memset(buckets, 0, (nb + 1) * sizeof *buckets);
+	for(i = 0; i < n; i++){
+		hashes[i] = ht->hasher(c.items[i]);
+		++buckets[hashtab_frozenBucket(hashes[i], nb - 1) + 1];
+	}
+	for(b = 0; b < nb; b++){
+		buckets[b + 1] += buckets[b];
+	}
+	for(i = 0; i < n; i++){
+		b = hashtab_frozenBucket(hashes[i], nb - 1);
+		order[buckets[b]++] = i;
+	}
+	/* Every bucket now starts where the next one did. */
+	for(b = nb; b > 0; b--){
+		buckets[b] = buckets[b - 1];
+	}
+	buckets[0] = 0;
+	
+	entries[0].offset = 0;
+	for(i = 0; i < n; i++){
+		entries[i].hash = hashes[order[i]];
+		entries[i + 1].offset = entries[i].offset + hashtab_serialize(
+				c.items[order[i]], &buf, &cap, serialize, ctx);
+	}
+	entries[n].hash = 0;
+	
+	memset(&head, 0, sizeof head);
+	memcpy(head.magic, HASHTAB_FROZEN_MAGIC, sizeof head.magic);
+	head.version = HASHTAB_FROZEN_VERSION;
+	head.order = HASHTAB_FROZEN_ORDER;
+	head.sizeT = sizeof(size_t);
+	head.length = n;
+	head.buckets = nb;
+	head.blob = entries[n].offset;
+	
+	w->fd = fd;
+	w->used = 0;
+	if(hashtab_writerPut(w, &head, sizeof head) ||
+			hashtab_writerPut(w, buckets, (nb + 1) * sizeof *buckets)){
+		goto done;
+	}
+	if(hashtab_writerPut(w, entries, (n + 1) * sizeof *entries)){
+		goto done;
+	}
+	for(i = 0; i < n; i++){
+		size_t len = hashtab_serialize(c.items[order[i]], &buf, &cap,
+				serialize, ctx);
+		if(hashtab_writerPut(w, buf, len)){
+			goto done;
+		}
+	}
+	ret = hashtab_writerFlush(w);
+
+done:
+	free(order);
+	free(entries);
+	free(hashes);
+	free(buckets);
+	free(c.items);
+	free(buf);
+	free(w);
+	
+	return ret;
+}
+
+hashtab_frozen_s * hashtab_openMmap(const char * path,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * item, const void * data, size_t len)){
+	hashtab_frozen_s * ft;
+	hashtab_frozenHead_s head;
+	struct stat st;
+	uint64_t words;
+	void * map;
+	int fd = open(path, O_RDONLY);
+	
+	if(fd < 0){
+		return NULL;
+	}
+	if(fstat(fd, &st)){
+		close(fd);
+		return NULL;
+	}
+	if((size_t) st.st_size < sizeof head){
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		return NULL;
+	}
+	
+	/* Check that the header is ours, and that the arrays fit in the file. */
+	memcpy(&head, map, sizeof head);
+	words = (st.st_size - sizeof head) / sizeof(uint64_t);
+	if(memcmp(head.magic, HASHTAB_FROZEN_MAGIC, sizeof head.magic) ||
+			head.version != HASHTAB_FROZEN_VERSION ||
+			head.order != HASHTAB_FROZEN_ORDER ||
+			head.sizeT != sizeof(size_t) ||
+			!head.buckets || (head.buckets & (head.buckets - 1)) ||
+			head.buckets >= words || head.length >= words ||
+			head.buckets + 2 * head.length + 3 > words ||
+			head.blob > st.st_size - sizeof head -
+				(head.buckets + 2 * head.length + 3) * sizeof(uint64_t)){
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return NULL;
+	}
+	
+	ft = safeMalloc(sizeof *ft);
+	ft->map = map;
+	ft->mapSize = st.st_size;
+	ft->hasher = hasher;
+	ft->cmp = cmp;
+	ft->length = head.length;
+	ft->mask = head.buckets - 1;
+	ft->blobSize = head.blob;
+	ft->buckets = (const uint64_t *) ((const unsigned char *) map + sizeof head);
+	ft->entries = (const hashtab_frozenEntry_s *) (ft->buckets +
+			head.buckets + 1);
+	ft->blob = (const unsigned char *) (ft->entries + head.length + 1);
+	
+	return ft;
+}
+
+const void * hashtab_frozenFind(const hashtab_frozen_s * ft, const void * item,
+		size_t * len){
+	uint64_t hash = ft->hasher(item), i, end, from, to;
+	size_t b = hashtab_frozenBucket(hash, ft->mask);
+	
+	i = ft->buckets[b];
+	end = ft->buckets[b + 1];
+	/* A damaged file must not make us read outside of it. */
+	if(end > ft->length){
+		return NULL;
+	}
+	
+	for(; i < end; i++){
+		if(ft->entries[i].hash != hash){
+			continue;
+		}
+		
+		from = ft->entries[i].offset;
+		to = ft->entries[i + 1].offset;
+		if(from > to || to > ft->blobSize){
+			return NULL;
+		}
+		
+		if(ft->cmp(item, ft->blob + from, to - from) == 0){
+			if(len){
+				*len = to - from;
+			}
+			return ft->blob + from;
+		}
+	}
+	
+	return NULL;
+}
+
+size_t hashtab_frozenLength(const hashtab_frozen_s * ft){
+	return ft->length;
+}
+
+void hashtab_frozenClose(hashtab_frozen_s * ft){
+	munmap(ft->map, ft->mapSize);
+	free(ft);
+}
@@ -0,0 +1,115 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_frozen.h
+ *
+ * Frozen hash tables: a hash table written to a file (with hashtab_freeze),
+ * that is mapped into memory read-only (with hashtab_openMmap) and searched in
+ * place. Opening takes no time (nothing is parsed or allocated per item), and
+ * processes that map the same file share its pages. See README.md for more
+ * general comments.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#ifndef HASHTAB_FROZEN_H
+#define HASHTAB_FROZEN_H
+
+#include <stdlib.h>
+
+#include "hashtab.h"
+
+/** A frozen (read-only, mapped) hash table. Its members are private. */
+typedef struct hashtab_frozen hashtab_frozen_s;
+
+/**
+ * Write a hash table to a file, in the format read by hashtab_openMmap. Every
+ * item is stored as the bytes the serialize callback makes of it, along with
+ * its hash. The file can only be opened on machines with the same byte-order
+ * and size of size_t.
+ *
+ * The serialize callback is called (twice) for every item with a buffer buf of
+ * n bytes. It must write the item's bytes into buf if they fit, and return
+ * their number (also if they don't fit: then it's called again with a bigger
+ * buffer), just like snprintf. Both calls must make the same bytes.
+ *
+ * Seeded tables (see hashtab_makeSeeded) can't be frozen: their hashes depend
+ * on a random seed that the file couldn't be opened with.
+ *
+ * @param ht The hash table.
+ * @param fd The file to write to, from its current position.
+ * @param serialize The callback to serialize items with.
+ * @param ctx Passed to the callback.
+ * @return 0 on success, -1 if writing failed (errno tells why) or the table
+ *         is seeded (errno is EINVAL).
+ */
+int hashtab_freeze(hashtab_s * ht, int fd, size_t (*serialize)(
+		const void * item, void * buf, size_t n, void * ctx), void * ctx);
+
+/**
+ * Map a file written by hashtab_freeze. The hasher must be the one of the
+ * frozen table (it must return the same hashes). Items are compared with the
+ * bytes that were stored for them, so cmp receives a searched item and the
+ * stored bytes and their number, and returns 0 if they're equal.
+ *
+ * @param path The file.
+ * @param hasher The hash function for items.
+ * @param cmp The compare function for items and stored bytes.
+ * @return The frozen table, or NULL if the file could not be mapped or is not
+ *         a frozen table (errno tells why).
+ */
+hashtab_frozen_s * hashtab_openMmap(const char * path,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * item, const void * data, size_t len));
+
+/**
+ * Find an item in a frozen table.
+ *
+ * @param ft The frozen table.
+ * @param item The item to find.
+ * @param len Receives the number of stored bytes, may be NULL.
+ * @return The stored bytes of the item (in the mapped file), or NULL if it
+ *         could not be found.
+ */
+const void * hashtab_frozenFind(const hashtab_frozen_s * ft, const void * item,
+		size_t * len);
+
+/**
+ * The number of items in a frozen table.
+ *
+ * @param ft The frozen table.
+ * @return The number of items.
+ */
+size_t hashtab_frozenLength(const hashtab_frozen_s * ft);
+
+/**
+ * Unmap a frozen table. Bytes returned by hashtab_frozenFind are not valid
+ * afterwards.
+ *
+ * @param ft The frozen table.
+ */
+void hashtab_frozenClose(hashtab_frozen_s * ft);
+
+#endif /* HASHTAB_FROZEN_H */
@@ -0,0 +1,248 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_pages.c
+ *
+ * The page allocator. Every block is preceded by a header telling how to
+ * release it, in the alignment's worth of bytes before the block (so the
+ * block itself is aligned). Big blocks are mapped by themselves: first with
+ * explicit huge pages if asked, and otherwise with normal pages. With huge
+ * pages those are aligned and rounded to huge pages, so the kernel can back
+ * them with transparent ones. Their NUMA policy is set before any page is
+ * touched.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "hashtab.h"
+#include "hashtab_pages.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/** @private The size of a huge page (the default on x86-64 and ARM64). */
+#define HASHTAB_PAGES_HUGE ((size_t)2 << 20)
+/** @private The size of a cache line, the default alignment. */
+#define HASHTAB_PAGES_LINE 64
+
+/** @private The NUMA policies of mbind(2), as numaif.h isn't always there. */
+#define HASHTAB_MPOL_PREFERRED 1
+#define HASHTAB_MPOL_INTERLEAVE 3
+
+/** @private The header in front of every block. */
+typedef struct hashtab_block{
+	/** What malloc or mmap returned. */
+	void * base;
+	/** The length of the mapping, or 0 if the block is from malloc. */
+	size_t mapped;
+} hashtab_block_s;
+
+/**
+ * @private
+ *
+ * The alignment of the blocks: at least enough for the header in front.
+ *
+ * @param pages The options.
+ * @return The alignment, a power of two.
+ */
+static size_t hashtab_pagesAlign(const hashtab_pages_s * pages){
+	size_t align = pages->align ? pages->align : HASHTAB_PAGES_LINE;
+	
+	while(align < sizeof(hashtab_block_s)){
+		align *= 2;
+	}
+	
+	return align;
+}
+
+/**
+ * @private
+ *
+ * Sets the NUMA policy of a mapping, which applies to the pages faulted in
+ * afterwards. Failure is ignored: the kernel may have no NUMA support, or
+ * not allow it (in containers).
+ *
+ * @param pages The options.
+ * @param p The mapping.
+ * @param len Its length.
+ */
+static void hashtab_pagesPolicy(const hashtab_pages_s * pages, void * p,
+		size_t len){
+#ifdef SYS_mbind
+	unsigned long mask = ~0UL;
+	int mode = HASHTAB_MPOL_INTERLEAVE;
+	
+	if(!(pages->flags & HASHTAB_PAGES_INTERLEAVE)){
+		if(pages->node < 0 || (size_t)pages->node >= sizeof mask * 8){
+			return;
+		}
+		
+		mask = 1UL << pages->node;
+		mode = HASHTAB_MPOL_PREFERRED;
+	}
+	
+	/* Nodes that aren't there are left out of the mask by the kernel. */
+	syscall(SYS_mbind, p, len, mode, &mask, sizeof mask * 8, 0);
+#else
+	(void) pages;
+	(void) p;
+	(void) len;
+#endif
+}
+
+/**
+ * @private
+ *
+ * Maps a big block with huge pages if asked and possible, and sets its policy.
+ *
+ * @param pages The options.
+ * @param [in,out] len The number of bytes, rounded up to whole (huge) pages.
+ * @return The mapping, or MAP_FAILED.
+ */
+static void * hashtab_pagesMap(const hashtab_pages_s * pages, size_t * len){
+	const int prot = PROT_READ | PROT_WRITE, map = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t page = (size_t) sysconf(_SC_PAGESIZE), unit = page, i;
+	unsigned char * p = MAP_FAILED, * aligned;
+	
+	if(pages->flags & (HASHTAB_PAGES_THP | HASHTAB_PAGES_HUGETLB)){
+		unit = HASHTAB_PAGES_HUGE;
+	}
+	*len = (*len + unit - 1) & ~(unit - 1);
+	
+#ifdef MAP_HUGETLB
+	if(pages->flags & HASHTAB_PAGES_HUGETLB){
+		p = mmap(NULL, *len, prot, map | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	
+	if(p == MAP_FAILED){
+		/* Map one unit more, and cut the mapping down to aligned ones. */
+		p = mmap(NULL, *len + unit, prot, map, -1, 0);
+		if(p == MAP_FAILED){
+			return p;
+		}
+		
+		aligned = (unsigned char *)(((uintptr_t) p + unit - 1) &
+				~(uintptr_t)(unit - 1));
+		if(aligned > p){
+			munmap(p, (size_t)(aligned - p));
+		}
+		munmap(aligned + *len, unit - (size_t)(aligned - p));
+		p = aligned;
+		
+#ifdef MADV_HUGEPAGE
+		if(pages->flags & HASHTAB_PAGES_THP){
+			madvise(p, *len, MADV_HUGEPAGE);
+		}
+#endif
+	}
+	
+	hashtab_pagesPolicy(pages, p, *len);
+	
+	if(pages->flags & HASHTAB_PAGES_PREFAULT){
+		for(i = 0; i < *len; i += page){
+			((volatile unsigned char *) p)[i] = 0;
+		}
+	}
+	
+	return p;
+}
+
+/**
+ * @private
+ *
+ * Allocates a block, see hashtab_alloc_s.
+ *
+ * @param n The number of bytes.
+ * @param ctx The options.
+ * @return The block, or NULL if it could not be allocated.
+ */
+static void * hashtab_pagesAllocate(size_t n, void * ctx){
+	const hashtab_pages_s * pages = ctx;
+	size_t align = hashtab_pagesAlign(pages);
+	size_t big = pages->big ? pages->big : HASHTAB_PAGES_HUGE;
+	size_t len = n + align;
+	hashtab_block_s * head;
+	void * base;
+	
+	if(n < big){
+		if(posix_memalign(&base, align, len) != 0){
+			return NULL;
+		}
+		len = 0;
+	}else{
+		base = hashtab_pagesMap(pages, &len);
+		if(base == MAP_FAILED){
+			return NULL;
+		}
+	}
+	
+	head = (hashtab_block_s *)((unsigned char *) base + align) - 1;
+	head->base = base;
+	head->mapped = len;
+	
+	return head + 1;
+}
+
+/**
+ * @private
+ *
+ * Releases a block, see hashtab_alloc_s.
+ *
+ * @param p The block.
+ * @param ctx The options.
+ */
+static void hashtab_pagesRelease(void * p, void * ctx){
+	hashtab_block_s * head = (hashtab_block_s *) p - 1;
+	
+	if(head->mapped){
+		munmap(head->base, head->mapped);
+	}else{
+		free(head->base);
+	}
+}
+
+hashtab_alloc_s hashtab_pagesAlloc(hashtab_pages_s * pages){
+	hashtab_alloc_s alloc;
+	
+	alloc.allocate = hashtab_pagesAllocate;
+	alloc.release = hashtab_pagesRelease;
+	alloc.ctx = pages;
+	
+	return alloc;
+}
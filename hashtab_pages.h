@@ -0,0 +1,88 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_pages.h
+ *
+ * An allocator for big hash tables (see hashtab_makeAlloc), that maps their
+ * bucket arrays and slabs with huge pages and a NUMA policy, and aligns all
+ * its memory to cache lines. For POSIX systems, huge pages and NUMA policies
+ * are only available on Linux (elsewhere they're ignored). See README.md for
+ * more general comments.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#ifndef HASHTAB_PAGES_H
+#define HASHTAB_PAGES_H
+
+#include <stdlib.h>
+
+#include "hashtab.h"
+
+/** Page flag: ask for transparent huge pages for big blocks (madvise). */
+#define HASHTAB_PAGES_THP 0x1
+/** Page flag: map big blocks with explicit huge pages (MAP_HUGETLB), which
+    must be reserved by the system. Falls back to normal pages without. */
+#define HASHTAB_PAGES_HUGETLB 0x2
+/** Page flag: interleave the pages of big blocks over all NUMA nodes. */
+#define HASHTAB_PAGES_INTERLEAVE 0x4
+/** Page flag: fault in the pages of big blocks when they're allocated, after
+    their NUMA policy is set. */
+#define HASHTAB_PAGES_PREFAULT 0x8
+
+/** The options of a page allocator, see hashtab_pagesAlloc. */
+typedef struct hashtab_pages{
+	/** Any combination of the HASHTAB_PAGES_ flags. */
+	int flags;
+	/** The NUMA node to put the pages of big blocks on (if possible), or -1
+	    for wherever they're first touched. Ignored with
+	    HASHTAB_PAGES_INTERLEAVE. */
+	int node;
+	/** The alignment of all blocks, a power of two. 0 for a cache line (64
+	    bytes). */
+	size_t align;
+	/** The size from which blocks are big: mapped by themselves rather than
+	    taken from malloc. 0 for the size of a huge page (2 MiB). Slabs of
+	    links are at most about 100 KB, lower it to give them the NUMA policy
+	    as well. */
+	size_t big;
+} hashtab_pages_s;
+
+/**
+ * Make an allocator that maps big blocks (like the buckets of big tables) by
+ * themselves, with pages as set by the options. Smaller blocks come from
+ * malloc (aligned).
+ *
+ * Pass it to hashtab_makeAlloc. Failing to map a block is fatal, but huge pages
+ * and NUMA policies are only hints: if they can't be had, normal pages are
+ * used.
+ *
+ * @param pages The options, which must remain as long as any table using the
+ *        allocator.
+ * @return The allocator.
+ */
+hashtab_alloc_s hashtab_pagesAlloc(hashtab_pages_s * pages);
+
+#endif /* HASHTAB_PAGES_H */
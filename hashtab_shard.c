@@ -0,0 +1,315 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_shard.c
+ *
+ * The sharded hash table. The shard of an item is selected by the high bits of
+ * its mixed hash, while the shards select buckets by the low bits (or the
+ * remainder), so the items of a shard still spread over all its buckets.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include "hashtab.h"
+#include "hashtab_shard.h"
+
+struct hashtab_shard{
+	/** The shards. */
+	hashtab_s ** shards;
+	/** The number of shards, a power of two. */
+	size_t count;
+	/** The number of high bits of the hash that select the shard. */
+	unsigned bits;
+	/** The hash function, the same as the shards'. */
+	size_t (*hasher)(const void * item);
+};
+
+static void * safeMalloc(size_t n){
+	void * p = malloc(n);
+	if(!p){
+		fprintf(stderr, "malloc(%lu) failed\n", (unsigned long) n);
+		exit(1);
+	}
+	
+	return p;
+}
+
+/**
+ * @private
+ *
+ * Selects the shard of an item.
+ *
+ * @param sh The sharded table.
+ * @param item The item.
+ * @return The number of the shard.
+ */
+static size_t hashtab_shardRoute(const hashtab_shard_s * sh,
+		const void * item){
+	size_t hash = hashtab_mix(sh->hasher(item));
+	
+	return sh->bits ? hash >> (sizeof hash * CHAR_BIT - sh->bits) : 0;
+}
+
+/**
+ * @private
+ *
+ * Where the part of a thread starts, when n items are divided among threads:
+ * the first (n % nthreads) threads get one more item than the others.
+ *
+ * @param n The number of items.
+ * @param nthreads The number of threads.
+ * @param t The thread, or nthreads for the end of the last part.
+ * @return The first item of the part.
+ */
+static size_t hashtab_shardPart(size_t n, size_t nthreads, size_t t){
+	return t * (n / nthreads) + (t < n % nthreads ? t : n % nthreads);
+}
+
+hashtab_shard_s * hashtab_shardMake(size_t shards, size_t size,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold,
+		size_t moveR, int shrink, int flags){
+	hashtab_shard_s * sh = safeMalloc(sizeof *sh);
+	size_t i;
+	
+	if(shards > HASHTAB_SHARD_MAX){
+		shards = HASHTAB_SHARD_MAX;
+	}
+	
+	sh->count = 1;
+	sh->bits = 0;
+	while(sh->count < shards){
+		sh->count <<= 1;
+		++sh->bits;
+	}
+	sh->hasher = hasher;
+	
+	size = size / sh->count ? size / sh->count : 1;
+	sh->shards = safeMalloc(sh->count * sizeof *sh->shards);
+	for(i = 0; i < sh->count; ++i){
+		sh->shards[i] = hashtab_makeFlags(size, hasher, cmp, threshold, moveR,
+				shrink, flags);
+	}
+	
+	return sh;
+}
+
+size_t hashtab_shardCount(const hashtab_shard_s * sh){
+	return sh->count;
+}
+
+size_t hashtab_shardOf(const hashtab_shard_s * sh, const void * item){
+	return hashtab_shardRoute(sh, item);
+}
+
+hashtab_s * hashtab_shardTable(hashtab_shard_s * sh, size_t i){
+	return sh->shards[i];
+}
+
+size_t hashtab_shardLength(hashtab_shard_s * sh){
+	size_t i, n = 0;
+	
+	for(i = 0; i < sh->count; ++i){
+		n += hashtab_length(sh->shards[i]);
+	}
+	
+	return n;
+}
+
+void hashtab_shardAdd(hashtab_shard_s * sh, void * item){
+	hashtab_add(sh->shards[hashtab_shardRoute(sh, item)], item);
+}
+
+void * hashtab_shardFind(hashtab_shard_s * sh, const void * item){
+	return hashtab_find(sh->shards[hashtab_shardRoute(sh, item)], item);
+}
+
+void * hashtab_shardInsert(hashtab_shard_s * sh, void * item){
+	return hashtab_insert(sh->shards[hashtab_shardRoute(sh, item)], item);
+}
+
+void * hashtab_shardRemove(hashtab_shard_s * sh, const void * item){
+	return hashtab_remove(sh->shards[hashtab_shardRoute(sh, item)], item);
+}
+
+void hashtab_shardForEach(hashtab_shard_s * sh,
+		void (*callback)(void * item, void * ctx), void * ctx){
+	size_t i;
+	
+	for(i = 0; i < sh->count; ++i){
+		hashtab_forEach(sh->shards[i], callback, ctx);
+	}
+}
+
+size_t hashtab_shardBuild(hashtab_shard_s * sh, void * const * items,
+		size_t n, int nthreads){
+	size_t count = sh->count, * offsets, * starts, at, c, s;
+	uint16_t * routes;
+	void ** parts;
+	int t;
+	
+	if(nthreads < 1){
+		nthreads = 1;
+	}
+	
+	/* offsets[t * count + s]: where thread t puts its next item of shard s. */
+	offsets = safeMalloc((size_t) nthreads * count * sizeof *offsets);
+	memset(offsets, 0, (size_t) nthreads * count * sizeof *offsets);
+	starts = safeMalloc((count + 1) * sizeof *starts);
+	routes = safeMalloc((n ? n : 1) * sizeof *routes);
+	parts = safeMalloc((n ? n : 1) * sizeof *parts);
+	
+	/* Count the items of every thread's part per shard. */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+#endif
+	for(t = 0; t < nthreads; ++t){
+		size_t * counts = offsets + (size_t) t * count;
+		size_t i, end = hashtab_shardPart(n, nthreads, t + 1);
+		
+		for(i = hashtab_shardPart(n, nthreads, t); i < end; ++i){
+			routes[i] = (uint16_t) hashtab_shardRoute(sh, items[i]);
+			++counts[routes[i]];
+		}
+	}
+	
+	/* The items of every shard go one after the other, and within those the
+	   items of every thread. */
+	for(at = 0, s = 0; s < count; ++s){
+		starts[s] = at;
+		for(t = 0; t < nthreads; ++t){
+			c = offsets[(size_t) t * count + s];
+			offsets[(size_t) t * count + s] = at;
+			at += c;
+		}
+	}
+	starts[count] = at;
+	
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+#endif
+	for(t = 0; t < nthreads; ++t){
+		size_t * next = offsets + (size_t) t * count;
+		size_t i, end = hashtab_shardPart(n, nthreads, t + 1);
+		
+		for(i = hashtab_shardPart(n, nthreads, t); i < end; ++i){
+			parts[next[routes[i]]++] = items[i];
+		}
+	}
+	
+	free(routes);
+	free(offsets);
+	
+	/* Every shard is built by a single thread, threads take them as they go. */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+	for(t = 0; t < (int) count; ++t){
+		hashtab_s * shard = sh->shards[t];
+		size_t m = starts[t + 1] - starts[t];
+		
+		if(m){
+			hashtab_reserve(shard, hashtab_length(shard) + m);
+			hashtab_addMany(shard, parts + starts[t], m);
+		}
+	}
+	
+	free(parts);
+	free(starts);
+	
+	return hashtab_shardLength(sh);
+}
+
+void hashtab_shardStats(const hashtab_shard_s * sh,
+		hashtab_shard_stats_s * stats){
+	hashtab_stats_s * all = &stats->all, one;
+	size_t i, k, buckets = 0;
+	float probes = 0;
+	const hashtab_s * shard;
+	
+	memset(stats, 0, sizeof *stats);
+	stats->minLength = SIZE_MAX;
+	
+	for(i = 0; i < sh->count; ++i){
+		shard = sh->shards[i];
+		hashtab_stats(shard, &one);
+		
+		all->length += one.length;
+		all->size += one.size;
+		all->otherSize += one.otherSize;
+		all->pending += one.pending;
+		for(k = 0; k < HASHTAB_STATS_CHAINS; ++k){
+			all->chains[k] += one.chains[k];
+		}
+		all->empty += one.empty;
+		if(one.maxProbe > all->maxProbe){
+			all->maxProbe = one.maxProbe;
+		}
+		if(one.maxDisplacement > all->maxDisplacement){
+			all->maxDisplacement = one.maxDisplacement;
+		}
+		all->bytes += one.bytes;
+		all->allocs += one.allocs;
+		all->reallocs += one.reallocs;
+		all->finds += one.finds;
+		all->probes += one.probes;
+		all->cmps += one.cmps;
+		
+		buckets += one.size + one.otherSize;
+		probes += one.meanProbe * (float) one.length;
+		
+		stats->grows += shard->grows;
+		stats->shrinks += shard->shrinks;
+		stats->reseeds += shard->reseeds;
+		if(one.length < stats->minLength){
+			stats->minLength = one.length;
+		}
+		if(one.length > stats->maxLength){
+			stats->maxLength = one.length;
+		}
+	}
+	
+	all->emptyRatio = (float) all->empty / (float) buckets;
+	all->meanProbe = all->length ? probes / (float) all->length : 0;
+	all->bytes += sizeof *sh + sh->count * sizeof *sh->shards;
+}
+
+void hashtab_shardFree(hashtab_shard_s * sh,
+		void (*cb)(void * item, void * ctx), void * ctx){
+	size_t i;
+	
+	for(i = 0; i < sh->count; ++i){
+		hashtab_free(sh->shards[i], cb, ctx);
+	}
+	
+	free(sh->shards);
+	free(sh);
+}
@@ -0,0 +1,206 @@
+/**
+ * HashTab: a simple but effective hash table implementation.
+ * @author  Marco Gunnink <marco@kninnug.nl>
+ * @date    2015-11-18
+ * @version 3.0.0
+ * @file    hashtab_shard.h
+ *
+ * A sharded hash table: a number of independent hash tables (shards), with
+ * every item in the shard selected by the high bits of its (mixed) hash.
+ * Different shards can be changed on different threads at once, without
+ * locks, and a bulk build partitions its items over the shards and builds
+ * every shard on a thread of its own. See README.md for more general comments.
+ *
+ * License MIT:
+ *
+ * Copyright (c) 2015 Marco Gunnink
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * The software is provided "as is", without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose and noninfringement. In no event shall the
+ * authors or copyright holders be liable for any claim, damages or other
+ * liability, whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other dealings in
+ * the software.
+ */
+
+#ifndef HASHTAB_SHARD_H
+#define HASHTAB_SHARD_H
+
+#include <stdlib.h>
+
+#include "hashtab.h"
+
+/** The most shards a sharded table can have. */
+#define HASHTAB_SHARD_MAX 65536
+
+/** A sharded hash table. Its members are private: use the functions. */
+typedef struct hashtab_shard hashtab_shard_s;
+
+/** Statistics about a sharded table (see hashtab_shardStats). */
+typedef struct hashtab_shard_stats{
+	/** The statistics of all shards together: the counts are summed, the
+	    maxima are the largest of any shard and the ratios and averages are
+	    over all buckets and items. */
+	hashtab_stats_s all;
+	/** The number of times shards grew, shrank and were reseeded. */
+	size_t grows, shrinks, reseeds;
+	/** The number of items in the shard holding the fewest, and the most. A
+	    big difference means the hash function spreads items poorly. */
+	size_t minLength, maxLength;
+} hashtab_shard_stats_s;
+
+/**
+ * Allocate and initialize a sharded hash table. The shards are made with
+ * hashtab_makeFlags, with the given settings.
+ *
+ * @param shards The number of shards, rounded up to a power of two (and at
+ *        most HASHTAB_SHARD_MAX).
+ * @param size The initial size of all shards together.
+ * @param hasher The hash function.
+ * @param cmp The compare function.
+ * @param threshold The load factor at which a shard is grown.
+ * @param moveR The move rate of the shards.
+ * @param shrink Non-zero to allow the shards to shrink.
+ * @param flags The flags of the shards.
+ * @return The sharded table.
+ */
+hashtab_shard_s * hashtab_shardMake(size_t shards, size_t size,
+		size_t (*hasher)(const void * item),
+		int (*cmp)(const void * a, const void * b), float threshold,
+		size_t moveR, int shrink, int flags);
+
+/**
+ * The number of shards.
+ *
+ * @param sh The sharded table.
+ * @return The number of shards.
+ */
+size_t hashtab_shardCount(const hashtab_shard_s * sh);
+
+/**
+ * The shard an item belongs in: the item is added to, found in and removed
+ * from only that one. Threads that each add only the items of their own
+ * shards need no locks.
+ *
+ * @param sh The sharded table.
+ * @param item The item.
+ * @return The number of the shard.
+ */
+size_t hashtab_shardOf(const hashtab_shard_s * sh, const void * item);
+
+/**
+ * A shard, for the functions of hashtab.h. The shard must not be freed, and
+ * items must only be added to the shard they belong in (see hashtab_shardOf).
+ *
+ * @param sh The sharded table.
+ * @param i The number of the shard.
+ * @return The shard.
+ */
+hashtab_s * hashtab_shardTable(hashtab_shard_s * sh, size_t i);
+
+/**
+ * The number of items in all shards.
+ *
+ * @param sh The sharded table.
+ * @return The number of items.
+ */
+size_t hashtab_shardLength(hashtab_shard_s * sh);
+
+/**
+ * Add an item to its shard, see hashtab_add.
+ *
+ * @param sh The sharded table.
+ * @param item The item.
+ */
+void hashtab_shardAdd(hashtab_shard_s * sh, void * item);
+
+/**
+ * Find an item in its shard, see hashtab_find.
+ *
+ * @param sh The sharded table.
+ * @param item The item to find.
+ * @return The item in the table, or NULL if it's not in it.
+ */
+void * hashtab_shardFind(hashtab_shard_s * sh, const void * item);
+
+/**
+ * Insert an item into its shard, see hashtab_insert.
+ *
+ * @param sh The sharded table.
+ * @param item The item.
+ * @return The item that was replaced, or NULL if there was none.
+ */
+void * hashtab_shardInsert(hashtab_shard_s * sh, void * item);
+
+/**
+ * Remove an item from its shard, see hashtab_remove.
+ *
+ * @param sh The sharded table.
+ * @param item The item to remove.
+ * @return The removed item, or NULL if it's not in the table.
+ */
+void * hashtab_shardRemove(hashtab_shard_s * sh, const void * item);
+
+/**
+ * Apply a function to each item of every shard, one shard after the other.
+ *
+ * @param sh The sharded table.
+ * @param callback The function. The first argument is the item, the second
+ *        is ctx.
+ * @param ctx A context also supplied to the callback.
+ */
+void hashtab_shardForEach(hashtab_shard_s * sh,
+		void (*callback)(void * item, void * ctx), void * ctx);
+
+/**
+ * Add many items at once, on several threads. The items are partitioned by
+ * shard first (like a pass of radix sort: they are counted per shard, then
+ * every thread copies its part of the items to where their shards' items go).
+ * Then every shard is resized once for its items and gets them added on a
+ * thread of its own (see hashtab_reserve and hashtab_addMany), so no locks
+ * are needed. This needs OpenMP (-fopenmp), without it all of this happens on
+ * the calling thread.
+ *
+ * Items are added like by hashtab_add, to whatever the shards hold already.
+ * The table must not be used otherwise while this runs.
+ *
+ * @param sh The sharded table.
+ * @param items The items.
+ * @param n The number of items.
+ * @param nthreads The number of threads (at most).
+ * @return The number of items in all shards afterwards.
+ */
+size_t hashtab_shardBuild(hashtab_shard_s * sh, void * const * items,
+		size_t n, int nthreads);
+
+/**
+ * Fill in statistics about all shards, see hashtab_stats.
+ *
+ * @param sh The sharded table.
+ * @param [out] stats The statistics.
+ */
+void hashtab_shardStats(const hashtab_shard_s * sh,
+		hashtab_shard_stats_s * stats);
+
+/**
+ * Free the sharded table and all its shards.
+ *
+ * @param sh The sharded table.
+ * @param cb A callback to free the items left in the shards, or NULL.
+ * @param ctx A context pointer for the callback.
+ */
+void hashtab_shardFree(hashtab_shard_s * sh,
+		void (*cb)(void * item, void * ctx), void * ctx);
+
+#endif /* HASHTAB_SHARD_H */
@@ -0,0 +1,355 @@
+/** ***************************************************************************
+ * @file hashtab_typed.h
+ *
+ * Type-specialized hash tables. HASHTAB_DEFINE generates a table type and its
+ * functions for one key and value type, with the hash and compare functions
+ * inlined and the keys and values stored by value in the links, rather than
+ * behind a void pointer. The tables grow just like HashTab's chained tables:
+ * incrementally into an other table of twice the size, moving (size / moveR)
+ * buckets per add or remove operation.
+ *
+ * Quick start:
+ * @code{.c}
+ *
+ * static size_t intHash(int k){ return k; }
+ * #define intEq(a, b) ((a) == (b))
+ *
+ * // Defines intmap_s, intmap_make, intmap_add, intmap_find, ...
+ * HASHTAB_DEFINE(intmap, int, double, intHash, intEq)
+ *
+ * intmap_s * m = intmap_make(8, 0.75, 4);
+ * intmap_add(m, 12, 3.4);
+ * double * found = intmap_find(m, 12); // pointer to the stored value
+ * if(found){ // != NULL
+ *     printf("12 -> %f\n", *found);
+ * }
+ * intmap_remove(m, 12, NULL);
+ * intmap_free(m);
+ *
+ * @endcode
+ *
+ * The functions generated by HASHTAB_DEFINE(name, key_type, val_type, hash_fn,
+ * eq_fn):
+ *
+ * - `name_s * name_make(size_t size, float threshold, size_t moveR)`: Make a
+ *   table. The size is rounded up to a power of two.
+ * - `void name_add(name_s * ht, key_type key, val_type val)`: Add a key-value
+ *   pair, even if the key already exists.
+ * - `int name_insert(name_s * ht, key_type key, val_type val)`: Replace the
+ *   value of key, or add it. Returns 1 if it was replaced.
+ * - `val_type * name_find(name_s * ht, key_type key)`: Find the value of key,
+ *   or NULL. The pointer is valid until the next add, insert or remove.
+ * - `int name_remove(name_s * ht, key_type key, val_type * val)`: Remove key
+ *   (and store its value in val, if not NULL). Returns 1 if it was removed.
+ * - `size_t name_length(const name_s * ht)`: The number of pairs.
+ * - `void name_forEach(name_s * ht, void (*cb)(const key_type * key,
+ *   val_type * val, void * ctx), void * ctx)`: Call cb for every pair.
+ * - `void name_free(name_s * ht)`: Free the table.
+ *
+ * The hash_fn gets a key and returns a size_t, eq_fn gets two keys and
+ * returns non-zero if they're equal. Either may be a function or a macro.
+ * Hashes are mixed (as with HASHTAB_MIX) before selecting a bucket.
+ **************************************************************************** */
+
+#ifndef HASHTAB_TYPED_H
+#define HASHTAB_TYPED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/** The number of links allocated at once. */
+#ifndef HASHTAB_TYPED_SLAB
+#	define HASHTAB_TYPED_SLAB 64
+#endif
+
+/**
+ * @private
+ *
+ * The same finalizer as hashtab_mix, here so it can be inlined.
+ */
+static inline size_t hashtab__mix(size_t h){
+#if SIZE_MAX > 0xFFFFFFFFu
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+#else
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+#endif
+	return h;
+}
+
+/**
+ * @private
+ *
+ * malloc, but failure is fatal.
+ */
+static inline void * hashtab__malloc(size_t n){
+	void * p = malloc(n);
+
+	if(!p){
+		fprintf(stderr, "malloc(%lu) failed\n", (unsigned long) n);
+		exit(1);
+	}
+
+	return p;
+}
+
+/**
+ * Define a hash table type `name_s` mapping key_type to val_type, and its
+ * functions (see the top of this file).
+ *
+ * @param name The prefix of the type and functions.
+ * @param key_type The key type.
+ * @param val_type The value type.
+ * @param hash_fn The hash function or macro: size_t hash_fn(key_type).
+ * @param eq_fn The equality function or macro: int eq_fn(key_type, key_type).
+ */
+#define HASHTAB_DEFINE(name, key_type, val_type, hash_fn, eq_fn)              \
+                                                                              \
+typedef key_type name##__key;                                                 \
+                                                                              \
+typedef struct name##__link{                                                  \
+	size_t hash;                                                              \
+	struct name##__link * next;                                               \
+	key_type key;                                                             \
+	val_type val;                                                             \
+} name##__link_s;                                                             \
+                                                                              \
+typedef struct name##__slab{                                                  \
+	struct name##__slab * next;                                               \
+	name##__link_s links[HASHTAB_TYPED_SLAB];                                 \
+} name##__slab_s;                                                             \
+                                                                              \
+typedef struct name{                                                          \
+	/* The number of pairs, in both tables. */                                \
+	size_t length;                                                            \
+	/* The size of the table, a power of two. */                              \
+	size_t size;                                                              \
+	/* When migrating: the next bucket to move. */                            \
+	size_t first;                                                             \
+	float threshold;                                                          \
+	size_t moveR;                                                             \
+	size_t grows;                                                             \
+	name##__link_s ** data;                                                   \
+	/* When migrating: the new table (twice the size), otherwise NULL. */     \
+	name##__link_s ** other;                                                  \
+	/* Released links, and the slabs they all come from. */                   \
+	name##__link_s * spare;                                                   \
+	name##__slab_s * slabs;                                                   \
+	size_t left;                                                              \
+} name##_s;                                                                   \
+                                                                              \
+static inline name##__link_s ** name##__buckets(size_t size){                 \
+	name##__link_s ** data = hashtab__malloc(size * sizeof *data);            \
+	size_t i;                                                                 \
+                                                                              \
+	for(i = 0; i < size; ++i){                                                \
+		data[i] = NULL;                                                       \
+	}                                                                         \
+                                                                              \
+	return data;                                                              \
+}                                                                             \
+                                                                              \
+static inline name##_s * name##_make(size_t size, float threshold,            \
+		size_t moveR){                                                        \
+	name##_s * ht = hashtab__malloc(sizeof *ht);                              \
+	size_t n = 1;                                                             \
+                                                                              \
+	while(n < size){                                                          \
+		n <<= 1;                                                              \
+	}                                                                         \
+                                                                              \
+	ht->length = 0;                                                           \
+	ht->size = n;                                                             \
+	ht->first = 0;                                                            \
+	ht->threshold = threshold;                                                \
+	ht->moveR = moveR ? moveR : 1;                                            \
+	ht->grows = 0;                                                            \
+	ht->data = name##__buckets(n);                                            \
+	ht->other = NULL;                                                         \
+	ht->spare = NULL;                                                         \
+	ht->slabs = NULL;                                                         \
+	ht->left = 0;                                                             \
+                                                                              \
+	return ht;                                                                \
+}                                                                             \
+                                                                              \
+static inline name##__link_s * name##__link(name##_s * ht){                   \
+	name##__link_s * link = ht->spare;                                        \
+	name##__slab_s * slab;                                                    \
+                                                                              \
+	if(link){                                                                 \
+		ht->spare = link->next;                                               \
+		return link;                                                          \
+	}                                                                         \
+                                                                              \
+	if(!ht->left){                                                            \
+		slab = hashtab__malloc(sizeof *slab);                                 \
+		slab->next = ht->slabs;                                               \
+		ht->slabs = slab;                                                     \
+		ht->left = HASHTAB_TYPED_SLAB;                                        \
+	}                                                                         \
+                                                                              \
+	return &ht->slabs->links[--ht->left];                                     \
+}                                                                             \
+                                                                              \
+/* Moves (size / moveR) buckets to the other table, and merges it back once */ \
+/* all buckets have been moved. */                                            \
+static inline void name##__moveOver(name##_s * ht){                           \
+	size_t n = ht->size / ht->moveR, mask = ht->size * 2 - 1, b;              \
+	name##__link_s * link, * next;                                            \
+                                                                              \
+	for(n = n ? n : 1; n > 0 && ht->first < ht->size; --n, ++ht->first){      \
+		for(link = ht->data[ht->first]; link; link = next){                   \
+			next = link->next;                                                \
+			b = link->hash & mask;                                            \
+			link->next = ht->other[b];                                        \
+			ht->other[b] = link;                                              \
+		}                                                                     \
+		ht->data[ht->first] = NULL;                                           \
+	}                                                                         \
+                                                                              \
+	if(ht->first == ht->size){                                                \
+		free(ht->data);                                                       \
+		ht->data = ht->other;                                                 \
+		ht->other = NULL;                                                     \
+		ht->size *= 2;                                                        \
+		ht->first = 0;                                                        \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+/* The bucket of a hash: in the other table once its bucket has been moved */ \
+/* there, otherwise in the table. So every key is in exactly one bucket. */   \
+static inline name##__link_s ** name##__bucket(name##_s * ht, size_t h){      \
+	if(ht->other && (h & (ht->size - 1)) < ht->first){                        \
+		return &ht->other[h & (ht->size * 2 - 1)];                            \
+	}                                                                         \
+                                                                              \
+	return &ht->data[h & (ht->size - 1)];                                     \
+}                                                                             \
+                                                                              \
+/* Finds the pointer to the link of key, or to the NULL ending its bucket. */ \
+static inline name##__link_s ** name##__ref(name##_s * ht, key_type key,      \
+		size_t h){                                                            \
+	name##__link_s ** ref = name##__bucket(ht, h), * link;                    \
+                                                                              \
+	for(; (link = *ref); ref = &link->next){                                  \
+		if(link->hash == h && eq_fn(link->key, key)){                         \
+			break;                                                            \
+		}                                                                     \
+	}                                                                         \
+                                                                              \
+	return ref;                                                               \
+}                                                                             \
+                                                                              \
+static inline void name##__add(name##_s * ht, key_type key, val_type val,     \
+		size_t h){                                                            \
+	name##__link_s * link, ** bucket;                                         \
+                                                                              \
+	if(!ht->other && (float)ht->length > ht->threshold * (float)ht->size){    \
+		ht->other = name##__buckets(ht->size * 2);                            \
+		ht->first = 0;                                                        \
+		++ht->grows;                                                          \
+	}                                                                         \
+                                                                              \
+	link = name##__link(ht);                                                  \
+	link->hash = h;                                                           \
+	link->key = key;                                                          \
+	link->val = val;                                                          \
+	bucket = name##__bucket(ht, h);                                           \
+	link->next = *bucket;                                                     \
+	*bucket = link;                                                           \
+	++ht->length;                                                             \
+                                                                              \
+	if(ht->other){                                                            \
+		name##__moveOver(ht);                                                 \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+static inline void name##_add(name##_s * ht, key_type key, val_type val){     \
+	name##__add(ht, key, val, hashtab__mix(hash_fn(key)));                    \
+}                                                                             \
+                                                                              \
+static inline int name##_insert(name##_s * ht, key_type key, val_type val){   \
+	size_t h = hashtab__mix(hash_fn(key));                                    \
+	name##__link_s * link = *name##__ref(ht, key, h);                         \
+                                                                              \
+	if(link){                                                                 \
+		link->val = val;                                                      \
+		return 1;                                                             \
+	}                                                                         \
+                                                                              \
+	name##__add(ht, key, val, h);                                             \
+                                                                              \
+	return 0;                                                                 \
+}                                                                             \
+                                                                              \
+static inline val_type * name##_find(name##_s * ht, key_type key){            \
+	name##__link_s * link = *name##__ref(ht, key, hashtab__mix(hash_fn(key))); \
+                                                                              \
+	return link ? &link->val : NULL;                                          \
+}                                                                             \
+                                                                              \
+static inline int name##_remove(name##_s * ht, key_type key, val_type * val){ \
+	name##__link_s ** ref = name##__ref(ht, key, hashtab__mix(hash_fn(key))); \
+	name##__link_s * link = *ref;                                             \
+                                                                              \
+	if(link){                                                                 \
+		if(val){                                                              \
+			*val = link->val;                                                 \
+		}                                                                     \
+		*ref = link->next;                                                    \
+		link->next = ht->spare;                                               \
+		ht->spare = link;                                                     \
+		--ht->length;                                                         \
+	}                                                                         \
+                                                                              \
+	if(ht->other){                                                            \
+		name##__moveOver(ht);                                                 \
+	}                                                                         \
+                                                                              \
+	return link != NULL;                                                      \
+}                                                                             \
+                                                                              \
+static inline size_t name##_length(const name##_s * ht){                      \
+	return ht->length;                                                        \
+}                                                                             \
+                                                                              \
+static inline void name##_forEach(name##_s * ht,                              \
+		void (*cb)(const name##__key * key, val_type * val, void * ctx),      \
+		void * ctx){                                                          \
+	name##__link_s * link;                                                    \
+	size_t i;                                                                 \
+                                                                              \
+	for(i = ht->first; i < ht->size; ++i){                                    \
+		for(link = ht->data[i]; link; link = link->next){                     \
+			cb(&link->key, &link->val, ctx);                                  \
+		}                                                                     \
+	}                                                                         \
+	for(i = 0; ht->other && i < ht->size * 2; ++i){                           \
+		for(link = ht->other[i]; link; link = link->next){                    \
+			cb(&link->key, &link->val, ctx);                                  \
+		}                                                                     \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+static inline void name##_free(name##_s * ht){                                \
+	name##__slab_s * slab, * next;                                            \
+                                                                              \
+	for(slab = ht->slabs; slab; slab = next){                                 \
+		next = slab->next;                                                    \
+		free(slab);                                                           \
+	}                                                                         \
+	free(ht->data);                                                           \
+	free(ht->other);                                                          \
+	free(ht);                                                                 \
+}
+
+#endif
@@ -27,57 +27,206 @@
  * stringmap_free(ht, NULL, NULL); // no callback for freeing items necessary
  *
  * @endcode
+ *
+ * Every entry keeps the hash and length of its key, so keys are hashed once
+ * per operation and only compared when both match. It also keeps the first
+ * STRINGMAP_PREFIX bytes of its key, which are compared first (all 16 at once
+ * with SSE2 or NEON), so keys that short are never looked at by compares and
+ * longer ones only from there on. With
+ * stringmap_makeArena the keys are copied into an arena that belongs to the
+ * map, so they need not remain allocated, and all entries are freed at once.
  **************************************************************************** */
 
 #ifndef STRINGMAP_H
 #define STRINGMAP_H
 
 /**
- * The default hash-function is ELFHash (from GeneralHashFunctions). Re-#define
- * STRINGMAP_HASH before #include-ing this header to use a different one.
+ * The default hash-function is WYHash (from GeneralHashFunctions, so compile
+ * GeneralHashFunctions.c along). Set WYHashSeed to a random value at startup to
+ * make the hashes differ between processes. Re-#define STRINGMAP_HASH before
+ * #include-ing this header to use a different one.
  */
 #ifndef STRINGMAP_HASH
-#	define STRINGMAP_HASH ELFHash
+#	define STRINGMAP_HASH WYHash
+#	include "GeneralHashFunctions.h"
+#endif
+
+/**
+ * The hash-function of maps made with stringmap_makeSeeded, which gets the
+ * seed of the map as its third argument. The default is WYHashSeeded.
+ * Re-#define STRINGMAP_HASH_SEEDED before #include-ing this header to use a
+ * different one.
+ */
+#ifndef STRINGMAP_HASH_SEEDED
+#	define STRINGMAP_HASH_SEEDED WYHashSeeded
+#	include "GeneralHashFunctions.h"
+#endif
+
+/**
+ * The size of the blocks keys are copied into by maps made with
+ * stringmap_makeArena (longer keys get a block of their own). Re-#define
+ * STRINGMAP_ARENA_BLOCK before #include-ing this header to change it.
+ */
+#ifndef STRINGMAP_ARENA_BLOCK
+#	define STRINGMAP_ARENA_BLOCK 4096
 #endif
 
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+		(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define STRINGMAP__SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define STRINGMAP__NEON
+#endif
+
 #include "hashtab.h"
 
+/**
+ * The number of bytes of a key kept in its entry (see stringmap_s): 16, or 0
+ * to keep none, which makes entries 16 bytes smaller. Other sizes work too,
+ * but their prefixes are compared with memcmp instead of SSE2 or NEON.
+ * Re-#define STRINGMAP_PREFIX before #include-ing this header to change it.
+ */
+#ifndef STRINGMAP_PREFIX
+#	define STRINGMAP_PREFIX 16
+#endif
+
 struct stringmap;
 typedef struct stringmap stringmap_s;
 
 struct stringmap{
+	/** The key, not NUL-terminated if added with stringmap_addn (unless the
+	    map copies keys). */
 	const char * key;
 	void * item;
+	/** The length of the key. */
+	size_t len;
+	/** The hash of the key. */
+	size_t hash;
+#if STRINGMAP_PREFIX
+	/** The first (up to) STRINGMAP_PREFIX bytes of the key, the rest is 0. */
+	unsigned char prefix[STRINGMAP_PREFIX];
+#endif
 };
 
 struct stringmap__cb{
 	void (*cb)(const char * key, void * item, void * ctx);
 	void * ctx;
+	/* Whether the entries are in an arena, rather than malloc'ed */
+	int arena;
+};
+
+/**
+ * @private
+ *
+ * A block of the arena of a map made with stringmap_makeArena, kept in the
+ * hashtab's ctx. Entries are placed at the start of data (aligned to size_t),
+ * their keys right after them.
+ */
+struct stringmap__block{
+	struct stringmap__block * next;
+	size_t used;
+	size_t size;
+	char data[];
 };
 
 /**
  * @private
  *
- * The hash-callback.
+ * The hash-callback: the hash is computed once, when making the entry.
  */
 static size_t stringmap__hash(const void * v){
 	const stringmap_s * sm = v;
-	return STRINGMAP_HASH(sm->key, strlen(sm->key));
+	return sm->hash;
+}
+
+/**
+ * @private
+ *
+ * The hash-callback of seeded maps: the seed is the map's, so the hash of a
+ * key can't be cached in its entry.
+ */
+static size_t stringmap__hashSeeded(const void * v, size_t seed){
+	const stringmap_s * sm = v;
+	return (size_t) STRINGMAP_HASH_SEEDED(sm->key, sm->len, seed);
+}
+
+/**
+ * @private
+ *
+ * The hash of a key kept in its entry: 0 in seeded maps, which hash keys
+ * with their seed instead (the compare-callback only needs them to be equal).
+ */
+static inline size_t stringmap__keyHash(const hashtab_s * ht, const char * key,
+		size_t len){
+	return ht->seededHasher ? 0 : (size_t) STRINGMAP_HASH(key, len);
+}
+
+/**
+ * @private
+ *
+ * Fills in the prefix of an entry from its key.
+ */
+static inline void stringmap__setPrefix(stringmap_s * sm){
+#if STRINGMAP_PREFIX
+	memset(sm->prefix, 0, STRINGMAP_PREFIX);
+	memcpy(sm->prefix, sm->key, sm->len < STRINGMAP_PREFIX ? sm->len :
+			STRINGMAP_PREFIX);
+#else
+	(void) sm;
+#endif
+}
+
+/**
+ * @private
+ *
+ * Whether the prefixes of two entries are equal: all 16 bytes at once with
+ * SSE2 or NEON, otherwise (or for other sizes) with memcmp.
+ */
+static inline int stringmap__prefixEq(const stringmap_s * a,
+		const stringmap_s * b){
+#if !STRINGMAP_PREFIX
+	(void) a;
+	(void) b;
+	
+	return 1;
+#elif STRINGMAP_PREFIX == 16 && defined(STRINGMAP__SSE2)
+	__m128i x = _mm_loadu_si128((const __m128i *) a->prefix);
+	__m128i y = _mm_loadu_si128((const __m128i *) b->prefix);
+	
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+#elif STRINGMAP_PREFIX == 16 && defined(STRINGMAP__NEON)
+	return vminvq_u8(vceqq_u8(vld1q_u8(a->prefix), vld1q_u8(b->prefix))) ==
+			0xFF;
+#else
+	return memcmp(a->prefix, b->prefix, STRINGMAP_PREFIX) == 0;
+#endif
 }
 
 /**
  * @private
  *
- * The compare-callback.
+ * The compare-callback: the keys themselves are only compared after their
+ * prefixes, and only from there on.
  */
 static int stringmap__cmp(const void * va, const void * vb){
 	const stringmap_s * a = va;
 	const stringmap_s * b = vb;
 	
-	return strcmp(a->key, b->key);
+	if(a->hash != b->hash || a->len != b->len || !stringmap__prefixEq(a, b)){
+		return 1;
+	}
+	
+	if(a->len <= STRINGMAP_PREFIX){
+		return 0;
+	}
+	
+	return memcmp(a->key + STRINGMAP_PREFIX, b->key + STRINGMAP_PREFIX,
+			a->len - STRINGMAP_PREFIX);
 }
 
 /**
@@ -93,7 +242,9 @@ static void stringmap__free(void * v, void * vctx){
 		ctx->cb(sm->key, sm->item, ctx->ctx);
 	}
 	
-	free(v);
+	if(!ctx->arena){
+		free(v);
+	}
 }
 
 /**
@@ -111,15 +262,134 @@ static void stringmap__forEach(void * v, void * vctx){
 /**
  * @private
  *
- * Allocs and inits a stringmap_s.
+ * The context of the make-callback.
  */
-static inline stringmap_s * stringmap__mk(const char * key, void * item){
-	stringmap_s * ret = malloc(sizeof *ret);
+struct stringmap__make{
+	hashtab_s * ht;
+	void * item;
+};
+
+/**
+ * @private
+ *
+ * Takes n bytes (aligned to size_t) from an arena, the hashtab's ctx.
+ */
+static inline void * stringmap__arenaAlloc(void ** arena, size_t n){
+	struct stringmap__block * block = *arena;
+	size_t size;
+	void * ret;
+	
+	n = (n + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+	
+	if(!block || block->size - block->used < n){
+		size = n > STRINGMAP_ARENA_BLOCK ? n : STRINGMAP_ARENA_BLOCK;
+		block = malloc(sizeof *block + size);
+		block->next = *arena;
+		block->used = 0;
+		block->size = size;
+		*arena = block;
+	}
+	
+	ret = block->data + block->used;
+	block->used += n;
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Allocs and inits a stringmap_s for a key of len bytes with a known hash. In
+ * maps with an arena the key is copied into the arena, right after the entry.
+ */
+static inline stringmap_s * stringmap__mkh(hashtab_s * ht, const char * key,
+		size_t len, size_t hash, void * item){
+	stringmap_s * ret;
+	char * copy;
+	
+	if(hashtab_ctx(ht)){
+		ret = stringmap__arenaAlloc(&ht->ctx, sizeof *ret + len + 1);
+		copy = (char *)(ret + 1);
+		memcpy(copy, key, len);
+		copy[len] = 0;
+		key = copy;
+	}else{
+		ret = malloc(sizeof *ret);
+	}
+	
 	ret->key = key;
 	ret->item = item;
+	ret->len = len;
+	ret->hash = hash;
+	stringmap__setPrefix(ret);
 	return ret;
 }
 
+/**
+ * @private
+ *
+ * Allocs and inits a stringmap_s for a key of len bytes.
+ */
+static inline stringmap_s * stringmap__mkn(hashtab_s * ht, const char * key,
+		size_t len, void * item){
+	return stringmap__mkh(ht, key, len, stringmap__keyHash(ht, key, len), item);
+}
+
+/**
+ * @private
+ *
+ * The make-callback: makes an entry for the searched key (and its hash).
+ */
+static void * stringmap__make(const void * v, void * vctx){
+	const stringmap_s * find = v;
+	struct stringmap__make * ctx = vctx;
+	
+	return stringmap__mkh(ctx->ht, find->key, find->len, find->hash, ctx->item);
+}
+
+/**
+ * @private
+ *
+ * The copy-callback: copies an entry, and in maps with an arena its key, into
+ * the arena given as ctx (if any).
+ */
+static void * stringmap__copy(const void * v, void * ctx){
+	const stringmap_s * sm = v;
+	stringmap_s * ret;
+	char * copy;
+	
+	if(ctx){
+		ret = stringmap__arenaAlloc(ctx, sizeof *ret + sm->len + 1);
+		*ret = *sm;
+		copy = (char *)(ret + 1);
+		memcpy(copy, sm->key, sm->len + 1);
+		ret->key = copy;
+	}else{
+		ret = malloc(sizeof *ret);
+		*ret = *sm;
+	}
+	
+	return ret;
+}
+
+/**
+ * @private
+ *
+ * Inits an entry to find key with (without allocating it).
+ */
+static inline stringmap_s stringmap__key(const hashtab_s * ht, const char * key,
+		size_t len){
+	stringmap_s find;
+	
+	find.key = key;
+	find.item = NULL;
+	find.len = len;
+	find.hash = stringmap__keyHash(ht, key, len);
+	stringmap__setPrefix(&find);
+	
+	return find;
+}
+
 /**
  * Makes a HashTab for use by the stringmap functions. The parameters are the
  * same as those for hashtab_make. Callbacks are provided by stringmap.
@@ -134,6 +404,44 @@ static inline hashtab_s * stringmap_make(size_t sz, float treshold, size_t moveR
 	return hashtab_make(sz, stringmap__hash, stringmap__cmp, treshold, moveR, shrink);
 }
 
+/**
+ * Makes a seeded HashTab for use by the stringmap functions (see
+ * hashtab_makeSeeded), for maps with keys from outside, like the headers of
+ * requests: keys are hashed with a random seed of the map, and it's reseeded
+ * if they collide all the same. The parameters are the same as for
+ * stringmap_make.
+ *
+ * @param sz The initial size.
+ * @param treshold The load threshold for resizement.
+ * @param moveR The move-rate.
+ * @param shrink Whether to shrink.
+ * @return A hashtab_s for use by the stringmap functions.
+ */
+static inline hashtab_s * stringmap_makeSeeded(size_t sz, float treshold, size_t moveR, size_t shrink){
+	return hashtab_makeSeeded(sz, stringmap__hashSeeded, stringmap__cmp, treshold, moveR, shrink, 0);
+}
+
+/**
+ * Makes a HashTab for use by the stringmap functions that copies the keys (and
+ * allocates its entries) in an arena of its own. Hence keys need not remain
+ * allocated after adding them, and stringmap_free frees all keys and entries at
+ * once. Memory of removed entries is only reclaimed by stringmap_free. The
+ * arena is kept in the hashtab's ctx, so it must not be used otherwise.
+ *
+ * @param sz The initial size.
+ * @param treshold The load threshold for resizement.
+ * @param moveR The move-rate.
+ * @param shrink Whether to shrink.
+ * @return A hashtab_s for use by the stringmap functions.
+ */
+static inline hashtab_s * stringmap_makeArena(size_t sz, float treshold, size_t moveR, size_t shrink){
+	hashtab_s * ht = stringmap_make(sz, treshold, moveR, shrink);
+	
+	stringmap__arenaAlloc(&ht->ctx, 0);
+	
+	return ht;
+}
+
 /**
  * Add an item to the stringmap.
  *
@@ -143,7 +451,25 @@ static inline hashtab_s * stringmap_make(size_t sz, float treshold, size_t moveR
  * @return A stringmap_s item containing the key/value pair.
  */
 static inline stringmap_s * stringmap_add(hashtab_s * ht, const char * key, void * item){
-	stringmap_s * ret = stringmap__mk(key, item);
+	stringmap_s * ret = stringmap__mkn(ht, key, strlen(key), item);
+	
+	hashtab_add(ht, ret);
+	
+	return ret;
+}
+
+/**
+ * Add an item to the stringmap, with a key of len bytes that need not be
+ * NUL-terminated.
+ *
+ * @param ht The hashtab/stringmap to add to.
+ * @param key The key.
+ * @param len The length of the key.
+ * @param item The item.
+ * @return A stringmap_s item containing the key/value pair.
+ */
+static inline stringmap_s * stringmap_addn(hashtab_s * ht, const char * key, size_t len, void * item){
+	stringmap_s * ret = stringmap__mkn(ht, key, len, item);
 	
 	hashtab_add(ht, ret);
 	
@@ -158,16 +484,87 @@ static inline stringmap_s * stringmap_add(hashtab_s * ht, const char * key, void
  * @param key The key.
  * @param item The item.
  * @return If an item with the same key existed, its key/item pair is returned,
- *         otherwise NULL.
+ *         otherwise NULL. It's no longer in the map, free it (unless the map
+ *         was made with stringmap_makeArena, whose entries belong to its arena).
  */
 static inline stringmap_s * stringmap_insert(hashtab_s * ht, const char * key, void * item){
-	stringmap_s * ret = stringmap__mk(key, item);
+	stringmap_s * ret = stringmap__mkn(ht, key, strlen(key), item);
 	
 	stringmap_s * found = hashtab_insert(ht, ret);
 	
 	return found;
 }
 
+/**
+ * Set the item of a key in the stringmap. If the key already exists its item
+ * is replaced by the new one (and the existing key and entry are kept),
+ * otherwise it's added. Unlike stringmap_insert the map is searched only once,
+ * and no entry is allocated for an existing key.
+ *
+ * @param ht The hashtab/stringmap to add to.
+ * @param key The key.
+ * @param item The item.
+ * @return If the key existed, its previous item is returned, otherwise NULL.
+ */
+static inline void * stringmap_set(hashtab_s * ht, const char * key, void * item){
+	stringmap_s find = stringmap__key(ht, key, strlen(key));
+	struct stringmap__make mkCtx = {ht, item};
+	int inserted;
+	stringmap_s * found = hashtab_findOrInsert(ht, &find, stringmap__make,
+			&mkCtx, &inserted);
+	void * ret = NULL;
+	
+	if(!inserted){
+		ret = found->item;
+		found->item = item;
+	}
+	
+	return ret;
+}
+
+/**
+ * Find the entry of a key of len bytes (that need not be NUL-terminated), or
+ * add one with the given item if there is none. The map is searched once, and
+ * an entry is only allocated when it's added. Update the item of the returned
+ * entry to change the value for the key, e.g. to count occurrences of keys:
+ *
+ * @code{.c}
+ * stringmap_s * e = stringmap_findOrInsertn(ht, word, len, NULL, NULL);
+ * e->item = (void *)((uintptr_t)e->item + 1);
+ * @endcode
+ *
+ * @param ht The hashtab/stringmap to search in (or add to).
+ * @param key The key.
+ * @param len The length of the key.
+ * @param item The item for the key, if it's added.
+ * @param [out] inserted Set to 1 if the key was added, otherwise to 0. May be
+ *        NULL.
+ * @return The entry of the key, new or existing.
+ */
+static inline stringmap_s * stringmap_findOrInsertn(hashtab_s * ht, const char * key,
+		size_t len, void * item, int * inserted){
+	stringmap_s find = stringmap__key(ht, key, len);
+	struct stringmap__make mkCtx = {ht, item};
+	
+	return hashtab_findOrInsert(ht, &find, stringmap__make, &mkCtx, inserted);
+}
+
+/**
+ * Find the entry of a key, or add one with the given item if there is none.
+ * See stringmap_findOrInsertn.
+ *
+ * @param ht The hashtab/stringmap to search in (or add to).
+ * @param key The key.
+ * @param item The item for the key, if it's added.
+ * @param [out] inserted Set to 1 if the key was added, otherwise to 0. May be
+ *        NULL.
+ * @return The entry of the key, new or existing.
+ */
+static inline stringmap_s * stringmap_findOrInsert(hashtab_s * ht, const char * key,
+		void * item, int * inserted){
+	return stringmap_findOrInsertn(ht, key, strlen(key), item, inserted);
+}
+
 /**
  * Find an item by its key in the stringmap.
  *
@@ -176,7 +573,27 @@ static inline stringmap_s * stringmap_insert(hashtab_s * ht, const char * key, v
  * @return The corresponding item, or NULL if there is none with that key.
  */
 static inline void * stringmap_find(hashtab_s * ht, const char * key){
-	stringmap_s find = {key, NULL};
+	stringmap_s find = stringmap__key(ht, key, strlen(key));
+	stringmap_s * found = hashtab_find(ht, &find);
+	
+	if(found){
+		return found->item;
+	}
+	
+	return NULL;
+}
+
+/**
+ * Find an item by a key of len bytes, that need not be NUL-terminated (such as
+ * a slice of a larger buffer).
+ *
+ * @param ht The hashtab/stringmap to search in.
+ * @param key The key to search for.
+ * @param len The length of the key.
+ * @return The corresponding item, or NULL if there is none with that key.
+ */
+static inline void * stringmap_findn(hashtab_s * ht, const char * key, size_t len){
+	stringmap_s find = stringmap__key(ht, key, len);
 	stringmap_s * found = hashtab_find(ht, &find);
 	
 	if(found){
@@ -194,18 +611,142 @@ static inline void * stringmap_find(hashtab_s * ht, const char * key){
  * @return The item that's been removed, or NULL if there is none with that key.
  */
 static inline void * stringmap_remove(hashtab_s * ht, const char * key){
-	stringmap_s find = {key, NULL};
+	stringmap_s find = stringmap__key(ht, key, strlen(key));
 	stringmap_s * found = hashtab_remove(ht, &find);
 	void * ret = NULL;
 	
 	if(found){
 		ret = found->item;
-		free(found);
+		if(!hashtab_ctx(ht)){
+			free(found);
+		}
+	}
+	
+	return ret;
+}
+
+/**
+ * Copy the stringmap: the copy has entries of its own (and in maps made with
+ * stringmap_makeArena an arena of its own, with copies of the keys), so either
+ * map can be changed or freed with stringmap_free independently of the other.
+ * The items are not copied. Don't copy stringmaps with hashtab_copy, whose
+ * copy would share the entries (and arena) with the original.
+ *
+ * @param ht The hashtab/stringmap to copy.
+ * @return The copy.
+ */
+static inline hashtab_s * stringmap_copy(const hashtab_s * ht){
+	void * arena = NULL;
+	hashtab_s * ret;
+	
+	if(hashtab_ctx(ht)){
+		stringmap__arenaAlloc(&arena, 0);
 	}
 	
+	ret = hashtab_copy(ht, stringmap__copy, hashtab_ctx(ht) ? &arena : NULL);
+	ret->ctx = arena;
+	
 	return ret;
 }
 
+/**
+ * @private
+ *
+ * The context of the merge-callbacks.
+ */
+struct stringmap__merge{
+	void (*combine)(const char * key, void * item, void * other, void * ctx);
+	void * ctx;
+	void ** entries;
+	size_t n;
+};
+
+/**
+ * @private
+ *
+ * The combine-callback for maps without arenas: the entry of src isn't added,
+ * so it's freed.
+ */
+static void stringmap__combine(void * item, void * other, void * vctx){
+	stringmap_s * sm = item, * o = other;
+	struct stringmap__merge * ctx = vctx;
+	
+	ctx->combine(sm->key, sm->item, o->item, ctx->ctx);
+	free(other);
+}
+
+/**
+ * @private
+ *
+ * ForEach-callback collecting the entries of a map.
+ */
+static void stringmap__collect(void * v, void * vctx){
+	struct stringmap__merge * ctx = vctx;
+	
+	ctx->entries[ctx->n++] = v;
+}
+
+/**
+ * Move all keys and items of one stringmap into another, leaving the first one
+ * empty, like hashtab_merge. Into maps made with stringmap_makeArena the
+ * entries (and keys) of src are copied, into the arena of dst, so src can be
+ * freed afterwards. Don't merge stringmaps with hashtab_merge, which would leave the
+ * entries of src in dst (arena and all).
+ *
+ * @param dst The hashtab/stringmap to move the keys to.
+ * @param src The hashtab/stringmap to take them from. If it was made with
+ *        stringmap_makeArena, dst must have been as well (the entries of other
+ *        maps don't own their keys): otherwise nothing is merged.
+ * @param combine If not NULL, for every key of src that is in dst already:
+ *        called with the key, the item of dst and the item of src, and the key
+ *        of src is not added. If NULL all keys are added, like stringmap_add.
+ * @param ctx An additional context-pointer for the callback.
+ * @return The number of keys added to dst.
+ */
+static inline size_t stringmap_merge(hashtab_s * dst, hashtab_s * src,
+		void (*combine)(const char * key, void * item, void * other,
+		void * ctx), void * ctx){
+	struct stringmap__merge mgCtx = {combine, ctx, NULL, 0};
+	stringmap_s * sm, * found, find;
+	size_t i, n = 0;
+	
+	/* Entries can be moved as they are if they're alike, and hashed alike. */
+	if(!hashtab_ctx(dst) && !hashtab_ctx(src) &&
+			!dst->seededHasher == !src->seededHasher){
+		return hashtab_merge(dst, src, combine ? stringmap__combine : NULL,
+				&mgCtx);
+	}
+	if(hashtab_ctx(src) && !hashtab_ctx(dst)){
+		return 0;
+	}
+	
+	mgCtx.entries = malloc((hashtab_length(src) + 1) * sizeof *mgCtx.entries);
+	hashtab_forEach(src, stringmap__collect, &mgCtx);
+	hashtab_reserve(dst, hashtab_length(dst) + mgCtx.n);
+	
+	for(i = 0; i < mgCtx.n; i++){
+		sm = mgCtx.entries[i];
+		
+		find = stringmap__key(dst, sm->key, sm->len);
+		
+		if(combine && (found = hashtab_find(dst, &find))){
+			combine(found->key, found->item, sm->item, ctx);
+		}else{
+			hashtab_add(dst, stringmap__mkn(dst, sm->key, sm->len, sm->item));
+			++n;
+		}
+		
+		hashtab_remove(src, sm);
+		if(!hashtab_ctx(src)){
+			free(sm);
+		}
+	}
+	
+	free(mgCtx.entries);
+	
+	return n;
+}
+
 /**
  * Call a function for every item in the stringmap.
  *
@@ -215,7 +756,7 @@ static inline void * stringmap_remove(hashtab_s * ht, const char * key){
  */
 static inline void stringmap_forEach(hashtab_s * ht, void (*cb)(const char * key,
 		void * item, void * ctx), void * ctx){
-	struct stringmap__cb feCtx = {cb, ctx};
+	struct stringmap__cb feCtx = {cb, ctx, 0};
 	
 	hashtab_forEach(ht, stringmap__forEach, &feCtx);
 }
@@ -230,9 +771,15 @@ static inline void stringmap_forEach(hashtab_s * ht, void (*cb)(const char * key
  */
 static inline void stringmap_free(hashtab_s * ht, void (*cb)(const char * key,
 		void * item, void * ctx), void * ctx){
-	struct stringmap__cb frCtx = {cb, ctx};
+	struct stringmap__cb frCtx = {cb, ctx, hashtab_ctx(ht) != NULL};
+	struct stringmap__block * block = hashtab_ctx(ht), * next;
 	
 	hashtab_free(ht, stringmap__free, &frCtx);
+	
+	for(; block; block = next){
+		next = block->next;
+		free(block);
+	}
 }
 
 #endif
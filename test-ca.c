@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "hashtab.h"
+#include "hashtab_cache.h"
+
+#define ITEMS 10000
+#define MAX 1000
+
+typedef struct{
+	hashtab_cache_node_s node;
+	int key;
+} entry_s;
+
+size_t entryHash(const void * v){
+	return ((const entry_s*)v)->key;
+}
+
+int entryCmp(const void * va, const void * vb){
+	return ((const entry_s*)va)->key - ((const entry_s*)vb)->key;
+}
+
+void count(void * item, void * ctx){
+	++*(size_t*)ctx;
+}
+
+int main(){
+	size_t evicted = 0, fails = 0;
+	hashtab_cache_s * c = hashtab_cacheMake(64, entryHash, entryCmp, 0.75, 4,
+			HASHTAB_POW2 | HASHTAB_MIX, offsetof(entry_s, node), MAX, 0, count,
+			&evicted);
+	entry_s * entries = malloc(ITEMS * sizeof *entries), key;
+	struct timespec wait = {0, 2000000};
+	
+	for(int i = 0; i < ITEMS; i++){
+		entries[i].key = i;
+		hashtab_cachePut(c, entries + i, sizeof *entries, 0);
+		
+		/* Keep using the first item, so it's never the least recent */
+		key.key = 0;
+		if(hashtab_cacheGet(c, &key) != entries){
+			++fails;
+		}
+	}
+	
+	/* The first item, and the most recent others are left */
+	for(int i = ITEMS - MAX + 1; i < ITEMS; i++){
+		key.key = i;
+		if(hashtab_cacheGet(c, &key) != entries + i){
+			++fails;
+		}
+	}
+	key.key = ITEMS - MAX;
+	if(hashtab_cacheGet(c, &key)){
+		++fails;
+	}
+	printf("Length: %zu, evicted: %zu, expected: %i, %i\n",
+			hashtab_cacheLength(c), evicted, MAX, ITEMS - MAX);
+	
+	/* Items with a time to live of 1 ms expire (and push the others out) */
+	for(int i = 0; i < MAX; i++){
+		hashtab_cachePut(c, entries + i, sizeof *entries, 1000000);
+	}
+	nanosleep(&wait, NULL);
+	key.key = 1;
+	if(hashtab_cacheGet(c, &key)){
+		++fails;
+	}
+	hashtab_cacheExpire(c, MAX);
+	printf("Length after expiry: %zu, bytes: %zu, evicted: %zu, expected: "
+			"0, 0, %i\n", hashtab_cacheLength(c), hashtab_cacheBytes(c),
+			evicted, ITEMS + MAX - 1);
+	
+	fails += hashtab_cacheLength(c) != 0 || hashtab_cacheBytes(c) != 0 ||
+			evicted != ITEMS + MAX - 1;
+	
+	hashtab_cacheFree(c, NULL, NULL);
+	free(entries);
+	
+	return fails != 0;
+}
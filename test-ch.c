@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "chashtab.h"
+
+#define THREADS 4
+#define ITEMS 100000
+
+size_t intHash(const void * v){
+	return *(const int*)v;
+}
+
+int intCmp(const void * va, const void * vb){
+	return *(const int*)va - *(const int*)vb;
+}
+
+chashtab_s * ht;
+int items[THREADS][ITEMS];
+
+/* Every thread adds its own items, finds them all and removes half of them */
+void * work(void * arg){
+	int (*mine)[ITEMS] = arg;
+	size_t missing = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		(*mine)[i] = (mine - items) * ITEMS + i;
+		chashtab_add(ht, *mine + i); // &(*mine)[i]
+	}
+	for(int i = 0; i < ITEMS; i++){
+		if(chashtab_find(ht, *mine + i) != *mine + i){
+			++missing;
+		}
+	}
+	for(int i = 0; i < ITEMS; i += 2){
+		chashtab_remove(ht, *mine + i);
+	}
+	
+	return (void*) missing;
+}
+
+void count(void * item, void * ctx){
+	++*(size_t*)ctx;
+}
+
+int main(){
+	size_t size = 8, moveR = 4, stripes = 0, n = 0, failed = 0;
+	float threshold = 0.75;
+	pthread_t threads[THREADS];
+	
+	ht = chashtab_make(size, intHash, intCmp, threshold, moveR, stripes);
+	
+	for(int t = 0; t < THREADS; t++){
+		pthread_create(threads + t, NULL, work, items + t);
+	}
+	for(int t = 0; t < THREADS; t++){
+		void * missing;
+		pthread_join(threads[t], &missing);
+		failed += (size_t) missing;
+		printf("Thread %i: %zu missing\n", t, (size_t) missing);
+	}
+	
+	chashtab_forEach(ht, count, &n);
+	printf("Length: %zu, counted: %zu, expected: %i\n", chashtab_length(ht), n,
+		THREADS * ITEMS / 2);
+	failed += chashtab_length(ht) != THREADS * ITEMS / 2 ||
+			n != THREADS * ITEMS / 2;
+	
+	/* Clean up. No freeing needed for the items here */
+	chashtab_free(ht, NULL, NULL);
+	
+	return failed != 0;
+}
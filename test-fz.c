@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hashtab.h"
+#include "hashtab_frozen.h"
+#include "stringmap.h"
+
+/* Stored as the key (with its '\0') followed by the value */
+size_t serialize(const void * item, void * buf, size_t n, void * ctx){
+	const stringmap_s * sm = item;
+	size_t len = sm->len + 1 + sizeof(int);
+	
+	if(len <= n){
+		memcpy(buf, sm->key, sm->len + 1);
+		memcpy((char*) buf + sm->len + 1, sm->item, sizeof(int));
+	}
+	
+	return len;
+}
+
+/* The frozen table is searched with plain keys, hashed as stringmap does */
+size_t keyHash(const void * item){
+	const char * key = item;
+	return STRINGMAP_HASH(key, strlen(key));
+}
+
+int keyCmp(const void * item, const void * data, size_t len){
+	return strcmp(item, data);
+}
+
+int main(){
+	size_t size = 8, moveR = 4;
+	int shrink = 1;
+	float threshold = 0.75;
+	const char * path = "test-fz.tab";
+	
+	const char * keys[] = {"Alef", "Bet", "Gimel", "Dalet", "He", "Vav", 
+			"Zayin", "Het", "Tet", "Yod", "Kaf", "Lamed", "Mem", "Nun", 
+			"Samekh", "Ayin", "Pe", "Tsadi", "Qof", "Resh", "Shin", "Tav"};
+	size_t len = sizeof keys / sizeof *keys;
+	
+	int values[sizeof keys / sizeof *keys] = {0};
+	
+	srand(0);
+	
+	hashtab_s * ht = stringmap_make(size, threshold, moveR, shrink);
+	for(size_t i = 0; i < len; i++){
+		values[i] = rand() % 100;
+		stringmap_add(ht, keys[i], values + i); // &values[i]
+	}
+	
+	/* Freeze the stringmap into a file */
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0 || hashtab_freeze(ht, fd, serialize, NULL) || close(fd)){
+		perror(path);
+		return 1;
+	}
+	stringmap_free(ht, NULL, NULL);
+	
+	/* Map it (as another process would) and look up every key, and one more */
+	hashtab_frozen_s * ft = hashtab_openMmap(path, keyHash, keyCmp);
+	if(!ft){
+		perror(path);
+		return 1;
+	}
+	
+	for(size_t i = 0; i <= len; i++){
+		const char * key = i < len ? keys[i] : "Nope";
+		const char * found = hashtab_frozenFind(ft, key, NULL);
+		int value;
+		
+		if(found){ // != NULL
+			memcpy(&value, found + strlen(found) + 1, sizeof value);
+			printf("Found: %s = %i%s\n", key, value,
+				i < len && value == values[i] ? "" : " (wrong)");
+		}else{
+			printf("Not found: %s\n", key);
+		}
+	}
+	printf("Length: %zu\n", hashtab_frozenLength(ft));
+	
+	hashtab_frozenClose(ft);
+	
+	/* A seeded map can't be frozen: its seed is random */
+	ht = stringmap_makeSeeded(size, threshold, moveR, shrink);
+	stringmap_add(ht, keys[0], values);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0 || hashtab_freeze(ht, fd, serialize, NULL) != -1){
+		printf("Froze a seeded map\n");
+		return 1;
+	}
+	close(fd);
+	stringmap_free(ht, NULL, NULL);
+	
+	unlink(path);
+	
+	return 0;
+}
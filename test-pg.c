@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "hashtab.h"
+#include "hashtab_pages.h"
+
+#define ITEMS 1000000
+
+size_t intHash(const void * v){
+	return *(const int*)v;
+}
+
+int intCmp(const void * va, const void * vb){
+	return *(const int*)va - *(const int*)vb;
+}
+
+int main(){
+	/* Huge pages spread over all nodes, faulted in when allocated */
+	hashtab_pages_s pages = {HASHTAB_PAGES_THP | HASHTAB_PAGES_INTERLEAVE |
+			HASHTAB_PAGES_PREFAULT, -1, 0, 0};
+	hashtab_alloc_s alloc = hashtab_pagesAlloc(&pages);
+	hashtab_s * ht = hashtab_makeAlloc(1 << 16, intHash, intCmp, 0.75, 64, 0,
+			HASHTAB_POW2 | HASHTAB_MIX, &alloc);
+	int * items = malloc(ITEMS * sizeof *items);
+	size_t missing = 0, prepared = 0;
+	hashtab_stats_s stats;
+	
+	for(int i = 0; i < ITEMS; i++){
+		items[i] = i;
+		
+		/* Nearly full: make the next table now, not in the add that grows */
+		if(hashtab_load(ht) > 0.7 && hashtab_prepareGrow(ht)){
+			++prepared;
+		}
+		
+		hashtab_add(ht, items + i); // &items[i]
+	}
+	for(int i = 0; i < ITEMS; i++){
+		if(hashtab_find(ht, items + i) != items + i){
+			++missing;
+		}
+	}
+	
+	hashtab_stats(ht, &stats);
+	printf("Length: %zu, size: %zu, grows: %zu, missing: %zu\n",
+			hashtab_length(ht), stats.size, ht->grows, missing);
+	printf("Prepared ahead: %s\n", prepared ? "yes" : "no");
+	
+	hashtab_free(ht, NULL, NULL);
+	free(items);
+	
+	return missing != 0;
+}
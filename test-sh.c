@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "hashtab.h"
+#include "hashtab_shard.h"
+
+#define SHARDS 16
+#define THREADS 4
+#define ITEMS 1000000
+
+size_t intHash(const void * v){
+	return *(const int*)v;
+}
+
+int intCmp(const void * va, const void * vb){
+	return *(const int*)va - *(const int*)vb;
+}
+
+void count(void * item, void * ctx){
+	++*(size_t*)ctx;
+}
+
+int main(){
+	hashtab_shard_s * sh = hashtab_shardMake(SHARDS, 1024, intHash, intCmp,
+			0.75, 4, 0, HASHTAB_POW2 | HASHTAB_MIX);
+	int * items = malloc(ITEMS * sizeof *items);
+	void ** ptrs = malloc(ITEMS * sizeof *ptrs);
+	size_t missing = 0, n = 0;
+	hashtab_shard_stats_s stats;
+	
+	for(int i = 0; i < ITEMS; i++){
+		items[i] = i;
+		ptrs[i] = items + i; // &items[i]
+	}
+	
+	/* Partition the items by shard, and build every shard on its own thread */
+	hashtab_shardBuild(sh, ptrs, ITEMS, THREADS);
+	
+	for(int i = 0; i < ITEMS; i++){
+		if(hashtab_shardFind(sh, items + i) != items + i){
+			++missing;
+		}
+	}
+	for(int i = 0; i < ITEMS; i += 2){
+		hashtab_shardRemove(sh, items + i);
+	}
+	
+	hashtab_shardForEach(sh, count, &n);
+	hashtab_shardStats(sh, &stats);
+	printf("Length: %zu, counted: %zu, expected: %i, missing: %zu\n",
+			hashtab_shardLength(sh), n, ITEMS / 2, missing);
+	printf("Shards: %zu, items per shard: %zu - %zu, grows: %zu\n",
+			hashtab_shardCount(sh), stats.minLength, stats.maxLength,
+			stats.grows);
+	
+	hashtab_shardFree(sh, NULL, NULL);
+	free(ptrs);
+	free(items);
+	
+	return missing != 0 || n != ITEMS / 2;
+}
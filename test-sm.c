@@ -5,6 +5,11 @@
 #include "GeneralHashFunctions.h"
 #include "stringmap.h"
 
+/* Combine callback for merges: counts the keys in both maps */
+void count(const char * key, void * item, void * other, void * ctx){
+	++*(size_t*)ctx;
+}
+
 int main(){
 	size_t size = 8, moveR = 4;
 	int shrink = 1;
@@ -16,6 +21,7 @@ int main(){
 	size_t len = sizeof keys / sizeof *keys;
 	
 	int values[sizeof keys / sizeof *keys] = {0};
+	size_t merged = 0;
 	
 	srand(0);
 	
@@ -30,6 +36,48 @@ int main(){
 		stringmap_add(ht, keys[i], values + i); // &values[i]
 	}
 	
+	/* Replace a value: insert returns the replaced entry, set the item */
+	int other = -1;
+	stringmap_s * old = stringmap_insert(ht, keys[0], &other);
+	if(!old || old->item != values || stringmap_set(ht, keys[0], values) != &other){
+		printf("Replacing %s failed\n", keys[0]);
+		return 1;
+	}
+	free(old);
+	
+	/* A copy of an arena map has keys of its own */
+	hashtab_s * arena = stringmap_makeArena(size, threshold, moveR, shrink);
+	for(size_t i = 0; i < len; i++){
+		stringmap_add(arena, keys[i], values + i);
+	}
+	hashtab_s * copy = stringmap_copy(arena);
+	stringmap_free(arena, NULL, NULL);
+	for(size_t i = 0; i < len; i++){
+		if(stringmap_find(copy, keys[i]) != values + i){
+			printf("Copy lost %s\n", keys[i]);
+			return 1;
+		}
+	}
+	
+	/* Merging arena maps copies the keys: the source can be freed */
+	hashtab_s * src = stringmap_makeArena(size, threshold, moveR, shrink);
+	for(size_t i = 0; i < len; i++){
+		stringmap_add(src, keys[i], values + i);
+	}
+	stringmap_merge(copy, src, count, &merged);
+	stringmap_free(src, NULL, NULL);
+	for(size_t i = 0; i < len; i++){
+		if(stringmap_find(copy, keys[i]) != values + i){
+			printf("Merge lost %s\n", keys[i]);
+			return 1;
+		}
+	}
+	if(merged != len || hashtab_length(copy) != len){
+		printf("Merge combined %zu keys\n", merged);
+		return 1;
+	}
+	stringmap_free(copy, NULL, NULL);
+	
 	printf("Find key (empty line to quit): "); fflush(stdout);
 	char key[128] = {0};
 	while(fgets(key, sizeof key, stdin) && key[0] != '\n'){
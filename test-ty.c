@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "GeneralHashFunctions.h"
+#include "hashtab_typed.h"
+
+/* Hash callback, gets the key itself rather than a pointer to an item */
+static size_t strHash(const char * key){
+	return ELFHash(key, strlen(key));
+}
+
+/* Equality callback, may just as well be a function */
+#define strEq(a, b) (strcmp(a, b) == 0)
+
+/* Defines lettermap_s and the lettermap_* functions, mapping strings to ints */
+HASHTAB_DEFINE(lettermap, const char *, int, strHash, strEq)
+
+/* ForEach callback */
+static void printLetter(const char * const * key, int * value, void * ctx){
+	printf("%s = %i\n", *key, *value);
+}
+
+int main(){
+	size_t size = 8, moveR = 4;
+	float threshold = 0.75;
+	
+	const char * keys[] = {"Alef", "Bet", "Gimel", "Dalet", "He", "Vav", 
+			"Zayin", "Het", "Tet", "Yod", "Kaf", "Lamed", "Mem", "Nun", 
+			"Samekh", "Ayin", "Pe", "Tsadi", "Qof", "Resh", "Shin", "Tav"};
+	size_t len = sizeof keys / sizeof *keys;
+	
+	lettermap_s * lm = lettermap_make(size, threshold, moveR);
+	
+	/* Keys and values are stored by value: the ints are copied, the strings
+	   (pointers) must remain allocated as long as they are in the map. */
+	for(size_t i = 0; i < len; i++){
+		lettermap_add(lm, keys[i], (int) i + 1);
+	}
+	
+	int * found = lettermap_find(lm, "Gimel");
+	if(found){ // != NULL
+		printf("Found: Gimel = %i\n", *found);
+	}
+	
+	lettermap_insert(lm, "Gimel", 30); /* replaces the value */
+	lettermap_remove(lm, "Tav", NULL);
+	
+	lettermap_forEach(lm, printLetter, NULL);
+	printf("Length: %u\n", (unsigned) lettermap_length(lm));
+	
+	lettermap_free(lm);
+	
+	return 0;
+}
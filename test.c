@@ -54,6 +54,580 @@ void * KVcopy(const void * v, void * ctx){
 	return ret;
 }
 
+/* Number of failed checks */
+int failed = 0;
+
+/* Check a condition, and report it if it doesn't hold */
+#define CHECK(cond) do{ \
+		if(!(cond)){ \
+			printf("Check failed, line %i: %s\n", __LINE__, #cond); \
+			++failed; \
+		} \
+	}while(0)
+
+/* Number of int items for the checks */
+#define ITEMS 4096
+
+/* Int hash callback, the identity: tables that need spread bits mix it */
+size_t intHash(const void * v){
+	return (size_t) *(const int*)v;
+}
+
+/* Seeded int hash callback */
+size_t intHashSeeded(const void * v, size_t seed){
+	return hashtab_mix((size_t) *(const int*)v ^ seed);
+}
+
+/* Int comparison callback */
+int intCmp(const void * va, const void * vb){
+	return *(const int*)va - *(const int*)vb;
+}
+
+/* Marks an int item as visited, ctx is an array of counts */
+void intMark(void * item, void * ctx){
+	++((unsigned char*)ctx)[*(int*)item];
+}
+
+/* Make callback for findOrInsert: the item of the key, from ctx */
+void * intMake(const void * key, void * ctx){
+	return (int*)ctx + *(const int*)key;
+}
+
+/* Check that exactly the items marked in `in` were visited (at least once) */
+void checkVisited(const unsigned char * in, const unsigned char * seen){
+	size_t missed = 0, extra = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		missed += in[i] && !seen[i];
+		extra += !in[i] && seen[i];
+	}
+	
+	CHECK(missed == 0);
+	CHECK(extra == 0);
+}
+
+/* Items are found after adding, replaced by insert and gone after removing */
+void checkKind(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 1, flags);
+	int other[ITEMS], missing = ITEMS;
+	size_t found = 0, replaced = 0, removed = 0, left = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	CHECK(hashtab_length(ht) == ITEMS);
+	if(flags & HASHTAB_POW2){
+		CHECK((hashtab_size(ht) & (hashtab_size(ht) - 1)) == 0);
+	}
+	for(int i = 0; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS);
+	CHECK(hashtab_find(ht, &missing) == NULL);
+	
+	/* Insert equal items in place of the even ones */
+	for(int i = 0; i < ITEMS; i += 2){
+		other[i] = i;
+		replaced += hashtab_insert(ht, other + i) == items + i;
+	}
+	CHECK(replaced == ITEMS / 2);
+	CHECK(hashtab_length(ht) == ITEMS);
+	CHECK(hashtab_find(ht, items) == other);
+	
+	/* Remove three in four items, so the table shrinks */
+	for(int i = 0; i < ITEMS; i++){
+		if(i % 4){
+			removed += hashtab_remove(ht, items + i) ==
+					(i % 2 ? items + i : other + i);
+		}
+	}
+	CHECK(removed == ITEMS - ITEMS / 4);
+	CHECK(hashtab_length(ht) == ITEMS / 4);
+	for(int i = 0; i < ITEMS; i++){
+		left += hashtab_find(ht, items + i) == (i % 4 ? NULL : other + i);
+	}
+	CHECK(left == ITEMS);
+	CHECK(hashtab_remove(ht, &missing) == NULL);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Batches find, add and remove the same items as one by one */
+void checkBatch(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 1, flags);
+	void ** ptrs = malloc(ITEMS * sizeof *ptrs), ** out = malloc(ITEMS *
+			sizeof *out);
+	size_t right = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		ptrs[i] = items + i;
+	}
+	
+	/* Add the first half, then find all: only the first half is there */
+	CHECK(hashtab_addMany(ht, ptrs, ITEMS / 2) == ITEMS / 2);
+	CHECK(hashtab_findMany(ht, (const void * const *) ptrs, out, ITEMS) ==
+			ITEMS / 2);
+	for(int i = 0; i < ITEMS; i++){
+		right += out[i] == (i < ITEMS / 2 ? items + i : NULL);
+	}
+	CHECK(right == ITEMS);
+	
+	/* Remove every other item of the first half, and some missing ones */
+	for(int i = 0; i < ITEMS / 2; i++){
+		ptrs[i] = items + 2 * i;
+	}
+	CHECK(hashtab_removeMany(ht, (const void * const *) ptrs, out, ITEMS / 2) ==
+			ITEMS / 4);
+	right = 0;
+	for(int i = 0; i < ITEMS / 2; i++){
+		right += out[i] == (2 * i < ITEMS / 2 ? items + 2 * i : NULL);
+		right += hashtab_find(ht, items + i) == (i % 2 ? items + i : NULL);
+	}
+	CHECK(right == ITEMS);
+	CHECK(hashtab_length(ht) == ITEMS / 4);
+	
+	hashtab_free(ht, NULL, NULL);
+	free(out);
+	free(ptrs);
+}
+
+/* Reserved and built tables hold their items without growing */
+void checkReserve(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 0, flags);
+	void ** ptrs = malloc(ITEMS * sizeof *ptrs);
+	size_t size, found = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		ptrs[i] = items + i;
+	}
+	
+	size = hashtab_reserve(ht, ITEMS);
+	CHECK(size == hashtab_size(ht));
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	CHECK(hashtab_size(ht) == size);
+	CHECK(hashtab_grows(ht) == 0);
+	hashtab_free(ht, NULL, NULL);
+	
+	ht = hashtab_fromArray(ptrs, ITEMS, intHash, intCmp, 0.75, 4, 0, flags);
+	CHECK(hashtab_length(ht) == ITEMS);
+	for(int i = 0; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS);
+	
+	/* It goes on like any other table */
+	CHECK(hashtab_remove(ht, items) == items);
+	CHECK(hashtab_find(ht, items) == NULL);
+	hashtab_free(ht, NULL, NULL);
+	free(ptrs);
+}
+
+/* Statistics count every item (and bucket) once, in a table that resizes at
+   once (so it's never migrating) */
+void checkStats(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 1, 0, flags);
+	hashtab_stats_s stats;
+	size_t counted = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	hashtab_stats(ht, &stats);
+	
+	CHECK(stats.length == ITEMS);
+	CHECK(stats.size == hashtab_size(ht));
+	CHECK(stats.otherSize == 0);
+	CHECK(stats.empty < stats.size);
+	CHECK(stats.maxProbe >= 1);
+	CHECK(stats.bytes > 0);
+	for(int i = 0; i < HASHTAB_STATS_CHAINS; i++){
+		counted += flags & HASHTAB_FLAT ? stats.chains[i] : i ?
+				stats.chains[i] : 0;
+	}
+	/* Chained tables count non-empty buckets, flat tables items */
+	CHECK(counted == (flags & HASHTAB_FLAT ? stats.length :
+			stats.size - stats.empty));
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Compiled tables find every item, and turn back into normal ones on adds */
+void checkCompiled(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 0, flags);
+	int other = 1, missing = ITEMS + 1;
+	size_t found = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	CHECK(hashtab_compile(ht) == 1);
+	CHECK(hashtab_length(ht) == ITEMS);
+	for(int i = 0; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS);
+	CHECK(hashtab_find(ht, &missing) == NULL);
+	
+	/* Replacing an item keeps the table compiled, adding one doesn't */
+	CHECK(hashtab_insert(ht, &other) == items + 1);
+	CHECK(hashtab_find(ht, items + 1) == &other);
+	hashtab_add(ht, &missing);
+	CHECK(hashtab_find(ht, &missing) == &missing);
+	CHECK(hashtab_remove(ht, items) == items);
+	CHECK(hashtab_length(ht) == ITEMS);
+	found = 0;
+	for(int i = 2; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS - 2);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* findOrInsert adds missing items once, and finds existing ones */
+void checkFindOrInsert(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 0, flags);
+	size_t right = 0, made = 0;
+	int inserted, key;
+	
+	for(int i = 0; i < ITEMS; i += 2){
+		hashtab_add(ht, items + i);
+	}
+	for(int round = 0; round < 2; round++){
+		for(int i = 0; i < ITEMS; i++){
+			key = i;
+			right += hashtab_findOrInsert(ht, &key, intMake, items,
+					&inserted) == items + i;
+			made += inserted;
+		}
+	}
+	CHECK(right == 2 * ITEMS);
+	CHECK(made == ITEMS / 2);
+	CHECK(hashtab_length(ht) == ITEMS);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Tables that leave migrating to migrateStep finish it there */
+void checkMigrateStep(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 0, 0, flags);
+	size_t found = 0, steps = 0;
+	
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+		if(i % 64 == 0){
+			hashtab_migrateStep(ht, 1000);
+		}
+	}
+	while(hashtab_migrateStep(ht, 1000000) && steps < 1000){
+		++steps;
+	}
+	CHECK(steps < 1000);
+	CHECK(hashtab_migrateStep(ht, 1000) == 0);
+	CHECK(hashtab_length(ht) == ITEMS);
+	for(int i = 0; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Seeded tables find their items with any seed */
+void checkSeeded(int * items, int flags){
+	hashtab_s * ht = hashtab_makeSeeded(8, intHashSeeded, intCmp, 0.75, 4, 1,
+			flags);
+	size_t found = 0, seed = ht->hashSeed;
+	
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	hashtab_reseed(ht);
+	CHECK(ht->reseeds == 1);
+	CHECK(ht->hashSeed != seed);
+	for(int i = 0; i < ITEMS; i++){
+		found += hashtab_find(ht, items + i) == items + i;
+	}
+	CHECK(found == ITEMS);
+	for(int i = 0; i < ITEMS; i += 2){
+		CHECK(hashtab_remove(ht, items + i) == items + i);
+	}
+	CHECK(hashtab_length(ht) == ITEMS / 2);
+	CHECK(hashtab_find(ht, items + 1) == items + 1);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* A snapshot keeps the items as they were, while the table changes */
+void checkSnapshot(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 1, flags);
+	hashtab_s * snap, * keep;
+	unsigned char in[ITEMS] = {0}, seen[ITEMS] = {0};
+	int other[ITEMS];
+	size_t right = 0, n;
+	
+	for(int i = 0; i < ITEMS / 2; i++){
+		hashtab_add(ht, items + i);
+		in[i] = 1;
+	}
+	snap = hashtab_snapshot(ht);
+	
+	/* Removing what isn't there leaves the shared chains be */
+	for(int i = ITEMS / 2; i < ITEMS; i++){
+		right += hashtab_remove(ht, items + i) == NULL;
+	}
+	CHECK(right == ITEMS / 2);
+	right = 0;
+	
+	/* Remove a third, replace a third and add the other half */
+	for(int i = 0; i < ITEMS / 2; i++){
+		other[i] = i;
+		if(i % 3 == 0){
+			hashtab_remove(ht, items + i);
+		}else if(i % 3 == 1){
+			hashtab_insert(ht, other + i);
+		}
+	}
+	for(int i = ITEMS / 2; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	
+	CHECK(hashtab_length(snap) == ITEMS / 2);
+	for(int i = 0; i < ITEMS; i++){
+		right += hashtab_find(snap, items + i) == (in[i] ? items + i : NULL);
+	}
+	CHECK(right == ITEMS);
+	hashtab_forEach(snap, intMark, seen);
+	checkVisited(in, seen);
+	
+	right = 0;
+	for(int i = 0; i < ITEMS; i++){
+		right += hashtab_find(ht, items + i) == (i >= ITEMS / 2 ? items + i :
+				i % 3 == 0 ? NULL : i % 3 == 1 ? other + i : items + i);
+	}
+	CHECK(right == ITEMS);
+	hashtab_free(snap, NULL, NULL);
+	
+	/* Compiling lets go of the links, but not of those a snapshot sees */
+	snap = hashtab_snapshot(ht);
+	for(int i = 1; i < ITEMS / 2; i += 3){
+		hashtab_remove(ht, other + i);
+	}
+	CHECK(hashtab_compile(ht) == 1);
+	right = 0;
+	for(int i = 1; i < ITEMS / 2; i += 3){
+		right += hashtab_find(snap, other + i) == other + i;
+		right += hashtab_find(ht, other + i) == NULL;
+	}
+	CHECK(right == 2 * ((ITEMS / 2 + 1) / 3));
+	hashtab_free(snap, NULL, NULL);
+	
+	/* Dropping most items at once leaves a snapshot whole as well */
+	snap = hashtab_snapshot(ht);
+	n = hashtab_length(ht);
+	keep = hashtab_make(8, intHash, intCmp, 0.75, 4, 1);
+	hashtab_add(keep, items);
+	hashtab_intersect(ht, keep, NULL, NULL);
+	CHECK(hashtab_length(ht) == 0 && hashtab_length(snap) == n);
+	right = 0;
+	for(int i = ITEMS / 2; i < ITEMS; i++){
+		right += hashtab_find(snap, items + i) == items + i;
+	}
+	CHECK(right == ITEMS / 2);
+	
+	hashtab_free(keep, NULL, NULL);
+	hashtab_free(snap, NULL, NULL);
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Combine callback for merge: counts the items that were in both */
+void intCombine(void * item, void * other, void * ctx){
+	++*(size_t*)ctx;
+}
+
+/* Count callback, ctx is a size_t */
+void intCount(void * item, void * ctx){
+	++*(size_t*)ctx;
+}
+
+/* Fills a table with a random part of the items, marked in `in` */
+hashtab_s * makeSome(int * items, unsigned char * in, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 1, flags);
+	
+	for(int i = 0; i < ITEMS; i++){
+		if((in[i] = rand() % 2)){
+			hashtab_add(ht, items + i);
+		}
+	}
+	
+	return ht;
+}
+
+/* Merge, intersect and difference against the same sets done by hand */
+void checkSets(int * items, int flags, int otherFlags){
+	unsigned char a[ITEMS], b[ITEMS], want[ITEMS], seen[ITEMS];
+	hashtab_s * ht, * other;
+	size_t both, inA, inB, n, called, twice;
+	
+	for(int op = 0; op < 3; op++){
+		ht = makeSome(items, a, flags);
+		other = makeSome(items, b, otherFlags);
+		both = inA = inB = called = twice = 0;
+		for(int i = 0; i < ITEMS; i++){
+			both += a[i] && b[i];
+			inA += a[i];
+			inB += b[i];
+			want[i] = op == 0 ? a[i] || b[i] : op == 1 ? a[i] && b[i] :
+					a[i] && !b[i];
+		}
+		
+		if(op == 0){
+			n = hashtab_merge(ht, other, intCombine, &called);
+			CHECK(n == inB - both);
+			CHECK(called == both);
+			CHECK(hashtab_length(other) == 0);
+		}else if(op == 1){
+			n = hashtab_intersect(ht, other, intCount, &called);
+			CHECK(n == inA - both);
+			CHECK(called == n);
+		}else{
+			n = hashtab_difference(ht, other, intCount, &called);
+			CHECK(n == both);
+			CHECK(called == n);
+		}
+		
+		memset(seen, 0, sizeof seen);
+		hashtab_forEach(ht, intMark, seen);
+		checkVisited(want, seen);
+		for(int i = 0; i < ITEMS; i++){
+			twice += seen[i] > 1;
+		}
+		CHECK(twice == 0);
+		
+		hashtab_free(other, NULL, NULL);
+		hashtab_free(ht, NULL, NULL);
+	}
+}
+
+/* A scan (and an iterator) must visit every item, also after removals have
+   left holes */
+void checkScan(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 0, flags);
+	unsigned char in[ITEMS] = {0}, seen[ITEMS] = {0};
+	size_t cursor = 0;
+	
+	for(int round = 0; round < 4; round++){
+		for(int i = 0; i < ITEMS; i++){
+			if(!in[i] && rand() % 2){
+				hashtab_add(ht, items + i);
+				in[i] = 1;
+			}
+		}
+		for(int i = 0; i < ITEMS; i++){
+			if(in[i] && rand() % 3 == 0){
+				CHECK(hashtab_remove(ht, items + i) == items + i);
+				in[i] = 0;
+			}
+		}
+	}
+	
+	do{
+		cursor = hashtab_scan(ht, cursor, 16, intMark, seen);
+	}while(cursor);
+	checkVisited(in, seen);
+	
+	/* An iterator visits every item exactly once */
+	hashtab_iter_s it;
+	unsigned char iterated[ITEMS] = {0};
+	size_t twice = 0;
+	void * item;
+	
+	for(hashtab_iterInit(&it, ht); (item = hashtab_iterNext(&it)); ){
+		twice += iterated[*(int*)item]++ != 0;
+	}
+	checkVisited(in, iterated);
+	CHECK(twice == 0);
+	
+	hashtab_free(ht, NULL, NULL);
+}
+
+/* Sum callback, ctx is a size_t */
+void intSum(void * item, void * ctx){
+	*(size_t*)ctx += (size_t) *(int*)item;
+}
+
+/* Reduce callback for the parallel walks: adds up size_t contexts */
+void sizeAdd(void * ctx, void * other){
+	*(size_t*)ctx += *(size_t*)other;
+}
+
+/* Number of threads for the parallel checks */
+#define THREADS 4
+
+/* The parallel walks must see every item once, also while migrating. Build
+   with `make clean test CFLAGS=-fopenmp` to run them on several threads */
+void checkParallel(int * items, int flags){
+	hashtab_s * ht = hashtab_makeFlags(8, intHash, intCmp, 0.75, 4, 0, flags);
+	hashtab_s * cpy;
+	size_t counts[THREADS] = {0}, sums[THREADS] = {0}, n = 0, right = 0;
+	void * countCtxs[THREADS], * sumCtxs[THREADS];
+	
+	for(int t = 0; t < THREADS; t++){
+		countCtxs[t] = counts + t;
+		sumCtxs[t] = sums + t;
+	}
+	for(int i = 0; i < ITEMS; i++){
+		hashtab_add(ht, items + i);
+	}
+	
+	hashtab_forEachParallel(ht, THREADS, intCount, countCtxs, sizeAdd);
+	hashtab_forEachParallel(ht, THREADS, intSum, sumCtxs, sizeAdd);
+	CHECK(counts[0] == hashtab_length(ht));
+	CHECK(sums[0] == (size_t) ITEMS * (ITEMS - 1) / 2);
+	
+	cpy = hashtab_copyParallel(ht, THREADS, NULL, NULL);
+	CHECK(hashtab_length(cpy) == hashtab_length(ht));
+	for(int i = 0; i < ITEMS; i++){
+		right += hashtab_find(cpy, items + i) == items + i;
+	}
+	CHECK(right == ITEMS);
+	hashtab_free(cpy, NULL, NULL);
+	
+	/* freeParallel doesn't reduce, so add up the counts here */
+	for(int t = 0; t < THREADS; t++){
+		counts[t] = 0;
+	}
+	hashtab_freeParallel(ht, THREADS, intCount, countCtxs);
+	for(int t = 0; t < THREADS; t++){
+		n += counts[t];
+	}
+	CHECK(n == ITEMS);
+}
+
+/* Known answers of the hash functions: wyhash's own test vectors (the input
+   at i hashed with seed i), CRC32C's and FNV-1's check values */
+void checkHashes(void){
+	const char * strs[] = {"", "a", "abc", "message digest",
+			"abcdefghijklmnopqrstuvwxyz",
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+			"1234567890123456789012345678901234567890"
+			"1234567890123456789012345678901234567890"};
+	const uint64_t wy[] = {UINT64_C(0x93228a4de0eec5a2),
+			UINT64_C(0xc5bac3db178713c4), UINT64_C(0xa97f2f7b1d9b3314),
+			UINT64_C(0x786d1f1df3801df4), UINT64_C(0xdca5a8138ad37c87),
+			UINT64_C(0xb9e734f117cfaf70), UINT64_C(0x6cc5eab49a92d617)};
+	size_t right = 0;
+	
+	for(size_t i = 0; i < sizeof wy / sizeof *wy; i++){
+		right += WYHashSeeded(strs[i], strlen(strs[i]), i) == wy[i];
+	}
+	CHECK(right == sizeof wy / sizeof *wy);
+	CHECK(CRC32CHash("123456789", 9) == 0xE3069283u);
+	CHECK(FNVHash("a", 1) == 0x050c5d7eu);
+}
+
 /* Helper function to find */
 int findKV(hashtab_s * ht, const char * key){
 	/* note that a (pointer to) full structure is needed because the hashtab
@@ -84,6 +658,74 @@ int main(void){
 	
 	srand(0);
 	
+	checkHashes();
+	
+	/* Check the table kinds on int items first */
+	int * items = malloc(ITEMS * sizeof *items);
+	for(int i = 0; i < ITEMS; i++){
+		items[i] = i;
+	}
+	
+	checkKind(items, 0);
+	checkKind(items, HASHTAB_FLAT);
+	checkKind(items, HASHTAB_POW2);
+	checkKind(items, HASHTAB_POW2 | HASHTAB_MIX);
+	checkKind(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkKind(items, HASHTAB_FLAT | HASHTAB_ROBIN);
+	checkKind(items, HASHTAB_FLAT | HASHTAB_ROBIN | HASHTAB_POW2 | HASHTAB_MIX);
+	checkKind(items, HASHTAB_COMPACT);
+	checkKind(items, HASHTAB_COMPACT | HASHTAB_POW2 | HASHTAB_MIX);
+	
+	checkBatch(items, 0);
+	checkBatch(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkBatch(items, HASHTAB_FLAT | HASHTAB_ROBIN);
+	checkBatch(items, HASHTAB_COMPACT);
+	
+	checkReserve(items, 0);
+	checkReserve(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	
+	checkStats(items, 0);
+	checkStats(items, HASHTAB_FLAT);
+	checkStats(items, HASHTAB_FLAT | HASHTAB_ROBIN);
+	checkStats(items, HASHTAB_COMPACT);
+	
+	checkCompiled(items, 0);
+	checkCompiled(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkCompiled(items, HASHTAB_FLAT | HASHTAB_ROBIN);
+	checkCompiled(items, HASHTAB_COMPACT);
+	
+	checkFindOrInsert(items, 0);
+	checkFindOrInsert(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkFindOrInsert(items, HASHTAB_COMPACT);
+	
+	checkMigrateStep(items, 0);
+	checkMigrateStep(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	
+	checkSeeded(items, 0);
+	checkSeeded(items, HASHTAB_FLAT | HASHTAB_POW2);
+	
+	checkSnapshot(items, 0);
+	checkSnapshot(items, HASHTAB_COMPACT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkSnapshot(items, HASHTAB_FLAT);
+	
+	checkSets(items, 0, 0);
+	checkSets(items, HASHTAB_POW2 | HASHTAB_MIX, HASHTAB_FLAT);
+	checkSets(items, HASHTAB_FLAT | HASHTAB_ROBIN, HASHTAB_FLAT | HASHTAB_ROBIN);
+	checkSets(items, HASHTAB_COMPACT, 0);
+	
+	checkScan(items, HASHTAB_POW2 | HASHTAB_MIX);
+	checkScan(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkScan(items, HASHTAB_FLAT | HASHTAB_ROBIN | HASHTAB_POW2 | HASHTAB_MIX);
+	checkScan(items, HASHTAB_COMPACT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkScan(items, HASHTAB_FLAT);
+	
+	checkParallel(items, 0);
+	checkParallel(items, HASHTAB_FLAT | HASHTAB_POW2 | HASHTAB_MIX);
+	checkParallel(items, HASHTAB_COMPACT);
+	
+	free(items);
+	printf("Checks failed: %i\n", failed);
+	
 	/* Make hashtab */
 	hashtab_s * ht = hashtab_make(size, KVhash, KVcmp, threshold, moveR, 
 			shrink);
@@ -122,5 +764,5 @@ int main(void){
 	
 	printMemStats();
 	
-	return 0;
+	return failed != 0;
 }